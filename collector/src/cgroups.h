@@ -26,11 +26,14 @@
 #include "cmonitor.h"
 #include "fast_file_reader.h"
 #include "system.h"
+#include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string.h>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 #ifdef PROMETHEUS_SUPPORT
@@ -44,6 +47,9 @@
 #define MIN_ELAPSED_SECS (0.1)
 #define MAX_LOGICAL_CPU (256)
 #define CGROUP_COLLECTOR_BUFF_SIZE (8192)
+#define GIGABYTE (1000ul * 1000ul * 1000ul)
+#define MEMORY_LIMIT_MAX_VALUE (1000 * 1000 * GIGABYTE) // cgroups v1 report "no limit" as a huge value
+#define MAX_NUMA_NODES (64)
 
 enum CGroupDetected {
     CG_NONE = 0, // force newline
@@ -69,6 +75,19 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_cpu[] = {
         "Number of runnable periods in which the application used its entire quota and was throttled" },
     { "cgroup_cpuacct_stats_throttled_time", prometheus::MetricType::Gauge,
         "Sum total amount of time individual threads within the cgroup were throttled" },
+    { "cgroup_cpuacct_stats_throttled_periods_pct", prometheus::MetricType::Gauge,
+        "Percentage of runnable periods in which the cgroup was throttled" },
+    { "cgroup_cpuacct_stats_avg_throttled_time", prometheus::MetricType::Gauge,
+        "Average throttled time per throttled period" },
+    { "cgroup_cpuacct_stats_nr_bursts", prometheus::MetricType::Gauge,
+        "Number of periods in which the cgroup used its burst allowance (cgroups v2 only)" },
+    { "cgroup_cpuacct_stats_burst_time", prometheus::MetricType::Gauge,
+        "Sum total amount of time spent running beyond the quota thanks to bursts (cgroups v2 only)" },
+    { "cgroup_cpuacct_stats_quota_cpus", prometheus::MetricType::Gauge,
+        "Current CPU quota expressed in number of CPUs; -1 if there is no limit" },
+    { "cgroup_cpuacct_stats_quota_used_pct", prometheus::MetricType::Gauge,
+        "CPU time consumed as a percentage of the CPU quota; -1 if there is no limit" },
+    { "cgroup_cpuacct_stats_weight", prometheus::MetricType::Gauge, "Current CPU weight (cgroups v2 only)" },
 };
 
 /* structure for prometheus output : Memory utilization as reported by cpuacct cgroup */
@@ -102,6 +121,34 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_memory[] = {
         "Number of times that a usage counter hit its limit" },
 };
 
+/* structure for prometheus output : extended memory stats, only when PK_CGROUP_MEMORY_EXT is enabled */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_memory_ext[] = {
+    { "cgroup_memory_stats_swap_current", prometheus::MetricType::Gauge, "Swap used by the cgroup (v2 only)" },
+    { "cgroup_memory_stats_memsw_usage", prometheus::MetricType::Gauge, "Memory+swap used by the cgroup (v1 only)" },
+    { "cgroup_memory_stats_memsw_max_usage", prometheus::MetricType::Gauge,
+        "Maximum memory+swap used by the cgroup (v1 only)" },
+    { "cgroup_memory_stats_limit_memsw", prometheus::MetricType::Gauge, "Memory+swap limit (v1 only)" },
+    { "cgroup_memory_stats_events_memsw_failcnt", prometheus::MetricType::Counter,
+        "Number of times the memory+swap limit was hit (v1 only)" },
+    { "cgroup_memory_stats_limit_max", prometheus::MetricType::Gauge, "Hard memory limit of the cgroup" },
+    { "cgroup_memory_stats_limit_high", prometheus::MetricType::Gauge, "Memory throttling limit (v2 only)" },
+    { "cgroup_memory_stats_headroom_max", prometheus::MetricType::Gauge,
+        "Memory that can still be charged to the cgroup before reaching the hard limit" },
+    { "cgroup_memory_stats_headroom_high", prometheus::MetricType::Gauge,
+        "Memory that can still be charged to the cgroup before being throttled (v2 only)" },
+};
+
+/* structure for prometheus output : IO utilization as reported by blkio (v1) or io (v2) cgroup */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_blkio[] = {
+    // cgroup : blkio
+    { "cgroup_blkio_rbytes", prometheus::MetricType::Gauge, "Bytes read per second from the block device" },
+    { "cgroup_blkio_wbytes", prometheus::MetricType::Gauge, "Bytes written per second to the block device" },
+    { "cgroup_blkio_dbytes", prometheus::MetricType::Gauge, "Bytes discarded per second on the block device" },
+    { "cgroup_blkio_rios", prometheus::MetricType::Gauge, "Read operations per second on the block device" },
+    { "cgroup_blkio_wios", prometheus::MetricType::Gauge, "Write operations per second on the block device" },
+    { "cgroup_blkio_dios", prometheus::MetricType::Gauge, "Discard operations per second on the block device" },
+};
+
 /* structure for prometheus output : Network utilization as reported by BY-NETWORK-INTERFACE */
 static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_network[] = {
     // cgroup : network
@@ -168,6 +215,167 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_processes[] = {
     { "cgroup_tasks_write_bytes", prometheus::MetricType::Gauge, "Bytes written" },
     { "cgroup_tasks_total_read", prometheus::MetricType::Counter, "Total bytes read" },
     { "cgroup_tasks_total_write", prometheus::MetricType::Counter, "Total bytes written" },
+    { "cgroup_tasks_run_pct", prometheus::MetricType::Gauge, "Percentage of time spent running on a CPU" },
+    { "cgroup_tasks_timeslices", prometheus::MetricType::Gauge, "Timeslices run on a CPU per second" },
+    { "cgroup_tasks_wait_pct", prometheus::MetricType::Gauge,
+        "Percentage of time spent waiting on a runqueue" },
+    { "cgroup_tasks_avg_wait_usec", prometheus::MetricType::Gauge, "Average runqueue delay for each timeslice" },
+};
+
+/* structure for prometheus output : Pressure Stall Information of the cgroup */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_pressure[] = {
+    // cgroup : pressure
+    { "cgroup_pressure_some_avg10", prometheus::MetricType::Gauge,
+        "Percentage of time some cgroup tasks were stalled on the resource, averaged over the last 10sec" },
+    { "cgroup_pressure_some_avg60", prometheus::MetricType::Gauge,
+        "Percentage of time some cgroup tasks were stalled on the resource, averaged over the last 60sec" },
+    { "cgroup_pressure_some_avg300", prometheus::MetricType::Gauge,
+        "Percentage of time some cgroup tasks were stalled on the resource, averaged over the last 300sec" },
+    { "cgroup_pressure_some_stall_pct", prometheus::MetricType::Gauge,
+        "Percentage of time some cgroup tasks were stalled on the resource during the last sampling interval" },
+    { "cgroup_pressure_full_avg10", prometheus::MetricType::Gauge,
+        "Percentage of time all non-idle cgroup tasks were stalled on the resource, averaged over the last 10sec" },
+    { "cgroup_pressure_full_avg60", prometheus::MetricType::Gauge,
+        "Percentage of time all non-idle cgroup tasks were stalled on the resource, averaged over the last 60sec" },
+    { "cgroup_pressure_full_avg300", prometheus::MetricType::Gauge,
+        "Percentage of time all non-idle cgroup tasks were stalled on the resource, averaged over the last 300sec" },
+    { "cgroup_pressure_full_stall_pct", prometheus::MetricType::Gauge,
+        "Percentage of time all non-idle cgroup tasks were stalled on the resource during the last sampling interval" },
+};
+
+/* structure for prometheus output : per-node stats of the tree of cgroups */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_tree[] = {
+    // cgroup : tree
+    { "cgroup_tree_depth", prometheus::MetricType::Gauge, "Depth of the cgroup below the root of the tree" },
+    { "cgroup_tree_cpu_usage_pct", prometheus::MetricType::Gauge, "CPU usage of the cgroup and all its descendants" },
+    { "cgroup_tree_cpu_self_pct", prometheus::MetricType::Gauge,
+        "CPU usage of the tasks directly inside the cgroup, excluding descendant cgroups" },
+    { "cgroup_tree_cpu_user_pct", prometheus::MetricType::Gauge, "CPU usage in user mode" },
+    { "cgroup_tree_cpu_system_pct", prometheus::MetricType::Gauge, "CPU usage in system (kernel) mode" },
+    { "cgroup_tree_cpu_throttled_pct", prometheus::MetricType::Gauge, "Time spent throttled by the CPU quota" },
+    { "cgroup_tree_memory_current", prometheus::MetricType::Gauge, "Memory used by the cgroup and its descendants" },
+    { "cgroup_tree_memory_anon", prometheus::MetricType::Gauge, "Anonymous memory used by the cgroup" },
+    { "cgroup_tree_memory_file", prometheus::MetricType::Gauge, "Page cache memory used by the cgroup" },
+    { "cgroup_tree_memory_kernel_stack", prometheus::MetricType::Gauge, "Kernel stacks memory used by the cgroup" },
+    { "cgroup_tree_memory_sock", prometheus::MetricType::Gauge, "Network buffers memory used by the cgroup" },
+    { "cgroup_tree_memory_shmem", prometheus::MetricType::Gauge, "Shared memory used by the cgroup" },
+    { "cgroup_tree_io_rbytes", prometheus::MetricType::Gauge, "Bytes read per second, summed over all devices" },
+    { "cgroup_tree_io_wbytes", prometheus::MetricType::Gauge, "Bytes written per second, summed over all devices" },
+    { "cgroup_tree_io_rios", prometheus::MetricType::Gauge, "Read operations per second, summed over all devices" },
+    { "cgroup_tree_io_wios", prometheus::MetricType::Gauge, "Write operations per second, summed over all devices" },
+};
+
+/* structure for prometheus output : pids controller */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_pids[] = {
+    // cgroup : pids
+    { "cgroup_pids_current", prometheus::MetricType::Gauge, "Number of processes and threads in the cgroup" },
+    { "cgroup_pids_limit", prometheus::MetricType::Gauge, "Maximum number of processes and threads (pids.max)" },
+    { "cgroup_pids_headroom", prometheus::MetricType::Gauge,
+        "Number of processes and threads that can still be created before reaching the limit" },
+    { "cgroup_pids_events_max", prometheus::MetricType::Counter,
+        "Number of fork()/clone() calls that failed because of the limit during the last sampling interval" },
+};
+
+/* structure for prometheus output : hugetlb controller, one time series per huge page size */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_hugetlb[] = {
+    // cgroup : hugetlb
+    { "cgroup_hugetlb_current", prometheus::MetricType::Gauge, "Bytes of huge pages used by the cgroup" },
+    { "cgroup_hugetlb_max_usage", prometheus::MetricType::Gauge,
+        "Maximum bytes of huge pages ever used by the cgroup (v1 only)" },
+    { "cgroup_hugetlb_limit", prometheus::MetricType::Gauge, "Limit on the bytes of huge pages of the cgroup" },
+    { "cgroup_hugetlb_headroom", prometheus::MetricType::Gauge,
+        "Bytes of huge pages that can still be allocated before reaching the limit" },
+    { "cgroup_hugetlb_events_max", prometheus::MetricType::Counter,
+        "Number of huge page allocations that failed because of the limit during the last sampling interval" },
+};
+
+/* structure for prometheus output : TCP sockets of the network namespace of the cgroup, as reported by sock_diag */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_tcp[] = {
+    // cgroup : tcp totals
+    { "cgroup_tcp_sockets", prometheus::MetricType::Gauge, "Number of TCP sockets in any state" },
+    { "cgroup_tcp_rtt_avg_us", prometheus::MetricType::Gauge, "Average smoothed RTT of the TCP sockets in usecs" },
+    { "cgroup_tcp_rtt_max_us", prometheus::MetricType::Gauge, "Maximum smoothed RTT of the TCP sockets in usecs" },
+    { "cgroup_tcp_retransmitting", prometheus::MetricType::Gauge,
+        "Number of TCP sockets waiting for a retransmitted segment to be acknowledged" },
+    { "cgroup_tcp_unacked", prometheus::MetricType::Gauge, "Number of TCP segments in flight" },
+    { "cgroup_tcp_cwnd_limited", prometheus::MetricType::Gauge,
+        "Number of TCP sockets having as many segments in flight as their congestion window allows" },
+
+    // cgroup : tcp sockets by state
+    { "cgroup_tcp_established", prometheus::MetricType::Gauge, "Number of TCP sockets in ESTABLISHED state" },
+    { "cgroup_tcp_syn_sent", prometheus::MetricType::Gauge, "Number of TCP sockets in SYN_SENT state" },
+    { "cgroup_tcp_syn_recv", prometheus::MetricType::Gauge, "Number of TCP sockets in SYN_RECV state" },
+    { "cgroup_tcp_fin_wait1", prometheus::MetricType::Gauge, "Number of TCP sockets in FIN_WAIT1 state" },
+    { "cgroup_tcp_fin_wait2", prometheus::MetricType::Gauge, "Number of TCP sockets in FIN_WAIT2 state" },
+    { "cgroup_tcp_time_wait", prometheus::MetricType::Gauge, "Number of TCP sockets in TIME_WAIT state" },
+    { "cgroup_tcp_close", prometheus::MetricType::Gauge, "Number of TCP sockets in CLOSE state" },
+    { "cgroup_tcp_close_wait", prometheus::MetricType::Gauge, "Number of TCP sockets in CLOSE_WAIT state" },
+    { "cgroup_tcp_last_ack", prometheus::MetricType::Gauge, "Number of TCP sockets in LAST_ACK state" },
+    { "cgroup_tcp_listen", prometheus::MetricType::Gauge, "Number of TCP sockets in LISTEN state" },
+    { "cgroup_tcp_closing", prometheus::MetricType::Gauge, "Number of TCP sockets in CLOSING state" },
+
+    // cgroup : tcp RTT histogram
+    { "cgroup_tcp_under_100us", prometheus::MetricType::Gauge, "Number of TCP sockets with RTT below 100usecs" },
+    { "cgroup_tcp_under_1ms", prometheus::MetricType::Gauge, "Number of TCP sockets with RTT in [100us, 1ms)" },
+    { "cgroup_tcp_under_10ms", prometheus::MetricType::Gauge, "Number of TCP sockets with RTT in [1ms, 10ms)" },
+    { "cgroup_tcp_under_100ms", prometheus::MetricType::Gauge, "Number of TCP sockets with RTT in [10ms, 100ms)" },
+    { "cgroup_tcp_under_1s", prometheus::MetricType::Gauge, "Number of TCP sockets with RTT in [100ms, 1s)" },
+    { "cgroup_tcp_over_1s", prometheus::MetricType::Gauge, "Number of TCP sockets with RTT of 1s or more" },
+};
+
+/* structure for prometheus output : /proc/net/snmp and /proc/net/netstat stats of the network namespace */
+static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_netstat[] = {
+    // cgroup : protocol stats of the network namespace
+    { "cgroup_net_snmp_tcp_active_opens", prometheus::MetricType::Gauge, "TCP connections opened actively per second" },
+    { "cgroup_net_snmp_tcp_passive_opens", prometheus::MetricType::Gauge,
+        "TCP connections opened passively (accepted) per second" },
+    { "cgroup_net_snmp_tcp_attempt_fails", prometheus::MetricType::Gauge, "TCP connection attempts failed per second" },
+    { "cgroup_net_snmp_tcp_estab_resets", prometheus::MetricType::Gauge,
+        "TCP connections reset from ESTABLISHED or CLOSE_WAIT state per second" },
+    { "cgroup_net_snmp_tcp_in_segs", prometheus::MetricType::Gauge, "TCP segments received per second" },
+    { "cgroup_net_snmp_tcp_out_segs", prometheus::MetricType::Gauge, "TCP segments sent per second" },
+    { "cgroup_net_snmp_tcp_retrans_segs", prometheus::MetricType::Gauge, "TCP segments retransmitted per second" },
+    { "cgroup_net_snmp_tcp_in_errs", prometheus::MetricType::Gauge, "TCP segments received with errors per second" },
+    { "cgroup_net_snmp_tcp_out_rsts", prometheus::MetricType::Gauge, "TCP segments sent with the RST flag per second" },
+    { "cgroup_net_snmp_udp_in_datagrams", prometheus::MetricType::Gauge,
+        "UDP datagrams delivered to sockets per second" },
+    { "cgroup_net_snmp_udp_out_datagrams", prometheus::MetricType::Gauge, "UDP datagrams sent per second" },
+    { "cgroup_net_snmp_udp_no_ports", prometheus::MetricType::Gauge,
+        "UDP datagrams received for a port without listener per second" },
+    { "cgroup_net_snmp_udp_in_errors", prometheus::MetricType::Gauge,
+        "UDP datagrams that could not be delivered per second" },
+    { "cgroup_net_snmp_udp_rcvbuf_errors", prometheus::MetricType::Gauge,
+        "UDP datagrams dropped because the socket receive buffer was full per second" },
+    { "cgroup_net_snmp_udp_sndbuf_errors", prometheus::MetricType::Gauge,
+        "UDP datagrams dropped because the socket send buffer was full per second" },
+    { "cgroup_net_snmp_tcp_listen_overflows", prometheus::MetricType::Gauge,
+        "TCP connections dropped because the accept queue of a listening socket was full per second" },
+    { "cgroup_net_snmp_tcp_listen_drops", prometheus::MetricType::Gauge,
+        "TCP SYNs dropped by listening sockets for any reason per second" },
+    { "cgroup_net_snmp_tcp_timeouts", prometheus::MetricType::Gauge, "TCP retransmission timeouts per second" },
+    { "cgroup_net_snmp_tcp_syn_retrans", prometheus::MetricType::Gauge,
+        "TCP SYN and SYN/ACK retransmissions per second" },
+    { "cgroup_net_snmp_tcp_fast_retrans", prometheus::MetricType::Gauge, "TCP fast retransmissions per second" },
+    { "cgroup_net_snmp_tcp_lost_retransmit", prometheus::MetricType::Gauge,
+        "TCP retransmitted segments lost again per second" },
+    { "cgroup_net_snmp_tcp_backlog_drop", prometheus::MetricType::Gauge,
+        "TCP segments dropped because the socket backlog was full per second" },
+    { "cgroup_net_snmp_tcp_abort_on_data", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of unexpected data per second" },
+    { "cgroup_net_snmp_tcp_abort_on_close", prometheus::MetricType::Gauge,
+        "TCP connections aborted on close with unread data per second" },
+    { "cgroup_net_snmp_tcp_abort_on_memory", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of memory pressure per second" },
+    { "cgroup_net_snmp_tcp_abort_on_timeout", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of too many retransmissions per second" },
+    { "cgroup_net_snmp_tcp_abort_on_linger", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of the SO_LINGER timeout per second" },
+    { "cgroup_net_snmp_tcp_abort_failed", prometheus::MetricType::Gauge,
+        "TCP aborts that failed to send a RST per second" },
+    { "cgroup_net_snmp_tcp_aborts", prometheus::MetricType::Gauge,
+        "TCP connections aborted for any reason per second" },
+    { "cgroup_net_snmp_tcp_retrans_pct", prometheus::MetricType::Gauge,
+        "percentage of sent TCP segments that were retransmissions" },
 };
 #endif
 
@@ -181,15 +389,114 @@ typedef struct {
     uint64_t nr_periods;
     uint64_t nr_throttled;
     uint64_t throttled_time_nsec;
+    uint64_t nr_bursts; // cgroups v2 only, on kernels supporting cpu.max.burst
+    uint64_t burst_time_nsec; // cgroups v2 only, on kernels supporting cpu.max.burst
 } cpuacct_throttling_t;
 
 typedef std::map<std::string /* controller type */, std::string /* path */> cgroup_paths_map_t;
 
 typedef struct {
     uint64_t v1_failcnt;
+    uint64_t v1_memsw_failcnt;
     key_value_map_t v2_events;
+    key_value_map_t v2_events_local;
+    key_value_map_t v2_swap_events;
 } memory_events_t;
 
+/* additional files of the memory controller read when PK_CGROUP_MEMORY_EXT is enabled */
+enum CgroupMemoryExtFile {
+    // cgroups v1 and v2
+    MEMEXT_NUMA_STAT, // memory.numa_stat
+    MEMEXT_LIMIT_MAX, // memory.max (v2) or memory.limit_in_bytes (v1)
+    // cgroups v1 only
+    MEMEXT_V1_USAGE, // memory.usage_in_bytes
+    MEMEXT_V1_MEMSW_USAGE, // memory.memsw.usage_in_bytes
+    MEMEXT_V1_MEMSW_MAX_USAGE, // memory.memsw.max_usage_in_bytes
+    MEMEXT_V1_MEMSW_LIMIT, // memory.memsw.limit_in_bytes
+    MEMEXT_V1_MEMSW_FAILCNT, // memory.memsw.failcnt
+    // cgroups v2 only
+    MEMEXT_V2_LIMIT_HIGH, // memory.high
+    MEMEXT_V2_EVENTS_LOCAL, // memory.events.local
+    MEMEXT_V2_SWAP_CURRENT, // memory.swap.current
+    MEMEXT_V2_SWAP_EVENTS, // memory.swap.events
+
+    MEMEXT_FILE_MAX
+};
+
+/* files of the hugetlb controller for a single huge page size */
+typedef struct {
+    std::string name; // huge page size as reported by the kernel in the file names, e.g. "2MB" or "1GB"
+    FastFileReader current; // hugetlb.<size>.current (v2) or hugetlb.<size>.usage_in_bytes (v1)
+    FastFileReader max_usage; // hugetlb.<size>.max_usage_in_bytes (v1 only)
+    FastFileReader limit; // hugetlb.<size>.max (v2) or hugetlb.<size>.limit_in_bytes (v1)
+    FastFileReader failures; // hugetlb.<size>.events (v2) or hugetlb.<size>.failcnt (v1)
+    uint64_t prev_failures;
+    bool prev_valid;
+} hugetlb_pagesize_t;
+
+/* per-device IO counters as reported by blkio (v1) or io (v2) cgroup */
+enum BlkioCounter {
+    // NOTE: the order of Read, Write, Discard counters is the same of the cgroup v1 files
+    BLKIO_RBYTES,
+    BLKIO_WBYTES,
+    BLKIO_DBYTES, // discards are reported only by kernels 4.19+
+    BLKIO_RIOS,
+    BLKIO_WIOS,
+    BLKIO_DIOS,
+
+    BLKIO_COUNTER_MAX
+};
+
+typedef struct {
+    dev_t dev;
+    std::string name; // kernel name of the block device, or "major:minor" if unknown
+    bool present; // true if the device was listed in the last sample
+    bool prev_valid; // true if the device was listed also in the previous sample
+} blkio_device_t;
+
+/* counters read for each node of the tree of cgroups (cgroups v2 only) */
+enum CgroupTreeCounter {
+    // from cpu.stat
+    CGTREE_CPU_USAGE_USEC,
+    CGTREE_CPU_USER_USEC,
+    CGTREE_CPU_SYSTEM_USEC,
+    CGTREE_CPU_THROTTLED_USEC,
+    // from memory.current and memory.stat
+    CGTREE_MEMORY_CURRENT,
+    CGTREE_MEMORY_ANON,
+    CGTREE_MEMORY_FILE,
+    CGTREE_MEMORY_KERNEL_STACK,
+    CGTREE_MEMORY_SOCK,
+    CGTREE_MEMORY_SHMEM,
+    // from io.stat, summed over all devices
+    CGTREE_IO_RBYTES,
+    CGTREE_IO_WBYTES,
+    CGTREE_IO_RIOS,
+    CGTREE_IO_WIOS,
+
+    CGTREE_COUNTER_MAX
+};
+
+enum CgroupTreeFile {
+    CGTREE_FILE_CPU_STAT = 1,
+    CGTREE_FILE_MEMORY_CURRENT = 2,
+    CGTREE_FILE_MEMORY_STAT = 4,
+    CGTREE_FILE_IO_STAT = 8,
+};
+
+typedef struct {
+    bool in_use;
+    int dir_fd; // kept open as long as the cgroup exists: files are opened relative to it
+    uint64_t ino; // inode of the cgroup directory, to recognize it in the parent directory listing
+    uint32_t parent; // node ID of the parent cgroup
+    uint32_t depth; // 0 for the root of the tree
+    uint64_t generation; // last walk where this cgroup was found
+    unsigned int files_read; // bitmask of CgroupTreeFile successfully read in the last walk
+    bool prev_valid; // true if counters of the previous walk are available
+    std::string name; // cgroup name, relative to the cgroup mount point; built once when the cgroup is discovered
+    std::vector<uint32_t> children; // node IDs of the children cgroups
+} cgroup_tree_node_t;
+
 //------------------------------------------------------------------------------
 // The CMonitorCgroups object
 //------------------------------------------------------------------------------
@@ -206,9 +513,14 @@ public:
         memset(&m_cpuacct_prev_values_for_total_cpu, 0, sizeof(cpuacct_utilisation_t));
         memset(&m_cpuacct_prev_values_for_throttling, 0, sizeof(cpuacct_throttling_t));
         m_memory_prev_values.v1_failcnt = 0;
+        m_memory_prev_values.v1_memsw_failcnt = 0;
     }
 
-    ~CMonitorCgroups() { }
+    ~CMonitorCgroups()
+    {
+        if (m_netns_fd != -1)
+            close(m_netns_fd);
+    }
 
     // main setup
     // NOTE: arguments _for_test are used only during unit testing
@@ -221,18 +533,41 @@ public:
     // one-shot configuration info
     void output_config();
 
+    // when monitoring many cgroups, the provided labels are attached to all sections produced by this object
+    void set_output_labels(const std::map<std::string, std::string>& labels) { m_output_labels = labels; }
+
+    // returns the directory where the tree of cgroups is mounted, e.g. /sys/fs/cgroup/memory for cgroups v1
+    // NOTE: arguments _for_test are used only during unit testing
+    bool get_cgroups_mount_point(std::string& pathOUT, // force newline
+        const std::string& cgroup_prefix_for_test = "", // force newline
+        const std::string& proc_prefix_for_test = "", // force newline
+        uint64_t my_own_pid_for_test = UINT64_MAX);
+
+    // expands a glob pattern like "kubepods.slice/*/*" relative to the cgroup mount point into cgroup names
+    bool list_cgroups_matching(const std::string& pattern, std::vector<std::string>& namesOUT);
+
     // collect & output cgroup stats
     void sample_cpuacct(double elapsed_sec);
     void sample_memory(
         const std::set<std::string>& allowedStatsNames_v1, const std::set<std::string>& allowedStatsNames_v2);
+    void sample_blkio(double elapsed_sec, OutputFields output_opts);
 
     void sample_process_list(); // call before sample_network_interfaces() and sample_processes()
     void sample_network_interfaces(double elapsed_sec, OutputFields output_opts);
     void sample_processes(double elapsed_sec, OutputFields output_opts);
+    void sample_pressure(double elapsed_sec, OutputFields output_opts);
+    void sample_pids(OutputFields output_opts);
+    void sample_hugetlb(OutputFields output_opts);
+    void sample_tcp(OutputFields output_opts); // call after sample_process_list()
+    void sample_netstat(double elapsed_sec, OutputFields output_opts); // call after sample_process_list()
 
     // misc helpers
     bool cgroup_still_exists();
     std::set<uint64_t> get_cgroup_cpus() const { return m_cgroup_cpus; }
+    std::string get_memory_events_file() const; // empty unless cgroups v2 memory stats are being collected
+    std::set<std::string> get_cgroup_dirs() const;
+    std::string get_cgroup_events_file() const; // empty unless cgroups v2
+    bool cgroup_is_populated() const; // cgroups v2 only
     CGroupDetected get_detected_cgroup_version() const { return m_nCGroupsFound; }
 
 private:
@@ -247,11 +582,16 @@ private:
     bool search_my_pid_in_cgroups(); // sets m_cgroup_processes_path
     bool search_processes_cgroup_path(); // sets m_cgroup_processes_path
     void v1_read_limits();
-    void v2_read_limits();
+    void v2_read_limits(const std::string& cgroup_prefix_for_test);
     void init_cpuacct(const std::string& cgroup_prefix_for_test);
     void init_memory(const std::string& cgroup_prefix_for_test);
     void init_network(const std::string& cgroup_prefix_for_test);
     void init_processes(const std::string& cgroup_prefix_for_test);
+    void init_blkio(const std::string& cgroup_prefix_for_test);
+    void init_pressure(const std::string& cgroup_prefix_for_test);
+    void init_pids(const std::string& cgroup_prefix_for_test);
+    void init_hugetlb(const std::string& cgroup_prefix_for_test);
+    void init_tcp(const std::string& cgroup_prefix_for_test);
 
     // cgroup processes
     bool get_process_infos(
@@ -259,10 +599,16 @@ private:
     bool collect_pids(const std::string& file, std::vector<pid_t>& pids); // utility of cgroup_proc_tasks()
     bool collect_pids(FastFileReader& reader, std::vector<pid_t>& pids); // utility of cgroup_proc_tasks()
 
+    // cgroup network
+    void update_network_namespace();
+
     // cpuacct controller
     bool read_cpuacct_line(FastFileReader& reader, std::vector<uint64_t>& valuesINT /* OUT */);
     bool sample_cpuacct_v1_counters_by_cpu(bool print, double elapsed_sec, cpuacct_utilisation_t& total_cpu_usage);
     bool sample_cpuacct_v2_counters(bool print, double elapsed_sec, cpuacct_utilisation_t& total_cpu_usage);
+    void output_cpuacct_throttling(const cpuacct_throttling_t& counters, bool has_burst_stats);
+    void output_cpuacct_quota(double elapsed_sec, const cpuacct_utilisation_t& total_cpu_usage);
+    bool read_cpu_limits_v2();
 
     // cpuset controller
     bool is_allowed_cpu(int cpu);
@@ -270,9 +616,23 @@ private:
     unsigned int get_max_allowed_cpu_index() const;
     bool read_cpuset_cpus(std::string kernelPath, std::set<uint64_t>& cpus);
 
+    // blkio controller
+    uint64_t* get_blkio_counters(const string_field_t& dev_field);
+    bool read_blkio_v1_counters(FastFileReader& reader, BlkioCounter first_counter);
+    bool read_blkio_v2_counters();
+
     // memory controller
     size_t sample_flat_keyed_file(FastFileReader& reader, const std::set<std::string>& allowedStatsNames,
         const std::string& label_prefix, key_value_map_t& out);
+    void output_flat_keyed_file_deltas(
+        FastFileReader& reader, const std::string& label_prefix, key_value_map_t& prev_values, bool print);
+    void init_memory_ext(bool reopen_each_time);
+    void sample_memory_ext(bool print, uint64_t current_bytes);
+    void sample_memory_numa_stat();
+    bool read_memory_limit(FastFileReader& reader, uint64_t& limit_bytes);
+
+    // pids and hugetlb controllers
+    bool read_limit_failures(FastFileReader& reader, uint64_t& failures);
 
 private:
     // main switch that indicates if init() was successful or not
@@ -286,11 +646,15 @@ private:
     std::string m_cgroup_memory_kernel_path; // contains the abs path to the folder with memory controller files
     std::string m_cgroup_cpuacct_kernel_path; // contains the abs path to the folder with cpuacct controller files
     std::string m_cgroup_cpuset_kernel_path; // contains the abs path to the folder with cpuset controller files
+    std::string m_cgroup_blkio_kernel_path; // contains the abs path to the folder with blkio controller files
+    std::string m_cgroup_pids_kernel_path; // contains the abs path to the folder with pids controller files
+    std::string m_cgroup_hugetlb_kernel_path; // contains the abs path to the folder with hugetlb controller files
     std::string m_cgroup_processes_path; // contains the abs path to the folder which contains either the "tasks"
                                          // (v1) or "cgroups.procs|threads" (v2) files
     std::string m_proc_prefix; // used only during unit testing to insert an arbitrary prefix in front of "/proc"
     std::string m_proc_self_cgroup; // defaults to "/proc/self/cgroup" but is changed during unit testing
     std::string m_proc_self_mounts; // defaults to "/proc/self/mounts" but is changed during unit testing
+    std::map<std::string, std::string> m_output_labels; // labels attached to all output sections
 
     //------------------------------------------------------------------------------
     // counters of how many times each cgroup_proc_*() main API has been invoked
@@ -299,6 +663,7 @@ private:
     unsigned int m_num_cpuacct_samples_collected = 0;
     unsigned int m_num_tasks_samples_collected = 0;
     unsigned int m_num_network_samples_collected = 0;
+    unsigned int m_num_blkio_samples_collected = 0;
 
     //------------------------------------------------------------------------------
     // limits read from the cgroups controllers:
@@ -307,6 +672,7 @@ private:
     std::set<uint64_t> m_cgroup_cpus;
     uint64_t m_cgroup_cpuacct_period_us = 0;
     uint64_t m_cgroup_cpuacct_quota_us = 0; // if UINT64_MAX indicates there's no cpu limit
+    uint64_t m_cgroup_cpu_weight = 0; // cgroups v2 only; zero if unknown
 
     //------------------------------------------------------------------------------
     // cpuacct controller
@@ -317,6 +683,8 @@ private:
     FastFileReader m_cgroup_cpuacct_v1_reader_combined_stat; // if has COMBINED user/system time
     FastFileReader m_cgroup_cpuacct_v1_reader_total_cpu_stat;
     FastFileReader m_cgroup_cpuacct_v2_reader_total_cpu_stat;
+    FastFileReader m_cgroup_cpuacct_v2_reader_cpu_max; // re-read at every sample: limits can change at runtime
+    FastFileReader m_cgroup_cpuacct_v2_reader_cpu_weight; // re-read at every sample: limits can change at runtime
     bool m_cgroup_cpuacct_v1_supports_split_user_and_system_time = false;
     unsigned int m_num_cpus_cpuacct_cgroup = 0;
 
@@ -332,8 +700,39 @@ private:
     FastFileReader m_cgroup_memory_v1v2_stat;
     FastFileReader m_cgroup_memory_v1_failcnt;
     FastFileReader m_cgroup_memory_v2_events;
+    FastFileReader m_cgroup_memory_ext[MEMEXT_FILE_MAX]; // used only if PK_CGROUP_MEMORY_EXT is enabled
     memory_events_t m_memory_prev_values;
 
+    //------------------------------------------------------------------------------
+    // blkio controller
+    //------------------------------------------------------------------------------
+    FastFileReader m_cgroup_blkio_v1_service_bytes;
+    FastFileReader m_cgroup_blkio_v1_serviced;
+    FastFileReader m_cgroup_blkio_v2_io_stat;
+    std::map<dev_t, std::string> m_blkio_device_names; // read once at init from /proc/diskstats
+    std::vector<blkio_device_t> m_blkio_devices;
+    std::vector<uint64_t> m_blkio_counters; // BLKIO_COUNTER_MAX counters for each entry of m_blkio_devices
+    std::vector<uint64_t> m_blkio_prev_counters; // same layout of m_blkio_counters
+
+    //------------------------------------------------------------------------------
+    // pressure stall information (cgroups v2 only)
+    //------------------------------------------------------------------------------
+    pressure_resource_t m_pressure[PSI_MAX];
+
+    //------------------------------------------------------------------------------
+    // pids controller
+    //------------------------------------------------------------------------------
+    FastFileReader m_cgroup_pids_current;
+    FastFileReader m_cgroup_pids_max; // re-read at every sample: limits can change at runtime
+    FastFileReader m_cgroup_pids_events;
+    uint64_t m_pids_prev_failures = 0;
+    bool m_pids_prev_valid = false;
+
+    //------------------------------------------------------------------------------
+    // hugetlb controller
+    //------------------------------------------------------------------------------
+    std::list<hugetlb_pagesize_t> m_hugetlb_pagesizes; // a list, so that readers and their fds are never copied
+
     //------------------------------------------------------------------------------
     // shared variables between cgroup network/process tracker
     //------------------------------------------------------------------------------
@@ -346,6 +745,24 @@ private:
     // previous values for network interfaces inside cgroup
     netinfo_map_t m_previous_netinfo;
 
+    // network namespace of the cgroup: it is accessed through a PID of the cgroup, which is replaced only when
+    // it exits or leaves the cgroup; the namespace is re-resolved only if its inode changes
+    pid_t m_netns_pid = 0;
+    int m_netns_fd = -1; // keeps the network namespace open
+    ino_t m_netns_inode = 0;
+    unsigned int m_netns_open_backoff = 1; // samples to skip after next failure to open the network namespace
+    unsigned int m_netns_open_retry_countdown = 0; // samples to skip before retrying to open the network namespace
+
+    // rtnetlink socket bound to the network namespace of the cgroup
+    NetlinkStatsReader m_netlink_stats;
+    FastFileReader m_netns_net_dev; // /proc/<m_netns_pid>/net/dev, used only if m_netlink_stats cannot be opened
+
+    // sock_diag socket bound to the network namespace of the cgroup, used only if PK_CGROUP_TCP is enabled
+    SockDiagReader m_sock_diag;
+
+    // /proc/<m_netns_pid>/net/snmp and /proc/<m_netns_pid>/net/netstat, used only if PK_CGROUP_NETSTAT is enabled
+    netstat_readers_t m_netns_netstat;
+
     //------------------------------------------------------------------------------
     // cgroup processes tracking
     //------------------------------------------------------------------------------
@@ -357,3 +774,163 @@ private:
     // that's why we use std::multimap instead of a std::map
     std::multimap<uint64_t /* process score */, proc_topper_t> m_topper_procs;
 };
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupsSet
+// ----------------------------------------------------------------------------------
+
+// Monitors one or more cgroups: the cgroup name provided by the user can be a comma-separated list of cgroup names
+// and/or glob patterns; alternatively all cgroups below a root cgroup can be discovered automatically.
+// Each monitored cgroup is handled by a dedicated CMonitorCgroups instance, while the system collectors and
+// the output frontend are shared.
+// When a single cgroup is monitored, the output is identical to the one of a plain CMonitorCgroups.
+class CMonitorCgroupsSet : public CMonitorAppHelper {
+public:
+    CMonitorCgroupsSet(CMonitorCollectorAppConfig* pCfg, CMonitorOutputFrontend* pOutput)
+        : CMonitorAppHelper(pCfg, pOutput)
+    {
+    }
+
+    ~CMonitorCgroupsSet();
+
+    // NOTE: arguments _for_test are used only during unit testing and only when monitoring a single cgroup
+    //       or in discovery mode
+    void init(bool include_threads, // force newline
+        const std::string& cgroup_prefix_for_test = "", // force newline
+        const std::string& proc_prefix_for_test = "", // force newline
+        uint64_t my_own_pid_for_test = UINT64_MAX);
+    void get_list_monitored_files(std::set<std::string>& list);
+    void output_config();
+
+    // in discovery mode, processes the cgroup creation/removal events collected since last call, without
+    // rescanning the tree of cgroups; new cgroups get their bootstrap sample right away: call after the end of
+    // a sample, so that their first emitted sample covers a whole sampling interval
+    void discover_cgroups();
+
+    // the first sample of the KPI families computed as deltas produces no output but is needed to compute the
+    // deltas at next sample: call once after init()
+    void sample_bootstrap();
+
+    void sample_cpuacct(double elapsed_sec);
+    void sample_memory(
+        const std::set<std::string>& allowedStatsNames_v1, const std::set<std::string>& allowedStatsNames_v2);
+    void sample_blkio(double elapsed_sec, OutputFields output_opts);
+    void sample_process_list();
+    void sample_network_interfaces(double elapsed_sec, OutputFields output_opts);
+    void sample_processes(double elapsed_sec, OutputFields output_opts);
+    void sample_pressure(double elapsed_sec, OutputFields output_opts);
+    void sample_pids(OutputFields output_opts);
+    void sample_hugetlb(OutputFields output_opts);
+    void sample_tcp(OutputFields output_opts);
+    void sample_netstat(double elapsed_sec, OutputFields output_opts);
+
+    // in multi-cgroup mode, cgroups that disappeared are removed from the set: returns false once all are gone;
+    // in discovery mode, returns false once the root cgroup is gone
+    bool cgroup_still_exists();
+
+    // event samples: the kernel notifies the changes of the cgroup v2 memory.events files (OOM kills, memory.high
+    // and memory.max breaches); the caller polls get_events_fd() and, when read_events() returns true, invokes
+    // sample_memory_events() to take an extra sample of the memory and processes of the affected cgroups;
+    // at most one event sample per sampling interval is taken for each cgroup
+    bool init_event_watches();
+    int get_events_fd() const { return m_events_inotify_fd; }
+    bool read_events();
+    void sample_memory_events(const std::set<std::string>& allowedStatsNames_v1,
+        const std::set<std::string>& allowedStatsNames_v2, OutputFields output_opts);
+
+    // liveness watches: the kernel notifies the removal of the cgroup directories and, with cgroups v2, the changes
+    // of the cgroup.events "populated" flag, so that cgroup_still_exists() turns false as soon as the last process
+    // of the cgroup exits; a cgroup that has never been seen populated is considered alive until its removal;
+    // notifications are delivered through get_events_fd() and processed by read_events();
+    // not available in discovery mode
+    bool init_liveness_watches();
+
+private:
+    typedef struct {
+        CMonitorCollectorAppConfig cfg; // each collector gets its own copy of the configuration
+        std::unique_ptr<CMonitorCgroups> collector;
+        int memory_events_wd = -1; // inotify watch on memory.events, if event samples are enabled
+        bool memory_event_pending = false;
+        double event_sample_time = 0; // time of the last event sample, if more recent than m_processes_sample_time
+        std::vector<int> liveness_wds; // inotify watches on the cgroup directories and cgroup.events
+        bool populated_seen = false; // set once the cgroup has been seen containing some process (cgroups v2 only)
+        bool alive = true; // cleared as soon as the kernel reports the cgroup as removed or as no longer populated
+    } monitored_cgroup_t;
+
+    bool add_cgroup(const std::string& name);
+    void remove_cgroup(const std::string& name);
+    void watch_memory_events(const std::string& name, monitored_cgroup_t& entry);
+    void watch_liveness(const std::string& name, monitored_cgroup_t& entry);
+    void unwatch_cgroup(monitored_cgroup_t& entry);
+    bool init_events_inotify();
+
+    // discovery mode
+    bool init_discovery();
+    void watch_cgroup_tree(const std::string& name);
+    void init_pending_cgroups(bool bootstrap);
+
+    static void sample_bootstrap(CMonitorCgroups* collector);
+
+private:
+    bool m_bMultiCgroup = false;
+    bool m_include_threads = false;
+    std::string m_cgroup_prefix_for_test; // used only during unit testing of the discovery mode
+    std::string m_proc_prefix_for_test; // used only during unit testing of the discovery mode
+    uint64_t m_my_own_pid_for_test = UINT64_MAX; // used only during unit testing of the discovery mode
+    std::map<std::string /* cgroup name */, monitored_cgroup_t> m_cgroups;
+
+    // discovery mode
+    std::string m_cgroups_mount_point; // e.g. /sys/fs/cgroup
+    int m_inotify_fd = -1;
+    std::map<int /* watch descriptor */, std::string /* cgroup name */> m_watches;
+    std::map<std::string /* cgroup name */, unsigned int /* init attempts */> m_pending_cgroups;
+
+    // event samples
+    int m_events_inotify_fd = -1;
+    std::map<int /* watch descriptor */, std::string /* cgroup name */> m_event_watches;
+    std::map<int /* watch descriptor */, std::string /* cgroup name */> m_liveness_watches;
+    double m_processes_sample_time = 0; // time of the last regular sample of processes
+};
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupTree
+// ----------------------------------------------------------------------------------
+
+// Walks a whole subtree of cgroups (v2 only) at each sample, reporting a few stats for each node of the tree.
+// Since cgroup v2 stats are hierarchical, each node provides the roll-up of its whole subtree.
+class CMonitorCgroupTree : public CMonitorAppHelper {
+public:
+    CMonitorCgroupTree(CMonitorCollectorAppConfig* pCfg, CMonitorOutputFrontend* pOutput)
+        : CMonitorAppHelper(pCfg, pOutput)
+    {
+    }
+
+    ~CMonitorCgroupTree();
+
+    // NOTE: the cgroup_prefix_for_test argument is used only during unit testing: it replaces the cgroup mount point
+    void init(const std::string& cgroup_prefix_for_test = "");
+    void sample(double elapsed_sec, OutputFields output_opts);
+
+    size_t get_num_nodes() const { return m_nodes.size() - m_free_nodes.size(); }
+
+private:
+    uint32_t add_node(uint32_t parent, int dir_fd, uint64_t ino, const char* dirent_name);
+    void remove_subtree(uint32_t id);
+    void scan_children(uint32_t id);
+    void read_node_counters(uint32_t id);
+    void output_node(uint32_t id, double elapsed_sec, OutputFields output_opts);
+
+private:
+    // flat arrays indexed by node ID:
+    std::vector<cgroup_tree_node_t> m_nodes;
+    std::vector<uint64_t> m_counters; // CGTREE_COUNTER_MAX counters for each node
+    std::vector<uint64_t> m_prev_counters;
+    std::vector<uint64_t> m_children_cpu_usage; // sum of the CPU usage deltas of the children of each node
+
+    std::vector<uint32_t> m_free_nodes; // IDs of the nodes that can be reused
+    std::unordered_map<uint64_t /* inode */, uint32_t /* node ID */> m_ino2node;
+    std::vector<uint32_t> m_walk_order; // node IDs in depth-first order, filled by each walk
+    std::vector<uint32_t> m_walk_stack;
+    uint64_t m_generation = 0;
+    bool m_max_nodes_warned = false;
+};
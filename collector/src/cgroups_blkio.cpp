@@ -0,0 +1,332 @@
+/*
+ * cgroups_blkio.cpp -- code for collecting CGROUP BLKIO statistics
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "output_frontend.h"
+#include "utils_string.h"
+#include <algorithm>
+#include <assert.h>
+#include <sys/sysmacros.h> // makedev()
+
+#define BLKIO_MAX_FIELDS (16)
+
+static const char* g_blkio_counter_names[BLKIO_COUNTER_MAX] = {
+    "rbytes", "wbytes", "dbytes", "rios", "wios", "dios" // force newline
+};
+
+/*
+    PERFORMANCE NOTE:
+    Devices are identified by their major:minor numbers; the kernel names are resolved just once at init
+    time. Counters of all devices are stored in a flat array, indexed in the same way as m_blkio_devices,
+    so that after the first sample no memory gets allocated, unless new devices appear.
+*/
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - internal helpers
+// ----------------------------------------------------------------------------------
+
+static bool parse_major_minor(const string_field_t& field, dev_t& dev)
+{
+    const char* colon = (const char*)memchr(field.ptr, ':', field.len);
+    if (!colon)
+        return false; // e.g. the "Total" line of cgroup v1 files
+
+    uint64_t major = 0, minor = 0;
+    string_field_t major_field = { field.ptr, (size_t)(colon - field.ptr) };
+    string_field_t minor_field = { colon + 1, field.len - major_field.len - 1 };
+    if (!string_field2int(major_field, major) || !string_field2int(minor_field, minor))
+        return false;
+
+    dev = makedev(major, minor);
+    return true;
+}
+
+uint64_t* CMonitorCgroups::get_blkio_counters(const string_field_t& dev_field)
+{
+    dev_t dev;
+    if (!parse_major_minor(dev_field, dev))
+        return NULL;
+
+    size_t idx = 0;
+    while (idx < m_blkio_devices.size() && m_blkio_devices[idx].dev != dev)
+        idx++;
+
+    if (idx == m_blkio_devices.size()) {
+        // new device: this is the only case where memory gets allocated
+        blkio_device_t newdev;
+        newdev.dev = dev;
+        newdev.prev_valid = false;
+        auto it = m_blkio_device_names.find(dev);
+        if (it != m_blkio_device_names.end())
+            newdev.name = it->second;
+        else
+            newdev.name = std::string(dev_field.ptr, dev_field.len);
+        m_blkio_devices.push_back(newdev);
+        m_blkio_counters.resize(m_blkio_devices.size() * BLKIO_COUNTER_MAX, 0);
+        m_blkio_prev_counters.resize(m_blkio_devices.size() * BLKIO_COUNTER_MAX, 0);
+    }
+
+    m_blkio_devices[idx].present = true;
+    return &m_blkio_counters[idx * BLKIO_COUNTER_MAX];
+}
+
+bool CMonitorCgroups::read_blkio_v1_counters(FastFileReader& reader, BlkioCounter first_counter)
+{
+    // clang-format off
+    /*
+        blkio.throttle.io_service_bytes and blkio.throttle.io_serviced have a format like:
+
+            8:0 Read 273
+            8:0 Write 0
+            8:0 Sync 273
+            8:0 Async 0
+            8:0 Discard 0
+            8:0 Total 273
+            Total 546
+    */
+    // clang-format on
+
+    if (!reader.open_or_rewind())
+        return false;
+
+    string_field_t fields[3];
+    for (const char* line = reader.get_next_line(); line; line = reader.get_next_line()) {
+        if (split_fields_on_whitespace(line, fields, 3) != 3)
+            continue;
+
+        unsigned int offset;
+        if (fields[1].len == 4 && strncmp(fields[1].ptr, "Read", 4) == 0)
+            offset = 0;
+        else if (fields[1].len == 5 && strncmp(fields[1].ptr, "Write", 5) == 0)
+            offset = 1;
+        else if (fields[1].len == 7 && strncmp(fields[1].ptr, "Discard", 7) == 0)
+            offset = 2;
+        else
+            continue; // Sync, Async and Total are combinations of the others
+
+        uint64_t* counters = get_blkio_counters(fields[0]);
+        if (counters)
+            string_field2int(fields[2], counters[first_counter + offset]);
+    }
+    return true;
+}
+
+bool CMonitorCgroups::read_blkio_v2_counters()
+{
+    // clang-format off
+    /*
+        io.stat has a format like:
+
+            8:16 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+            8:0 rbytes=90430464 wbytes=299008000 rios=8950 wios=1252 dbytes=50331648 dios=3021
+
+        where devices without any IO are omitted and some kernels add more keys at the end of the line
+    */
+    // clang-format on
+
+    static const struct {
+        const char* key;
+        size_t len;
+        BlkioCounter counter;
+    } keys[] = {
+        { "rbytes=", 7, BLKIO_RBYTES },
+        { "wbytes=", 7, BLKIO_WBYTES },
+        { "dbytes=", 7, BLKIO_DBYTES },
+        { "rios=", 5, BLKIO_RIOS },
+        { "wios=", 5, BLKIO_WIOS },
+        { "dios=", 5, BLKIO_DIOS },
+    };
+
+    if (!m_cgroup_blkio_v2_io_stat.open_or_rewind())
+        return false;
+
+    string_field_t fields[BLKIO_MAX_FIELDS];
+    for (const char* line = m_cgroup_blkio_v2_io_stat.get_next_line(); line;
+         line = m_cgroup_blkio_v2_io_stat.get_next_line()) {
+        size_t nfields = split_fields_on_whitespace(line, fields, BLKIO_MAX_FIELDS);
+        if (nfields < 2)
+            continue;
+
+        uint64_t* counters = get_blkio_counters(fields[0]);
+        if (!counters)
+            continue;
+
+        for (size_t f = 1; f < nfields; f++) {
+            for (const auto& k : keys) {
+                if (fields[f].len > k.len && strncmp(fields[f].ptr, k.key, k.len) == 0) {
+                    string_field_t value = { fields[f].ptr + k.len, fields[f].len - k.len };
+                    string_field2int(value, counters[k.counter]);
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - Functions used by the cmonitor_collector engine
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroups::init_blkio(const std::string& cgroup_prefix_for_test)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_BLKIO) == 0)
+        return;
+
+    // see init_memory() for the reason behind reopen_each_time
+    bool reopen_each_time = !cgroup_prefix_for_test.empty();
+
+    FastFileReader* main_reader = NULL;
+    switch (m_nCGroupsFound) {
+    case CG_VERSION1:
+        m_cgroup_blkio_v1_service_bytes.set_file(
+            m_cgroup_blkio_kernel_path + "/blkio.throttle.io_service_bytes", reopen_each_time);
+        m_cgroup_blkio_v1_serviced.set_file(
+            m_cgroup_blkio_kernel_path + "/blkio.throttle.io_serviced", reopen_each_time);
+        main_reader = &m_cgroup_blkio_v1_service_bytes;
+        break;
+
+    case CG_VERSION2:
+        m_cgroup_blkio_v2_io_stat.set_file(m_cgroup_blkio_kernel_path + "/io.stat", reopen_each_time);
+        main_reader = &m_cgroup_blkio_v2_io_stat;
+        break;
+
+    case CG_NONE:
+        assert(0);
+        return;
+    }
+
+    if (m_cgroup_blkio_kernel_path.empty() || !main_reader->open_or_rewind()) {
+        // e.g. the 'io' controller has not been enabled in the cgroup.subtree_control of the parent cgroup
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_BLKIO;
+        CMonitorLogger::instance()->LogDebug(
+            "Could not read the blkio statistics file '%s'. Disabling monitoring of blkio cgroup.\n",
+            main_reader->get_file().c_str());
+        return;
+    }
+
+    // map the major:minor numbers to kernel device names once for all; io.stat and blkio files report
+    // only the device numbers while /proc/diskstats has a format like:
+    //      8       0 sda 10244 3105 834706 ...
+    FastFileReader diskstats(m_proc_prefix + "/proc/diskstats");
+    diskstats.set_streaming_mode(true); // on servers with many disks it might exceed the FastFileReader buffer
+    if (diskstats.open_or_rewind()) {
+        string_field_t fields[3];
+        for (const char* line = diskstats.get_next_line(); line; line = diskstats.get_next_line()) {
+            uint64_t major, minor;
+            if (split_fields_on_whitespace(line, fields, 3) == 3 && string_field2int(fields[0], major)
+                && string_field2int(fields[1], minor))
+                m_blkio_device_names[makedev(major, minor)] = std::string(fields[2].ptr, fields[2].len);
+        }
+    } else
+        CMonitorLogger::instance()->LogDebug(
+            "Could not read %s: block devices will be identified by their major:minor numbers.\n",
+            diskstats.get_file().c_str());
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_blkio) / sizeof(g_prometheus_kpi_cgroup_blkio[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_blkio, size);
+    }
+#endif
+
+    CMonitorLogger::instance()->LogDebug("Successfully initialized blkio cgroup monitoring.\n");
+}
+
+void CMonitorCgroups::sample_blkio(double elapsed_sec, OutputFields output_opts)
+{
+    if (m_nCGroupsFound == CG_NONE)
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_BLKIO) == 0)
+        return;
+
+    bool print = (m_num_blkio_samples_collected > 0) && output_opts != PF_NONE && elapsed_sec > MIN_ELAPSED_SECS;
+    m_num_blkio_samples_collected++;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // See
+    //   https://www.kernel.org/doc/Documentation/cgroup-v1/blkio-controller.txt
+    //   https://www.kernel.org/doc/html/latest/admin-guide/cgroup-v2.html#io-interface-files
+
+    for (auto& dev : m_blkio_devices)
+        dev.present = false;
+    std::fill(m_blkio_counters.begin(), m_blkio_counters.end(), 0);
+
+    bool success = false;
+    switch (m_nCGroupsFound) {
+    case CG_VERSION1:
+        success = read_blkio_v1_counters(m_cgroup_blkio_v1_service_bytes, BLKIO_RBYTES)
+            && read_blkio_v1_counters(m_cgroup_blkio_v1_serviced, BLKIO_RIOS);
+        break;
+    case CG_VERSION2:
+        success = read_blkio_v2_counters();
+        break;
+    case CG_NONE:
+        break;
+    }
+    if (!success) {
+        CMonitorLogger::instance()->LogDebug("Cannot read the blkio statistics files");
+        return;
+    }
+
+    // the section is omitted when no device has done IO yet (e.g. cgroup v1 files contain just "Total 0"):
+    print = print && std::any_of(m_blkio_devices.begin(), m_blkio_devices.end(), // force newline
+                         [](const blkio_device_t& dev) { return dev.present && dev.prev_valid; });
+    if (print) {
+        m_pOutput->psection_start("cgroup_blkio", m_output_labels);
+        for (size_t i = 0; i < m_blkio_devices.size(); i++) {
+            const blkio_device_t& dev = m_blkio_devices[i];
+            if (!dev.present || !dev.prev_valid)
+                continue;
+
+            double rates[BLKIO_COUNTER_MAX];
+            const uint64_t* current = &m_blkio_counters[i * BLKIO_COUNTER_MAX];
+            const uint64_t* previous = &m_blkio_prev_counters[i * BLKIO_COUNTER_MAX];
+            for (unsigned int c = 0; c < BLKIO_COUNTER_MAX; c++)
+                // counters are reset when the device gets removed and re-added to the cgroup:
+                rates[c] = (current[c] >= previous[c]) ? (double)(current[c] - previous[c]) / elapsed_sec : 0;
+
+            m_pOutput->psubsection_start(dev.name.c_str());
+            switch (output_opts) {
+            case PF_NONE:
+                assert(0);
+                break;
+            case PF_ALL:
+                for (unsigned int c = 0; c < BLKIO_COUNTER_MAX; c++)
+                    m_pOutput->pdouble(g_blkio_counter_names[c], rates[c]);
+                break;
+            case PF_USED_BY_CHART_SCRIPT_ONLY:
+                m_pOutput->pdouble(g_blkio_counter_names[BLKIO_RBYTES], rates[BLKIO_RBYTES]);
+                m_pOutput->pdouble(g_blkio_counter_names[BLKIO_WBYTES], rates[BLKIO_WBYTES]);
+                m_pOutput->pdouble(g_blkio_counter_names[BLKIO_RIOS], rates[BLKIO_RIOS]);
+                m_pOutput->pdouble(g_blkio_counter_names[BLKIO_WIOS], rates[BLKIO_WIOS]);
+                break;
+            }
+            m_pOutput->psubsection_end();
+        }
+        m_pOutput->psection_end();
+    }
+
+    // save new values for next sample:
+    for (auto& dev : m_blkio_devices)
+        dev.prev_valid = dev.present;
+    m_blkio_counters.swap(m_blkio_prev_counters);
+}
@@ -24,18 +24,12 @@
 #include "utils_string.h"
 #include <assert.h>
 #include <fstream>
+#include <glob.h>
 #include <pwd.h>
 #include <sstream>
 #include <sys/stat.h>
 #include <sys/types.h>
 
-// ----------------------------------------------------------------------------------
-// Constants
-// ----------------------------------------------------------------------------------
-
-#define GIGABYTE (1000ul * 1000ul * 1000ul)
-#define MEMORY_LIMIT_MAX_VALUE (1000 * 1000 * GIGABYTE)
-
 // ----------------------------------------------------------------------------------
 // C++ Helper functions
 // ----------------------------------------------------------------------------------
@@ -292,7 +286,7 @@ void CMonitorCgroups::init( // force newline
         v1_read_limits();
         break;
     case CG_VERSION2:
-        v2_read_limits();
+        v2_read_limits(cgroup_prefix_for_test);
         break;
     }
 
@@ -304,6 +298,11 @@ void CMonitorCgroups::init( // force newline
     init_memory(cgroup_prefix_for_test);
     init_network(cgroup_prefix_for_test);
     init_processes(cgroup_prefix_for_test);
+    init_blkio(cgroup_prefix_for_test);
+    init_pressure(cgroup_prefix_for_test);
+    init_pids(cgroup_prefix_for_test);
+    init_hugetlb(cgroup_prefix_for_test);
+    init_tcp(cgroup_prefix_for_test);
 }
 
 bool CMonitorCgroups::detect_cgroup_ver_and_paths_from_myself(
@@ -368,6 +367,9 @@ bool CMonitorCgroups::detect_cgroup_ver_and_paths_from_myself(
         m_cgroup_memory_kernel_path = cgroup_prefix_for_test + cgroupsv2_basepath;
         m_cgroup_cpuacct_kernel_path = cgroup_prefix_for_test + cgroupsv2_basepath;
         m_cgroup_cpuset_kernel_path = cgroup_prefix_for_test + cgroupsv2_basepath;
+        m_cgroup_blkio_kernel_path = cgroup_prefix_for_test + cgroupsv2_basepath;
+        m_cgroup_pids_kernel_path = cgroup_prefix_for_test + cgroupsv2_basepath;
+        m_cgroup_hugetlb_kernel_path = cgroup_prefix_for_test + cgroupsv2_basepath;
 
         CMonitorLogger::instance()->LogDebug("Detected cgroups v2 with path %s\n", m_cgroup_memory_kernel_path.c_str());
     } else {
@@ -402,10 +404,25 @@ bool CMonitorCgroups::detect_cgroup_ver_and_paths_from_myself(
             return false;
         }
 
+        // the 'blkio' controller is optional: if missing, only the monitoring of blkio cgroup will be disabled
+        if (!get_cgroup_v1_abs_path_prefix_for_this_pid("blkio", m_cgroup_blkio_kernel_path))
+            CMonitorLogger::instance()->LogDebug("Could not find the 'blkio' cgroup path prefix.\n");
+        // ...same for the 'pids' and 'hugetlb' controllers:
+        if (!get_cgroup_v1_abs_path_prefix_for_this_pid("pids", m_cgroup_pids_kernel_path))
+            CMonitorLogger::instance()->LogDebug("Could not find the 'pids' cgroup path prefix.\n");
+        if (!get_cgroup_v1_abs_path_prefix_for_this_pid("hugetlb", m_cgroup_hugetlb_kernel_path))
+            CMonitorLogger::instance()->LogDebug("Could not find the 'hugetlb' cgroup path prefix.\n");
+
         // add unit-testing special prefix if any:
         m_cgroup_memory_kernel_path = cgroup_prefix_for_test + m_cgroup_memory_kernel_path;
         m_cgroup_cpuacct_kernel_path = cgroup_prefix_for_test + m_cgroup_cpuacct_kernel_path;
         m_cgroup_cpuset_kernel_path = cgroup_prefix_for_test + m_cgroup_cpuset_kernel_path;
+        if (!m_cgroup_blkio_kernel_path.empty())
+            m_cgroup_blkio_kernel_path = cgroup_prefix_for_test + m_cgroup_blkio_kernel_path;
+        if (!m_cgroup_pids_kernel_path.empty())
+            m_cgroup_pids_kernel_path = cgroup_prefix_for_test + m_cgroup_pids_kernel_path;
+        if (!m_cgroup_hugetlb_kernel_path.empty())
+            m_cgroup_hugetlb_kernel_path = cgroup_prefix_for_test + m_cgroup_hugetlb_kernel_path;
     }
 
     CMonitorLogger::instance()->LogDebug(
@@ -471,6 +488,12 @@ bool CMonitorCgroups::detect_my_own_cgroup()
             m_cgroup_memory_kernel_path += "/" + cgroup_paths["memory"];
             m_cgroup_cpuacct_kernel_path += "/" + cgroup_paths[m_cpuacct_controller_name];
             m_cgroup_cpuset_kernel_path += "/" + cgroup_paths["cpuset"];
+            if (!m_cgroup_blkio_kernel_path.empty() && cgroup_paths.find("blkio") != cgroup_paths.end())
+                m_cgroup_blkio_kernel_path += "/" + cgroup_paths["blkio"];
+            if (!m_cgroup_pids_kernel_path.empty() && cgroup_paths.find("pids") != cgroup_paths.end())
+                m_cgroup_pids_kernel_path += "/" + cgroup_paths["pids"];
+            if (!m_cgroup_hugetlb_kernel_path.empty() && cgroup_paths.find("hugetlb") != cgroup_paths.end())
+                m_cgroup_hugetlb_kernel_path += "/" + cgroup_paths["hugetlb"];
             CMonitorLogger::instance()->LogDebug(
                 "Adjusting cpuset cgroup path to %s\n", m_cgroup_cpuset_kernel_path.c_str());
             CMonitorLogger::instance()->LogDebug(
@@ -512,6 +535,9 @@ bool CMonitorCgroups::detect_my_own_cgroup()
             m_cgroup_memory_kernel_path += "/" + m_cgroup_systemd_name;
             m_cgroup_cpuacct_kernel_path += "/" + m_cgroup_systemd_name;
             m_cgroup_cpuset_kernel_path += "/" + m_cgroup_systemd_name;
+            m_cgroup_blkio_kernel_path += "/" + m_cgroup_systemd_name;
+            m_cgroup_pids_kernel_path += "/" + m_cgroup_systemd_name;
+            m_cgroup_hugetlb_kernel_path += "/" + m_cgroup_systemd_name;
             CMonitorLogger::instance()->LogDebug(
                 "Adjusting cpuset cgroup path to %s\n", m_cgroup_cpuset_kernel_path.c_str());
             CMonitorLogger::instance()->LogDebug(
@@ -548,6 +574,12 @@ bool CMonitorCgroups::detect_user_provided_cgroup()
     m_cgroup_memory_kernel_path += "/" + m_pCfg->m_strCGroupName;
     m_cgroup_cpuacct_kernel_path += "/" + m_pCfg->m_strCGroupName;
     m_cgroup_cpuset_kernel_path += "/" + m_pCfg->m_strCGroupName;
+    if (!m_cgroup_blkio_kernel_path.empty())
+        m_cgroup_blkio_kernel_path += "/" + m_pCfg->m_strCGroupName;
+    if (!m_cgroup_pids_kernel_path.empty())
+        m_cgroup_pids_kernel_path += "/" + m_pCfg->m_strCGroupName;
+    if (!m_cgroup_hugetlb_kernel_path.empty())
+        m_cgroup_hugetlb_kernel_path += "/" + m_pCfg->m_strCGroupName;
 
     // verify the provided cgroup name is actually existing on disk:
     if (!file_or_dir_exists(m_cgroup_memory_kernel_path.c_str())) {
@@ -572,6 +604,49 @@ bool CMonitorCgroups::detect_user_provided_cgroup()
     return true;
 }
 
+bool CMonitorCgroups::get_cgroups_mount_point(std::string& pathOUT, const std::string& cgroup_prefix_for_test,
+    const std::string& proc_prefix_for_test, uint64_t my_own_pid_for_test)
+{
+    // only the cgroup mount point is needed: it's not important which cgroup this process belongs to
+    m_proc_prefix = proc_prefix_for_test;
+    if (!detect_cgroup_ver_and_paths_from_myself(cgroup_prefix_for_test, my_own_pid_for_test))
+        return false; // the function has already logged errors
+
+    // with cgroups v1 all controllers share the same tree of cgroup names: just use the memory controller one
+    pathOUT = m_cgroup_memory_kernel_path;
+    return true;
+}
+
+bool CMonitorCgroups::list_cgroups_matching(const std::string& pattern, std::vector<std::string>& namesOUT)
+{
+    std::string prefix;
+    if (!get_cgroups_mount_point(prefix))
+        return false; // the function has already logged errors
+    prefix += "/";
+
+    glob_t globbuf;
+    int ret = glob((prefix + pattern).c_str(), GLOB_ONLYDIR, NULL, &globbuf);
+    if (ret == GLOB_NOMATCH) {
+        globfree(&globbuf);
+        return true; // no error, just no cgroup matching (yet)
+    }
+    if (ret != 0) {
+        CMonitorLogger::instance()->LogError("Failed to expand the cgroup pattern [%s].", pattern.c_str());
+        globfree(&globbuf);
+        return false;
+    }
+
+    for (size_t i = 0; i < globbuf.gl_pathc; i++) {
+        // GLOB_ONLYDIR is just a hint: regular files like "memory.stat" might still match
+        struct stat st;
+        if (stat(globbuf.gl_pathv[i], &st) != 0 || !S_ISDIR(st.st_mode))
+            continue;
+        namesOUT.push_back(std::string(globbuf.gl_pathv[i]).substr(prefix.size()));
+    }
+    globfree(&globbuf);
+    return true;
+}
+
 void CMonitorCgroups::v1_read_limits()
 {
     // READ LIMITS IMPOSED BY CGROUPS
@@ -626,7 +701,7 @@ void CMonitorCgroups::v1_read_limits()
         m_cgroup_memory_limit_bytes, m_cgroup_memory_kernel_path.c_str());
 }
 
-void CMonitorCgroups::v2_read_limits()
+void CMonitorCgroups::v2_read_limits(const std::string& cgroup_prefix_for_test)
 {
     // READ LIMITS IMPOSED BY CGROUPS
     // see https://www.kernel.org/doc/html/latest/admin-guide/cgroup-v2.html
@@ -650,10 +725,15 @@ void CMonitorCgroups::v2_read_limits()
         CMonitorLogger::instance()->LogDebug("Found cpuset cgroup limiting to CPUs %s, mounted at %s\n",
             stl_container2string(m_cgroup_cpus, ",").c_str(), m_cgroup_cpuset_kernel_path.c_str());
 
-    // FIXME: m_cgroup_cpuacct_quota_us might assume the special value "max" reported by the
-    // cgroup controller... it just means "no limit"... we need to handle that using UINT64_MAX
-    if (!read_two_integers(
-            m_cgroup_cpuacct_kernel_path + "/cpu.max", m_cgroup_cpuacct_quota_us, m_cgroup_cpuacct_period_us)) {
+    // NOTE: m_cgroup_cpuacct_quota_us might assume the special value "max" reported by the
+    // cgroup controller... it just means "no limit"... we set UINT64_MAX in that case
+    // NOTE2: the cpu.max and cpu.weight readers are kept for the whole run, since the limits get refreshed at
+    //        every sample by sample_cpuacct(); see init_memory() for the reason behind reopen_each_time
+    bool reopen_each_time = !cgroup_prefix_for_test.empty();
+    m_cgroup_cpuacct_v2_reader_cpu_max.set_file(m_cgroup_cpuacct_kernel_path + "/cpu.max", reopen_each_time);
+    m_cgroup_cpuacct_v2_reader_cpu_weight.set_file(
+        m_cgroup_cpuacct_kernel_path + "/cpu.weight", reopen_each_time);
+    if (!read_cpu_limits_v2()) {
         CMonitorLogger::instance()->LogError(
             "Could not read the CPU period from 'cpuacct' cgroup. Assuming no CPU limit.\n");
         m_cgroup_cpuacct_quota_us = UINT64_MAX;
@@ -779,7 +859,7 @@ void CMonitorCgroups::output_config()
     if (m_nCGroupsFound == CG_NONE)
         return;
 
-    m_pOutput->psection_start("cgroup_config");
+    m_pOutput->psection_start("cgroup_config", m_output_labels);
 
     // the cgroup name & version
     m_pOutput->pstring("name", m_cgroup_systemd_name.c_str());
@@ -817,6 +897,34 @@ bool CMonitorCgroups::cgroup_still_exists()
         file_or_dir_exists(m_cgroup_cpuset_kernel_path.c_str());
 }
 
+std::set<std::string> CMonitorCgroups::get_cgroup_dirs() const
+{
+    // with cgroups v2 all paths are identical
+    return { m_cgroup_memory_kernel_path, m_cgroup_cpuacct_kernel_path, m_cgroup_cpuset_kernel_path };
+}
+
+std::string CMonitorCgroups::get_cgroup_events_file() const
+{
+    if (m_nCGroupsFound != CG_VERSION2)
+        return "";
+    return m_cgroup_memory_kernel_path + "/cgroup.events";
+}
+
+bool CMonitorCgroups::cgroup_is_populated() const
+{
+    // the cgroup.events file has a format like:
+    //    populated 1
+    //    frozen 0
+    // where "populated" is 1 as long as the cgroup or any of its descendants contains some process
+    FastFileReader reader(get_cgroup_events_file());
+    key_value_map_t values;
+    numeric_parser_stats_t unused;
+    if (!reader.read_numeric_stats({ "populated" }, values, unused))
+        return false; // the cgroup has been removed
+    auto it = values.find("populated");
+    return it == values.end() || it->second != 0;
+}
+
 void CMonitorCgroups::get_list_monitored_files(std::set<std::string>& list)
 {
     //------------------------------------------------------------------------------
@@ -855,6 +963,53 @@ void CMonitorCgroups::get_list_monitored_files(std::set<std::string>& list)
             list.insert(m_cgroup_memory_v2_events.get_file());
             break;
         }
+
+        if (m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY_EXT) {
+            for (unsigned int i = 0; i < MEMEXT_FILE_MAX; i++)
+                if (!m_cgroup_memory_ext[i].get_file().empty())
+                    list.insert(m_cgroup_memory_ext[i].get_file());
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // blkio controller
+    //------------------------------------------------------------------------------
+    if (m_pCfg->m_nCollectFlags & PK_CGROUP_BLKIO) {
+        switch (m_nCGroupsFound) {
+        case CG_NONE:
+            return;
+        case CG_VERSION1:
+            list.insert(m_cgroup_blkio_v1_service_bytes.get_file());
+            list.insert(m_cgroup_blkio_v1_serviced.get_file());
+            break;
+        case CG_VERSION2:
+            list.insert(m_cgroup_blkio_v2_io_stat.get_file());
+            break;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // pressure stall information
+    //------------------------------------------------------------------------------
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PRESSURE) && m_nCGroupsFound == CG_VERSION2) {
+        for (unsigned int i = 0; i < PSI_MAX; i++)
+            list.insert(m_pressure[i].reader.get_file());
+    }
+
+    //------------------------------------------------------------------------------
+    // pids and hugetlb controllers
+    //------------------------------------------------------------------------------
+    if (m_pCfg->m_nCollectFlags & PK_CGROUP_PIDS) {
+        list.insert(m_cgroup_pids_current.get_file());
+        list.insert(m_cgroup_pids_max.get_file());
+        list.insert(m_cgroup_pids_events.get_file());
+    }
+    if (m_pCfg->m_nCollectFlags & PK_CGROUP_HUGETLB) {
+        for (const auto& pagesize : m_hugetlb_pagesizes) {
+            list.insert(pagesize.current.get_file());
+            list.insert(pagesize.limit.get_file());
+            list.insert(pagesize.failures.get_file());
+        }
     }
 
     //------------------------------------------------------------------------------
@@ -862,6 +1017,8 @@ void CMonitorCgroups::get_list_monitored_files(std::set<std::string>& list)
     //------------------------------------------------------------------------------
     if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PROCESSES) || // fn
         (m_pCfg->m_nCollectFlags & PK_CGROUP_THREADS) || // fn
-        (m_pCfg->m_nCollectFlags & PK_CGROUP_NETWORK_INTERFACES))
+        (m_pCfg->m_nCollectFlags & PK_CGROUP_NETWORK_INTERFACES) || // fn
+        (m_pCfg->m_nCollectFlags & PK_CGROUP_TCP) || // fn
+        (m_pCfg->m_nCollectFlags & PK_CGROUP_NETSTAT))
         list.insert(m_cgroup_processes_reader_pids.get_file());
 }
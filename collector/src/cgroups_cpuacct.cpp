@@ -223,7 +223,7 @@ bool CMonitorCgroups::sample_cpuacct_v1_counters_by_cpu(
             const char* pline = m_cgroup_cpuacct_v1_reader_total_cpu_stat.get_next_line();
             char label[512];
             uint64_t value;
-            cpuacct_throttling_t counter_throttling;
+            cpuacct_throttling_t counter_throttling = { 0 };
             while (pline) {
                 sscanf(pline, "%s %lu", label, &value);
                 if (strcmp(label, "nr_periods") == 0)
@@ -235,16 +235,8 @@ bool CMonitorCgroups::sample_cpuacct_v1_counters_by_cpu(
                 pline = m_cgroup_cpuacct_v1_reader_total_cpu_stat.get_next_line();
             }
 
-            if (print) {
-                m_pOutput->psubsection_start("throttling");
-                m_pOutput->plong(
-                    "nr_periods", counter_throttling.nr_periods - m_cpuacct_prev_values_for_throttling.nr_periods);
-                m_pOutput->plong("nr_throttled",
-                    counter_throttling.nr_throttled - m_cpuacct_prev_values_for_throttling.nr_throttled);
-                m_pOutput->plong("throttled_time",
-                    counter_throttling.throttled_time_nsec - m_cpuacct_prev_values_for_throttling.throttled_time_nsec);
-                m_pOutput->psubsection_end();
-            }
+            if (print)
+                output_cpuacct_throttling(counter_throttling, false /* no bursts in cgroups v1 */);
 
             // save for next cycle
             m_cpuacct_prev_values_for_throttling = counter_throttling;
@@ -260,6 +252,17 @@ bool CMonitorCgroups::sample_cpuacct_v1_counters_by_cpu(
 bool CMonitorCgroups::sample_cpuacct_v2_counters(bool print, double elapsed_sec, cpuacct_utilisation_t& total_cpu_usage)
 {
     // see https://www.kernel.org/doc/Documentation/cgroup-v2.txt
+    // In cgroups v2 the cpu.stat file has a format like:
+    //   usage_usec <num>
+    //   user_usec <num>
+    //   system_usec <num>
+    //   nr_periods <num>
+    //   nr_throttled <num>
+    //   throttled_usec <num>
+    //   nr_bursts <num>           (only on kernels >= 5.14 supporting cpu.max.burst)
+    //   burst_usec <num>          (only on kernels >= 5.14 supporting cpu.max.burst)
+    // Note that the nr_periods/nr_throttled/throttled_usec keys are present only if the "cpu" controller is
+    // enabled for the cgroup.
 
     if (!m_cgroup_cpuacct_v2_reader_total_cpu_stat.open_or_rewind()) {
         CMonitorLogger::instance()->LogError(
@@ -268,6 +271,7 @@ bool CMonitorCgroups::sample_cpuacct_v2_counters(bool print, double elapsed_sec,
     }
 
     unsigned int nFoundCpuUsageValues = 0;
+    bool has_burst_stats = false;
     std::string label;
     uint64_t value;
     cpuacct_throttling_t counter_throttling = { 0 };
@@ -294,21 +298,20 @@ bool CMonitorCgroups::sample_cpuacct_v2_counters(bool print, double elapsed_sec,
                 counter_throttling.nr_throttled = value;
             } else if (label == "throttled_usec") {
                 counter_throttling.throttled_time_nsec = value * 1000;
+            } else if (label == "nr_bursts") {
+                counter_throttling.nr_bursts = value;
+                has_burst_stats = true;
+            } else if (label == "burst_usec") {
+                counter_throttling.burst_time_nsec = value * 1000;
+                has_burst_stats = true;
             }
         }
 
         pline = m_cgroup_cpuacct_v2_reader_total_cpu_stat.get_next_line();
     }
 
-    if (print) {
-        m_pOutput->psubsection_start("throttling");
-        m_pOutput->plong("nr_periods", counter_throttling.nr_periods - m_cpuacct_prev_values_for_throttling.nr_periods);
-        m_pOutput->plong(
-            "nr_throttled", counter_throttling.nr_throttled - m_cpuacct_prev_values_for_throttling.nr_throttled);
-        m_pOutput->plong("throttled_time",
-            counter_throttling.throttled_time_nsec - m_cpuacct_prev_values_for_throttling.throttled_time_nsec);
-        m_pOutput->psubsection_end();
-    }
+    if (print)
+        output_cpuacct_throttling(counter_throttling, has_burst_stats);
 
     // save for next cycle
     m_cpuacct_prev_values_for_throttling = counter_throttling;
@@ -316,6 +319,88 @@ bool CMonitorCgroups::sample_cpuacct_v2_counters(bool print, double elapsed_sec,
     return nFoundCpuUsageValues == 2;
 }
 
+void CMonitorCgroups::output_cpuacct_throttling(const cpuacct_throttling_t& counters, bool has_burst_stats)
+{
+    const cpuacct_throttling_t& prev = m_cpuacct_prev_values_for_throttling;
+    uint64_t nr_periods = counters.nr_periods - prev.nr_periods;
+    uint64_t nr_throttled = counters.nr_throttled - prev.nr_throttled;
+    uint64_t throttled_time_nsec = counters.throttled_time_nsec - prev.throttled_time_nsec;
+
+    m_pOutput->psubsection_start("throttling");
+    m_pOutput->plong("nr_periods", nr_periods);
+    m_pOutput->plong("nr_throttled", nr_throttled);
+    m_pOutput->plong("throttled_time", throttled_time_nsec);
+
+    // derived metrics: how often the quota was exhausted and, when that happened, for how long the cgroup
+    // had to wait for the next period (on average)
+    m_pOutput->pdouble("throttled_periods_pct", nr_periods ? 100.0 * (double)nr_throttled / (double)nr_periods : 0);
+    m_pOutput->pdouble(
+        "avg_throttled_time", nr_throttled ? (double)throttled_time_nsec / (double)nr_throttled : 0);
+
+    if (has_burst_stats) {
+        m_pOutput->plong("nr_bursts", counters.nr_bursts - prev.nr_bursts);
+        m_pOutput->plong("burst_time", counters.burst_time_nsec - prev.burst_time_nsec);
+    }
+    m_pOutput->psubsection_end();
+}
+
+void CMonitorCgroups::output_cpuacct_quota(double elapsed_sec, const cpuacct_utilisation_t& total_cpu_usage)
+{
+    const cpuacct_utilisation_t& prev = m_cpuacct_prev_values_for_total_cpu;
+    double used_nsec = (double)(total_cpu_usage.counter_nsec_user_mode - prev.counter_nsec_user_mode)
+        + (double)(total_cpu_usage.counter_nsec_sys_mode - prev.counter_nsec_sys_mode);
+
+    m_pOutput->psubsection_start("quota");
+    if (m_cgroup_cpuacct_quota_us == UINT64_MAX || m_cgroup_cpuacct_period_us == 0) {
+        m_pOutput->pdouble("quota_cpus", -1.0);
+        m_pOutput->pdouble("quota_used_pct", -1.0);
+    } else {
+        // the quota is expressed as "quota_us every period_us", i.e. as a (possibly fractional) number of CPUs:
+        double quota_cpus = (double)m_cgroup_cpuacct_quota_us / (double)m_cgroup_cpuacct_period_us;
+        m_pOutput->pdouble("quota_cpus", quota_cpus);
+        m_pOutput->pdouble("quota_used_pct", quota_cpus > 0 ? 100 * used_nsec / (quota_cpus * elapsed_sec * 1E9) : 0);
+    }
+    if (m_cgroup_cpu_weight)
+        m_pOutput->plong("weight", m_cgroup_cpu_weight);
+    m_pOutput->psubsection_end();
+}
+
+bool CMonitorCgroups::read_cpu_limits_v2()
+{
+    // cpu.max has a format like:
+    //   $MAX $PERIOD
+    // where $MAX can be the special string "max" to indicate there's no limit: we use UINT64_MAX in that case.
+    // cpu.weight is a single integer in the range [1, 10000].
+    // NOTE: these limits can be changed at runtime (e.g. by a Kubernetes Vertical Pod Autoscaler) so this function
+    //       gets invoked at every sample; a missing or unreadable file leaves the previous limits untouched.
+
+    uint64_t weight = 0;
+    if (m_cgroup_cpuacct_v2_reader_cpu_weight.read_integer(weight))
+        m_cgroup_cpu_weight = weight;
+
+    if (!m_cgroup_cpuacct_v2_reader_cpu_max.open_or_rewind())
+        return false;
+    const char* pline = m_cgroup_cpuacct_v2_reader_cpu_max.get_next_line();
+    if (pline == NULL)
+        return false;
+
+    std::string quota;
+    uint64_t quota_us = 0, period_us = 0;
+    if (!split_label_value(pline, ' ', quota, period_us) || period_us == 0)
+        return false;
+    if (quota == "max")
+        quota_us = UINT64_MAX;
+    else if (!string2int(quota.c_str(), quota_us))
+        return false;
+
+    if (quota_us != m_cgroup_cpuacct_quota_us || period_us != m_cgroup_cpuacct_period_us)
+        CMonitorLogger::instance()->LogDebug("CPU limit of cgroup [%s] is now %lu/%lu usecs\n",
+            m_cgroup_systemd_name.c_str(), quota_us, period_us);
+    m_cgroup_cpuacct_quota_us = quota_us;
+    m_cgroup_cpuacct_period_us = period_us;
+    return true;
+}
+
 // ----------------------------------------------------------------------------------
 // CMonitorCgroups - Functions used by the cmonitor_collector engine
 // ----------------------------------------------------------------------------------
@@ -413,8 +498,12 @@ void CMonitorCgroups::sample_cpuacct(double elapsed_sec)
     bool print = (m_num_cpuacct_samples_collected > 0);
     m_num_cpuacct_samples_collected++;
 
+    // in cgroups v2 the CPU limits are refreshed at every sample since they might change at runtime
+    if (m_nCGroupsFound == CG_VERSION2)
+        read_cpu_limits_v2();
+
     if (print)
-        m_pOutput->psection_start("cgroup_cpuacct_stats");
+        m_pOutput->psection_start("cgroup_cpuacct_stats", m_output_labels);
 
     cpuacct_utilisation_t total_cpu_usage = { 0 };
     bool bValidData = false;
@@ -455,6 +544,8 @@ void CMonitorCgroups::sample_cpuacct(double elapsed_sec)
             m_pOutput->pdouble("user", cpuUserPercent);
             m_pOutput->pdouble("sys", cpuSysPercent);
             m_pOutput->psubsection_end();
+
+            output_cpuacct_quota(elapsed_sec, total_cpu_usage);
         }
 
         // save for next cycle
@@ -0,0 +1,155 @@
+/*
+ * cgroups_hugetlb.cpp -- code for collecting CGROUP HUGETLB statistics
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "output_frontend.h"
+#include "utils_string.h"
+#include <assert.h>
+#include <dirent.h>
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - Functions used by the cmonitor_collector engine
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroups::init_hugetlb(const std::string& cgroup_prefix_for_test)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_HUGETLB) == 0)
+        return;
+
+    // see init_memory() for the reason behind reopen_each_time
+    bool reopen_each_time = !cgroup_prefix_for_test.empty();
+
+    // the huge page sizes supported by the system are not known in advance: they are learnt from the names of
+    // the files of the hugetlb controller, e.g. "hugetlb.2MB.current" (v2) or "hugetlb.2MB.usage_in_bytes" (v1)
+    const char* usage_suffix = (m_nCGroupsFound == CG_VERSION1) ? ".usage_in_bytes" : ".current";
+    size_t usage_suffix_len = strlen(usage_suffix);
+    std::set<std::string> pagesizes; // sorted, to get a stable output
+    DIR* dir = m_cgroup_hugetlb_kernel_path.empty() ? NULL : opendir(m_cgroup_hugetlb_kernel_path.c_str());
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            size_t len = strlen(entry->d_name);
+            if (strncmp(entry->d_name, "hugetlb.", 8) == 0 && len > 8 + usage_suffix_len
+                && strcmp(entry->d_name + len - usage_suffix_len, usage_suffix) == 0) {
+                std::string name(entry->d_name + 8, len - 8 - usage_suffix_len);
+                if (name.find('.') == std::string::npos) // skip e.g. "hugetlb.2MB.rsvd.current"
+                    pagesizes.insert(name);
+            }
+        }
+        closedir(dir);
+    }
+    if (pagesizes.empty()) {
+        // e.g. the 'hugetlb' controller has not been enabled in the cgroup.subtree_control of the parent cgroup
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_HUGETLB;
+        CMonitorLogger::instance()->LogError(
+            "Could not find any huge page size in '%s'. Disabling monitoring of hugetlb cgroup.\n",
+            m_cgroup_hugetlb_kernel_path.c_str());
+        return;
+    }
+
+    // all files are kept open for the whole run, so that each sample costs a single pread() per file
+    for (const auto& name : pagesizes) {
+        m_hugetlb_pagesizes.emplace_back();
+        hugetlb_pagesize_t& pagesize = m_hugetlb_pagesizes.back();
+        std::string prefix = m_cgroup_hugetlb_kernel_path + "/hugetlb." + name;
+        pagesize.name = name;
+        pagesize.current.set_file(prefix + usage_suffix, reopen_each_time);
+        switch (m_nCGroupsFound) {
+        case CG_VERSION1:
+            pagesize.max_usage.set_file(prefix + ".max_usage_in_bytes", reopen_each_time);
+            pagesize.limit.set_file(prefix + ".limit_in_bytes", reopen_each_time);
+            pagesize.failures.set_file(prefix + ".failcnt", reopen_each_time);
+            break;
+        case CG_VERSION2:
+            pagesize.limit.set_file(prefix + ".max", reopen_each_time);
+            pagesize.failures.set_file(prefix + ".events", reopen_each_time);
+            break;
+        case CG_NONE:
+            assert(0);
+            return;
+        }
+        pagesize.prev_failures = 0;
+        pagesize.prev_valid = false;
+    }
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_hugetlb) / sizeof(g_prometheus_kpi_cgroup_hugetlb[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_hugetlb, size);
+    }
+#endif
+
+    CMonitorLogger::instance()->LogDebug(
+        "Successfully initialized hugetlb cgroup monitoring for %zu huge page sizes.\n", pagesizes.size());
+}
+
+void CMonitorCgroups::sample_hugetlb(OutputFields output_opts)
+{
+    if (m_nCGroupsFound == CG_NONE)
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_HUGETLB) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // See https://docs.kernel.org/admin-guide/cgroup-v2.html#hugetlb
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_start("cgroup_hugetlb", m_output_labels);
+
+    for (auto& pagesize : m_hugetlb_pagesizes) {
+        uint64_t current;
+        if (!pagesize.current.read_integer(current)) {
+            // e.g. the cgroup has just been removed
+            CMonitorLogger::instance()->LogDebug("failed to re-open %s", pagesize.current.get_file().c_str());
+            continue;
+        }
+
+        uint64_t failures = 0;
+        bool has_failures = read_limit_failures(pagesize.failures, failures);
+
+        if (output_opts != PF_NONE) {
+            m_pOutput->psubsection_start(pagesize.name.c_str());
+            m_pOutput->plong("current", current);
+
+            uint64_t value;
+            if (!pagesize.max_usage.get_file().empty() && pagesize.max_usage.read_integer(value))
+                m_pOutput->plong("max_usage", value);
+
+            // the limit is re-read at every sample since it can be changed at runtime; cgroups v1 report
+            // "no limit" as a huge value, rounded down to the huge page size, which read_memory_limit() handles
+            uint64_t limit;
+            if (read_memory_limit(pagesize.limit, limit) && limit != UINT64_MAX) {
+                m_pOutput->plong("limit", limit);
+                m_pOutput->plong("headroom", limit > current ? limit - current : 0);
+            }
+            if (has_failures && pagesize.prev_valid)
+                m_pOutput->plong("events.max", failures - pagesize.prev_failures);
+            m_pOutput->psubsection_end();
+        }
+
+        // save new values for next sample:
+        pagesize.prev_failures = failures;
+        pagesize.prev_valid = has_failures;
+    }
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_end();
+}
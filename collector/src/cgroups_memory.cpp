@@ -29,6 +29,28 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+// ----------------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------------
+
+/* files of the memory controller read by PK_CGROUP_MEMORY_EXT, indexed by CgroupMemoryExtFile */
+static const struct {
+    const char* v1; // NULL if not available in cgroups v1
+    const char* v2; // NULL if not available in cgroups v2
+} g_cgroup_memory_ext_files[MEMEXT_FILE_MAX] = {
+    { "/memory.numa_stat", "/memory.numa_stat" }, // MEMEXT_NUMA_STAT
+    { "/memory.limit_in_bytes", "/memory.max" }, // MEMEXT_LIMIT_MAX
+    { "/memory.usage_in_bytes", NULL }, // MEMEXT_V1_USAGE
+    { "/memory.memsw.usage_in_bytes", NULL }, // MEMEXT_V1_MEMSW_USAGE
+    { "/memory.memsw.max_usage_in_bytes", NULL }, // MEMEXT_V1_MEMSW_MAX_USAGE
+    { "/memory.memsw.limit_in_bytes", NULL }, // MEMEXT_V1_MEMSW_LIMIT
+    { "/memory.memsw.failcnt", NULL }, // MEMEXT_V1_MEMSW_FAILCNT
+    { NULL, "/memory.high" }, // MEMEXT_V2_LIMIT_HIGH
+    { NULL, "/memory.events.local" }, // MEMEXT_V2_EVENTS_LOCAL
+    { NULL, "/memory.swap.current" }, // MEMEXT_V2_SWAP_CURRENT
+    { NULL, "/memory.swap.events" }, // MEMEXT_V2_SWAP_EVENTS
+};
+
 // ----------------------------------------------------------------------------------
 // CMonitorCgroups - internal helpers
 // ----------------------------------------------------------------------------------
@@ -88,6 +110,152 @@ size_t CMonitorCgroups::sample_flat_keyed_file(FastFileReader& reader, const std
     return nread;
 }
 
+void CMonitorCgroups::output_flat_keyed_file_deltas(
+    FastFileReader& reader, const std::string& label_prefix, key_value_map_t& prev_values, bool print)
+{
+    static const std::set<std::string> no_filter;
+
+    if (reader.get_file().empty())
+        return; // file not available in this system
+
+    key_value_map_t values;
+    if (sample_flat_keyed_file(reader, no_filter, label_prefix, values) == 0)
+        return;
+
+    if (print) {
+        for (auto entry : values) {
+            auto prevValue = prev_values.find(entry.first);
+            if (prevValue != prev_values.end())
+                m_pOutput->plong(entry.first.c_str(), entry.second - prevValue->second);
+        }
+    }
+
+    // save new values for next sample:
+    prev_values.swap(values);
+}
+
+bool CMonitorCgroups::read_memory_limit(FastFileReader& reader, uint64_t& limit_bytes)
+{
+    if (reader.get_file().empty())
+        return false; // file not available in this system
+
+    // cgroups v2 use the special value "max" while cgroups v1 use some crazy high value like 9*10^6 GB
+    // to indicate there's no limit: in both cases we return UINT64_MAX
+    if (!reader.read_integer_or_max(limit_bytes))
+        return false;
+    if (limit_bytes > MEMORY_LIMIT_MAX_VALUE)
+        limit_bytes = UINT64_MAX;
+    return true;
+}
+
+void CMonitorCgroups::sample_memory_numa_stat()
+{
+    // clang-format off
+    /*
+        In cgroups v2 the memory.numa_stat file has a format like (values in bytes):
+            anon N0=1351680 N1=0
+            file N0=3379200 N1=0
+            kernel_stack N0=73728 N1=0
+        In cgroups v1 the memory.numa_stat file has a format like (values in pages):
+            total=569 N0=569 N1=0
+            file=0 N0=0 N1=0
+            anon=569 N0=569 N1=0
+        Only the per-node anonymous and file-backed memory are reported.
+    */
+    // clang-format on
+
+    FastFileReader& reader = m_cgroup_memory_ext[MEMEXT_NUMA_STAT];
+    if (reader.get_file().empty() || !reader.open_or_rewind())
+        return;
+
+    uint64_t unit = (m_nCGroupsFound == CG_VERSION1) ? (uint64_t)sysconf(_SC_PAGESIZE) : 1;
+    string_field_t fields[MAX_NUMA_NODES + 1];
+    for (const char* line = reader.get_next_line(); line; line = reader.get_next_line()) {
+        const char* kpi;
+        if (strncmp(line, "anon", 4) == 0 && (line[4] == ' ' || line[4] == '='))
+            kpi = "anon";
+        else if (strncmp(line, "file", 4) == 0 && (line[4] == ' ' || line[4] == '='))
+            kpi = "file";
+        else
+            continue;
+
+        size_t nfields = split_fields_on_whitespace(line, fields, MAX_NUMA_NODES + 1);
+        for (size_t i = 1; i < nfields; i++) {
+            // each field has a format like "N0=1351680"
+            const char* eq = (const char*)memchr(fields[i].ptr, '=', fields[i].len);
+            if (fields[i].ptr[0] != 'N' || eq == NULL)
+                continue;
+
+            uint64_t value;
+            string_field_t value_field = { eq + 1, fields[i].len - (size_t)(eq + 1 - fields[i].ptr) };
+            if (!string_field2int(value_field, value))
+                continue;
+
+            std::string node(fields[i].ptr, eq - fields[i].ptr);
+            m_pOutput->plong(fmt::format("numa.{}.{}", node, kpi).c_str(), value * unit);
+        }
+    }
+}
+
+void CMonitorCgroups::sample_memory_ext(bool print, uint64_t current_bytes)
+{
+    FastFileReader* files = m_cgroup_memory_ext;
+    uint64_t value;
+
+    switch (m_nCGroupsFound) {
+    case CG_VERSION1:
+        if (files[MEMEXT_V1_USAGE].read_integer(value))
+            current_bytes = value;
+
+        // memsw.* files are present only if the kernel has swap accounting enabled
+        if (files[MEMEXT_V1_MEMSW_USAGE].read_integer(value))
+            m_pOutput->plong("memsw.usage", value);
+        if (files[MEMEXT_V1_MEMSW_MAX_USAGE].read_integer(value))
+            m_pOutput->plong("memsw.max_usage", value);
+        if (read_memory_limit(files[MEMEXT_V1_MEMSW_LIMIT], value) && value != UINT64_MAX)
+            m_pOutput->plong("limit.memsw", value);
+        if (files[MEMEXT_V1_MEMSW_FAILCNT].read_integer(value)) {
+            if (print)
+                m_pOutput->plong("events.memsw_failcnt", value - m_memory_prev_values.v1_memsw_failcnt);
+
+            // save new values for next sample:
+            m_memory_prev_values.v1_memsw_failcnt = value;
+        }
+        break;
+
+    case CG_VERSION2:
+        // the "local" events are those generated by this cgroup alone, not by its descendants
+        output_flat_keyed_file_deltas(
+            files[MEMEXT_V2_EVENTS_LOCAL], "events_local.", m_memory_prev_values.v2_events_local, print);
+        if (files[MEMEXT_V2_SWAP_CURRENT].read_integer(value))
+            m_pOutput->plong("swap.current", value);
+        output_flat_keyed_file_deltas(
+            files[MEMEXT_V2_SWAP_EVENTS], "swap_events.", m_memory_prev_values.v2_swap_events, print);
+        break;
+
+    case CG_NONE:
+        return;
+    }
+
+    sample_memory_numa_stat();
+
+    // limits are re-read at every sample since they can be changed at runtime; the headroom is the amount of
+    // memory that can still be charged to the cgroup before reaching the limit, i.e. before the kernel starts
+    // throttling and reclaiming (memory.high) or invoking the OOM killer (memory.max)
+    uint64_t limit;
+    if (read_memory_limit(files[MEMEXT_LIMIT_MAX], limit)) {
+        m_cgroup_memory_limit_bytes = limit;
+        if (limit != UINT64_MAX) {
+            m_pOutput->plong("limit.max", limit);
+            m_pOutput->plong("headroom.max", limit > current_bytes ? limit - current_bytes : 0);
+        }
+    }
+    if (read_memory_limit(files[MEMEXT_V2_LIMIT_HIGH], limit) && limit != UINT64_MAX) {
+        m_pOutput->plong("limit.high", limit);
+        m_pOutput->plong("headroom.high", limit > current_bytes ? limit - current_bytes : 0);
+    }
+}
+
 // ----------------------------------------------------------------------------------
 // CMonitorCgroups - Functions used by the cmonitor_collector engine
 // ----------------------------------------------------------------------------------
@@ -132,6 +300,9 @@ void CMonitorCgroups::init_memory(const std::string& cgroup_prefix_for_test)
         return;
     }
 
+    if (m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY_EXT)
+        init_memory_ext(reopen_each_time);
+
 #ifdef PROMETHEUS_SUPPORT
     if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_cgroup_memory) / sizeof(g_prometheus_kpi_cgroup_memory[0]);
@@ -142,6 +313,43 @@ void CMonitorCgroups::init_memory(const std::string& cgroup_prefix_for_test)
     CMonitorLogger::instance()->LogDebug("Successfully initialized memory cgroup monitoring.\n");
 }
 
+std::string CMonitorCgroups::get_memory_events_file() const
+{
+    if (m_nCGroupsFound != CG_VERSION2 || (m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY) == 0)
+        return "";
+    return m_cgroup_memory_v2_events.get_file();
+}
+
+void CMonitorCgroups::init_memory_ext(bool reopen_each_time)
+{
+    // all these files are optional: e.g. memsw.* files exist only if swap accounting is enabled and
+    // memory.numa_stat exists only on NUMA-enabled kernels; missing files are simply skipped at every sample
+    std::string missing_files;
+    for (unsigned int i = 0; i < MEMEXT_FILE_MAX; i++) {
+        const char* file
+            = (m_nCGroupsFound == CG_VERSION1) ? g_cgroup_memory_ext_files[i].v1 : g_cgroup_memory_ext_files[i].v2;
+        if (file == NULL)
+            continue;
+
+        m_cgroup_memory_ext[i].set_file(m_cgroup_memory_kernel_path + file, reopen_each_time);
+        if (!m_cgroup_memory_ext[i].open_or_rewind()) {
+            missing_files += std::string(file + 1) + " ";
+            m_cgroup_memory_ext[i].set_file("");
+        }
+    }
+
+    if (!missing_files.empty())
+        CMonitorLogger::instance()->LogDebug(
+            "Some extended memory statistics files are missing: %s\n", missing_files.c_str());
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_memory_ext) / sizeof(g_prometheus_kpi_cgroup_memory_ext[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_memory_ext, size);
+    }
+#endif
+}
+
 void CMonitorCgroups::sample_memory(
     const std::set<std::string>& allowedStatsNames_v1, const std::set<std::string>& allowedStatsNames_v2)
 {
@@ -162,12 +370,15 @@ void CMonitorCgroups::sample_memory(
     //   https://www.kernel.org/doc/Documentation/cgroup-v1/memory.txt
     //   https://www.kernel.org/doc/Documentation/cgroup-v2.txt
 
-    m_pOutput->psection_start("cgroup_memory_stats");
+    m_pOutput->psection_start("cgroup_memory_stats", m_output_labels);
 
+    uint64_t current_bytes = 0;
     if (m_nCGroupsFound == CG_VERSION2)
         // list as first value the main "current" KPI
-        if (m_cgroup_memory_v2_current.read_integer(value))
+        if (m_cgroup_memory_v2_current.read_integer(value)) {
             m_pOutput->plong("stat.current", value);
+            current_bytes = value;
+        }
 
     // dump main memory statistics file
     const std::set<std::string>& allowedStatsNames
@@ -209,5 +420,8 @@ void CMonitorCgroups::sample_memory(
         break;
     }
 
+    if (m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY_EXT)
+        sample_memory_ext(print, current_bytes);
+
     m_pOutput->psection_end();
 }
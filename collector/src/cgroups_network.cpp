@@ -23,7 +23,9 @@
 #include "output_frontend.h"
 #include "utils_files.h"
 #include "utils_string.h"
+#include <algorithm>
 #include <assert.h>
+#include <fcntl.h>
 #include <fstream>
 #include <pwd.h>
 #include <sstream>
@@ -34,10 +36,94 @@
 // Constants
 // ----------------------------------------------------------------------------------
 
+// while the network namespace cannot be opened (e.g. lacking privileges), retry after 1, 2, 4, ... samples
+#define NETNS_OPEN_MAX_BACKOFF_SAMPLES (64)
+
 // ----------------------------------------------------------------------------------
 // C++ Helper functions
 // ----------------------------------------------------------------------------------
 
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - internal helpers
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroups::update_network_namespace()
+{
+    if (m_netns_pid == 0
+        || std::find(m_cgroup_all_pids.begin(), m_cgroup_all_pids.end(), m_netns_pid) == m_cgroup_all_pids.end()) {
+        // first sample, or the PID used so far has exited or left the cgroup: any other PID of the cgroup will do
+        if (m_netns_pid != 0)
+            CMonitorLogger::instance()->LogDebug("PID %d left the cgroup; accessing its network namespace via PID %d\n",
+                m_netns_pid, m_cgroup_all_pids[0]);
+        m_netns_pid = m_cgroup_all_pids[0];
+
+        // see init_memory() for the reason behind reopen_each_time
+        m_netns_net_dev.set_file(fmt::format("{}/proc/{}/net/dev", m_proc_prefix, m_netns_pid), !m_proc_prefix.empty());
+        m_netns_net_dev.set_streaming_mode(true);
+
+        // the columns resolved so far remain valid: all network namespaces share the same kernel
+        m_netns_netstat.files[NETSTAT_FILE_SNMP].set_file(
+            fmt::format("{}/proc/{}/net/snmp", m_proc_prefix, m_netns_pid), !m_proc_prefix.empty());
+        m_netns_netstat.files[NETSTAT_FILE_NETSTAT].set_file(
+            fmt::format("{}/proc/{}/net/netstat", m_proc_prefix, m_netns_pid), !m_proc_prefix.empty());
+    }
+
+    // a single stat() per sample is enough to detect that the network namespace has changed, e.g. because the
+    // container has been restarted with a new network namespace but within the same cgroup
+    std::string netns_filename = fmt::format("{}/proc/{}/ns/net", m_proc_prefix, m_netns_pid);
+    struct stat netns_stat;
+    if (stat(netns_filename.c_str(), &netns_stat) != 0)
+        return; // e.g. the PID has just exited: it will be replaced at next sample
+    bool same_netns = (netns_stat.st_ino == m_netns_inode);
+    if (same_netns && m_netns_fd != -1)
+        return; // fast path: nothing changed
+    if (same_netns && m_netns_open_retry_countdown > 0) {
+        m_netns_open_retry_countdown--;
+        return; // the network namespace could not be opened so far: back off before retrying
+    }
+
+    if (!same_netns && m_netns_inode != 0) {
+        CMonitorLogger::instance()->LogDebug("The network namespace of the cgroup has changed\n");
+        if (m_netns_fd != -1)
+            close(m_netns_fd);
+        m_netns_fd = -1;
+        m_netlink_stats.close();
+        m_sock_diag.close();
+        m_netns_net_dev.close(); // the open file keeps reporting the stats of the namespace it was opened into
+        for (unsigned int i = 0; i < NETSTAT_FILE_MAX; i++)
+            m_netns_netstat.files[i].close();
+        m_previous_netinfo.clear(); // deltas against the counters of another namespace would be meaningless
+        m_netns_netstat.prev_valid = false;
+    }
+    if (!same_netns)
+        m_netns_open_backoff = 1;
+    m_netns_inode = netns_stat.st_ino;
+    m_netns_fd = open(netns_filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_netns_fd == -1) {
+        // e.g. lacking privileges: log just the first failure, the /proc/<pid>/net files can still be read
+        if (m_netns_open_backoff == 1)
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "Failed to open the network namespace %s; TCP stats will not be available", netns_filename.c_str());
+        m_netns_open_retry_countdown = m_netns_open_backoff;
+        m_netns_open_backoff = std::min(2 * m_netns_open_backoff, (unsigned int)NETNS_OPEN_MAX_BACKOFF_SAMPLES);
+        return;
+    }
+    m_netns_open_backoff = 1;
+
+    // netlink sockets are skipped during unit testing (when a /proc prefix is used) since there is no
+    // real namespace to enter
+    if (!m_proc_prefix.empty())
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_NETWORK_INTERFACES) && !m_netlink_stats.open(m_netns_fd))
+        CMonitorLogger::instance()->LogDebug(
+            "Failed to open a rtnetlink socket in the network namespace %s; falling back to %s\n",
+            netns_filename.c_str(), m_netns_net_dev.get_file().c_str());
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_TCP) && !m_sock_diag.open(m_netns_fd))
+        CMonitorLogger::instance()->LogErrorWithErrno(
+            "Failed to open a sock_diag socket in the network namespace %s; TCP stats will not be available",
+            netns_filename.c_str());
+}
+
 // ----------------------------------------------------------------------------------
 // CMonitorCgroups - Functions used by the cmonitor_collector engine
 // ----------------------------------------------------------------------------------
@@ -50,6 +136,10 @@ void CMonitorCgroups::init_network(const std::string& cgroup_prefix_for_test)
         size_t size = sizeof(g_prometheus_kpi_cgroup_network) / sizeof(g_prometheus_kpi_cgroup_network[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_network, size);
     }
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_CGROUP_NETSTAT) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_netstat) / sizeof(g_prometheus_kpi_cgroup_netstat[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_netstat, size);
+    }
 #endif
 
     CMonitorLogger::instance()->LogDebug("Successfully initialized cgroup network monitoring.\n");
@@ -70,8 +160,7 @@ void CMonitorCgroups::sample_network_interfaces(double elapsed_sec, OutputFields
 
     m_num_network_samples_collected++;
 
-    // now take the first PID and assume its network namespace is the one the user is interested about;
-    // we will monitor that network namespace (and only that) for the entire lifetime of its cgroup;
+    // now take a PID and assume its network namespace is the one the user is interested about;
     // in theory each PID inside a cgroup can have its own network namespace (and PIDs can enter/leave cgroups at any
     // time) but in practice with typical container technologies like Docker, LXC and Kubernetes, all processes inside a
     // cgroup share the same, fixed network namespace; so that this assumption should be OK.
@@ -80,8 +169,6 @@ void CMonitorCgroups::sample_network_interfaces(double elapsed_sec, OutputFields
         return;
     }
 
-    pid_t first_pid = m_cgroup_all_pids[0];
-
     /*
         IMPORTANT: there are at least two methods to monitor network statistics of a particular network namespace:
 
@@ -107,20 +194,24 @@ void CMonitorCgroups::sample_network_interfaces(double elapsed_sec, OutputFields
        0    0     0       0          0 lo: 5402517   80034    0    0    0     0          0         0  5402517   80034 0
        0    0     0       0          0 the numbers are identical... so we go with SECOND METHOD which of course is way
        simpler
-    */
 
-    // FIXME: use FastFileReader which optimizes the case where the PID chosen 1st time stays constant
-    std::string filename = fmt::format("{}/proc/{}/net/dev", m_proc_prefix, first_pid);
+        THIRD METHOD: when we have enough privileges, create once a rtnetlink socket inside the network namespace
+        and then dump the binary statistics of all its links with a single request on each sample.
+
+        The THIRD METHOD is used when possible, falling back to the SECOND METHOD otherwise; in both cases the
+        socket or the /proc/<pid>/net/dev file are kept open as long as the network namespace does not change.
+    */
+    update_network_namespace();
 
     std::set<std::string> empty_whitelist;
 
     // read new stats
     netinfo_map_t new_stats;
-    CMonitorSystem::read_net_dev_stats(filename, empty_whitelist, new_stats);
+    CMonitorSystem::read_net_dev_stats(m_netlink_stats, m_netns_net_dev, empty_whitelist, new_stats);
 
     // output delta stats
     if (output_opts != PF_NONE) {
-        m_pOutput->psection_start("cgroup_network");
+        m_pOutput->psection_start("cgroup_network", m_output_labels);
         CMonitorSystem::output_net_dev_stats(m_pOutput, elapsed_sec, new_stats, m_previous_netinfo, output_opts);
         m_pOutput->psection_end();
     }
@@ -128,3 +219,39 @@ void CMonitorCgroups::sample_network_interfaces(double elapsed_sec, OutputFields
     // finally remember the last sampled stats:
     m_previous_netinfo = new_stats;
 }
+
+void CMonitorCgroups::sample_netstat(double elapsed_sec, OutputFields output_opts)
+{
+    if (m_nCGroupsFound == CG_NONE)
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_NETSTAT) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // like for sample_network_interfaces(), the network namespace of the cgroup is accessed through one of its PIDs
+    if (m_cgroup_all_pids.empty()) {
+        CMonitorLogger::instance()->LogError("ERROR: could not find any PID in cgroup");
+        return;
+    }
+    update_network_namespace();
+
+    uint64_t new_values[NETSTAT_MAX];
+    if (!CMonitorSystem::read_netstat_stats(m_netns_netstat, new_values)) {
+        // e.g. the PID has just exited: it will be replaced at next sample
+        CMonitorLogger::instance()->LogDebug(
+            "failed to read %s", m_netns_netstat.files[NETSTAT_FILE_SNMP].get_file().c_str());
+        return;
+    }
+
+    if (output_opts != PF_NONE && m_netns_netstat.prev_valid) {
+        m_pOutput->psection_start("cgroup_net_snmp", m_output_labels);
+        CMonitorSystem::output_netstat_stats(
+            m_pOutput, elapsed_sec, new_values, m_netns_netstat.prev_values, output_opts);
+        m_pOutput->psection_end();
+    }
+
+    // finally remember the last sampled stats:
+    memcpy(m_netns_netstat.prev_values, new_values, sizeof(m_netns_netstat.prev_values));
+    m_netns_netstat.prev_valid = true;
+}
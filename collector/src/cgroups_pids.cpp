@@ -0,0 +1,125 @@
+/*
+ * cgroups_pids.cpp -- code for collecting CGROUP PIDS statistics
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "output_frontend.h"
+#include "utils_string.h"
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - internal helpers
+// ----------------------------------------------------------------------------------
+
+bool CMonitorCgroups::read_limit_failures(FastFileReader& reader, uint64_t& failures)
+{
+    // cgroups v2 pids.events and hugetlb.<size>.events files have a single line like:
+    //    max 5
+    // while cgroups v1 hugetlb.<size>.failcnt files contain just the integer; in both cases the value is the
+    // number of times an allocation (of a PID or of a huge page) failed because of the limit
+    if (!reader.open_or_rewind())
+        return false;
+
+    const char* pline = reader.get_next_line();
+    if (pline == NULL)
+        return false;
+    if (strncmp(pline, "max ", 4) == 0)
+        pline += 4;
+
+    failures = 0;
+    return string2int(pline, failures);
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - Functions used by the cmonitor_collector engine
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroups::init_pids(const std::string& cgroup_prefix_for_test)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PIDS) == 0)
+        return;
+
+    // see init_memory() for the reason behind reopen_each_time
+    bool reopen_each_time = !cgroup_prefix_for_test.empty();
+
+    // the same files are available in cgroups v1 and v2; they are kept open for the whole run, so that each
+    // sample costs a single pread() per file
+    m_cgroup_pids_current.set_file(m_cgroup_pids_kernel_path + "/pids.current", reopen_each_time);
+    if (m_cgroup_pids_kernel_path.empty() || !m_cgroup_pids_current.open_or_rewind()) {
+        // e.g. the 'pids' controller has not been enabled in the cgroup.subtree_control of the parent cgroup
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_PIDS;
+        CMonitorLogger::instance()->LogError(
+            "Could not read the pids statistics file '%s'. Disabling monitoring of pids cgroup.\n",
+            m_cgroup_pids_current.get_file().c_str());
+        return;
+    }
+
+    // pids.max does not exist in the root cgroup, pids.events exists only on kernels 4.3+:
+    m_cgroup_pids_max.set_file(m_cgroup_pids_kernel_path + "/pids.max", reopen_each_time);
+    m_cgroup_pids_events.set_file(m_cgroup_pids_kernel_path + "/pids.events", reopen_each_time);
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_pids) / sizeof(g_prometheus_kpi_cgroup_pids[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_pids, size);
+    }
+#endif
+
+    CMonitorLogger::instance()->LogDebug("Successfully initialized pids cgroup monitoring.\n");
+}
+
+void CMonitorCgroups::sample_pids(OutputFields output_opts)
+{
+    if (m_nCGroupsFound == CG_NONE)
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PIDS) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // See https://docs.kernel.org/admin-guide/cgroup-v2.html#pid
+
+    uint64_t current;
+    if (!m_cgroup_pids_current.read_integer(current)) {
+        // e.g. the cgroup has just been removed
+        CMonitorLogger::instance()->LogDebug("failed to re-open %s", m_cgroup_pids_current.get_file().c_str());
+        return;
+    }
+
+    uint64_t failures = 0;
+    bool has_failures = read_limit_failures(m_cgroup_pids_events, failures);
+
+    if (output_opts != PF_NONE) {
+        m_pOutput->psection_start("cgroup_pids", m_output_labels);
+        m_pOutput->plong("current", current);
+
+        // the limit is re-read at every sample since it can be changed at runtime
+        uint64_t limit;
+        if (m_cgroup_pids_max.read_integer_or_max(limit) && limit != UINT64_MAX) {
+            m_pOutput->plong("limit", limit);
+            m_pOutput->plong("headroom", limit > current ? limit - current : 0);
+        }
+        if (has_failures && m_pids_prev_valid)
+            m_pOutput->plong("events.max", failures - m_pids_prev_failures);
+        m_pOutput->psection_end();
+    }
+
+    // save new values for next sample:
+    m_pids_prev_failures = failures;
+    m_pids_prev_valid = has_failures;
+}
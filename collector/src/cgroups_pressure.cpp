@@ -0,0 +1,110 @@
+/*
+ * cgroups_pressure.cpp -- code for collecting CGROUP Pressure Stall Information
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "output_frontend.h"
+#include <assert.h>
+
+static const char* g_cgroup_pressure_files[PSI_MAX] = { "/cpu.pressure", "/memory.pressure", "/io.pressure" };
+static const char* g_cgroup_pressure_resource_names[PSI_MAX] = { "cpu", "memory", "io" };
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - Functions used by the cmonitor_collector engine
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroups::init_pressure(const std::string& cgroup_prefix_for_test)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PRESSURE) == 0)
+        return;
+
+    if (m_nCGroupsFound != CG_VERSION2) {
+        // cgroups v1 have no per-cgroup pressure files
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_PRESSURE;
+        CMonitorLogger::instance()->LogError("Pressure Stall Information is available only for cgroups v2. "
+                                             "Disabling monitoring of cgroup pressure.\n");
+        return;
+    }
+
+    // see init_memory() for the reason behind reopen_each_time
+    bool reopen_each_time = !cgroup_prefix_for_test.empty();
+
+    // the unified hierarchy of cgroups v2 means that all pressure files live in the same folder; they are
+    // kept open for the whole run, so that each sample costs a single pread() per file
+    unsigned int num_readable = 0;
+    for (unsigned int i = 0; i < PSI_MAX; i++) {
+        m_pressure[i].reader.set_file(m_cgroup_cpuacct_kernel_path + g_cgroup_pressure_files[i], reopen_each_time);
+        if (m_pressure[i].reader.open_or_rewind())
+            num_readable++;
+    }
+    if (num_readable == 0) {
+        // PSI is available only on kernels 4.20+ built with CONFIG_PSI and not booted with psi=0
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_PRESSURE;
+        CMonitorLogger::instance()->LogError(
+            "Could not read any pressure file from '%s'. Disabling monitoring of cgroup pressure.\n",
+            m_cgroup_cpuacct_kernel_path.c_str());
+        return;
+    }
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_pressure) / sizeof(g_prometheus_kpi_cgroup_pressure[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_pressure, size);
+    }
+#endif
+
+    CMonitorLogger::instance()->LogDebug("Successfully initialized cgroup pressure monitoring.\n");
+}
+
+void CMonitorCgroups::sample_pressure(double elapsed_sec, OutputFields output_opts)
+{
+    if (m_nCGroupsFound != CG_VERSION2)
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PRESSURE) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // See https://docs.kernel.org/admin-guide/cgroup-v2.html#pressure-stall-information
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_start("cgroup_pressure", m_output_labels);
+
+    for (unsigned int i = 0; i < PSI_MAX; i++) {
+        pressure_resource_t& res = m_pressure[i];
+        pressure_stats_t new_values[PSI_LINE_MAX];
+        if (!CMonitorSystem::read_pressure_stats(res.reader, new_values)) {
+            // e.g. io.pressure might be missing when the cgroup has just been removed
+            CMonitorLogger::instance()->LogDebug("failed to re-open %s", res.reader.get_file().c_str());
+            continue;
+        }
+
+        if (output_opts != PF_NONE) {
+            m_pOutput->psubsection_start(g_cgroup_pressure_resource_names[i]);
+            CMonitorSystem::output_pressure_stats(m_pOutput, elapsed_sec, new_values, res.prev_values, output_opts);
+            m_pOutput->psubsection_end();
+        }
+
+        // save new values for next sample:
+        memcpy(res.prev_values, new_values, sizeof(res.prev_values));
+    }
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_end();
+}
@@ -24,6 +24,7 @@
 #include "utils_files.h"
 #include "utils_string.h"
 #include <assert.h>
+#include <dirent.h>
 #include <fstream>
 #include <pwd.h>
 #include <sstream>
@@ -61,6 +62,25 @@ uint64_t compute_proc_score(const procsinfo_t* current_stats, const procsinfo_t*
     return cputime_clock_ticks * ticks_per_sec;
 }
 
+/* Adds the run time, the runqueue wait time and the timeslice count found in a schedstat file */
+static bool add_schedstat_file(const std::string& filename, procsinfo_t* pout)
+{
+    FILE* fp = fopen(filename.c_str(), "r");
+    if (fp == NULL)
+        return false;
+
+    unsigned long long run_ns = 0, wait_ns = 0, timeslices = 0;
+    int n = fscanf(fp, "%llu %llu %llu", &run_ns, &wait_ns, &timeslices);
+    fclose(fp);
+    if (n != 3)
+        return false;
+
+    pout->sched_run_ns += run_ns;
+    pout->sched_wait_ns += wait_ns;
+    pout->sched_timeslices += timeslices;
+    return true;
+}
+
 /* Lookup the right process state string */
 const char* get_state(char n)
 {
@@ -351,6 +371,34 @@ bool CMonitorCgroups::get_process_infos(
         }
         fclose(fp);
     }
+
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_SCHEDSTAT) { /* process the scheduler statistic file(s) */
+        /*
+            from https://www.kernel.org/doc/html/latest/scheduler/sched-stats.html
+            /proc/<pid>/schedstat contains 3 fields:
+                1) time spent on the cpu (in nanoseconds)
+                2) time spent waiting on a runqueue (in nanoseconds)
+                3) # of timeslices run on this cpu
+            Unlike the other statistic files, /proc/<pid>/schedstat reports only the stats of the main thread, so
+            in per-process mode we need to sum up the stats of all threads listed in /proc/<pid>/task.
+            The scheduler stats are optional (CONFIG_SCHED_INFO): a failure here does not invalidate the other stats.
+        */
+        if (include_threads) {
+            add_schedstat_file(stat_file_prefix + "/schedstat", pout);
+        } else {
+            std::string task_dir = stat_file_prefix + "/task";
+            DIR* dir = opendir(task_dir.c_str());
+            if (dir) {
+                struct dirent* entry;
+                while ((entry = readdir(dir)) != NULL) {
+                    if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+                        continue; // skip "." and ".."
+                    add_schedstat_file(fmt::format("{}/{}/schedstat", task_dir, entry->d_name), pout);
+                }
+                closedir(dir);
+            }
+        }
+    }
     return true;
 }
 
@@ -447,8 +495,11 @@ void CMonitorCgroups::init_processes(const std::string& cgroup_prefix_for_test)
         m_pCfg->m_nCollectFlags &= ~PK_CGROUP_PROCESSES;
         m_pCfg->m_nCollectFlags &= ~PK_CGROUP_THREADS;
         m_pCfg->m_nCollectFlags &= ~PK_CGROUP_NETWORK_INTERFACES;
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_TCP;
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_NETSTAT;
         CMonitorLogger::instance()->LogError("Could not read the cgroup with list of pids from file '%s'. Disabling "
-                                             "monitoring of processes/threads/network-interfaces inside cgroup.\n",
+                                             "monitoring of processes/threads/network-interfaces/tcp/netstat inside "
+                                             "cgroup.\n",
             m_cgroup_processes_reader_pids.get_file().c_str());
         return;
     }
@@ -472,11 +523,13 @@ void CMonitorCgroups::sample_process_list()
 
     // this function is shared between
     // * cgroup process stats
-    // * cgroup network stats
-    // processors; so it must execute if any of the 2 stat collector is enabled
+    // * cgroup network, tcp and netstat stats
+    // processors; so it must execute if any of these stat collectors is enabled
     if ((m_pCfg->m_nCollectFlags & PK_CGROUP_PROCESSES) == 0 && // fn
         (m_pCfg->m_nCollectFlags & PK_CGROUP_THREADS) == 0 && // fn
-        (m_pCfg->m_nCollectFlags & PK_CGROUP_NETWORK_INTERFACES) == 0)
+        (m_pCfg->m_nCollectFlags & PK_CGROUP_NETWORK_INTERFACES) == 0 && // fn
+        (m_pCfg->m_nCollectFlags & PK_CGROUP_TCP) == 0 && // fn
+        (m_pCfg->m_nCollectFlags & PK_CGROUP_NETSTAT) == 0)
         return;
 
     DEBUGLOG_FUNCTION_START();
@@ -578,7 +631,7 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
 
     if (m_topper_procs.empty()) {
         // just produce an empty section to have all samples structured in the same way, then return
-        m_pOutput->psection_start("cgroup_tasks");
+        m_pOutput->psection_start("cgroup_tasks", m_output_labels);
         m_pOutput->psection_end();
         return;
     }
@@ -592,7 +645,7 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
     // Now output all data for each process, starting from the minimal score PROCESS_SCORE_IGNORE_THRESHOLD
     static double ticks = (double)sysconf(_SC_CLK_TCK); // clock ticks per second
     size_t nProcsOverThreshold = 0;
-    m_pOutput->psection_start("cgroup_tasks");
+    m_pOutput->psection_start("cgroup_tasks", m_output_labels);
     for (auto entry = m_topper_procs.lower_bound(m_pCfg->m_nProcessScoreThreshold); entry != m_topper_procs.end();
          entry++) {
         uint64_t score = (*entry).first;
@@ -731,6 +784,26 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
 
         m_pOutput->psubsubsection_end();
 
+        /*
+         * Scheduler fields
+         */
+        if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_SCHEDSTAT) {
+            m_pOutput->psubsubsection_start("sched", labels);
+
+            // in per-process mode the sum over all threads decreases when a thread exits: use COUNTDELTA
+            double timeslices = (double)COUNTDELTA(sched_timeslices);
+            double wait_ns = (double)COUNTDELTA(sched_wait_ns);
+            if (output_opts == PF_ALL) {
+                // nanoseconds / (elapsed_sec * 1e9) * 100 gives a percentage, which may exceed 100 for processes:
+                m_pOutput->pdouble("run_pct", (double)COUNTDELTA(sched_run_ns) / elapsed_sec / 1e7);
+                m_pOutput->pdouble("timeslices", timeslices / elapsed_sec);
+            }
+            m_pOutput->pdouble("wait_pct", wait_ns / elapsed_sec / 1e7);
+            m_pOutput->pdouble("avg_wait_usec", timeslices > 0 ? wait_ns / timeslices / 1000 : 0);
+
+            m_pOutput->psubsubsection_end();
+        }
+
         m_pOutput->psubsection_end();
         nProcsOverThreshold++;
     }
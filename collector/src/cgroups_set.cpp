@@ -0,0 +1,622 @@
+/*
+ * cgroups_set.cpp -- code for monitoring many cgroups from a single cmonitor_collector instance
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "utils_files.h"
+#include "utils_string.h"
+#include <algorithm>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <time.h>
+
+// ----------------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------------
+
+// with cgroups v1 the directories of a new cgroup are created one controller at a time, so the first
+// initialization attempt might fail: retry it at next samples before giving up
+#define CGROUP_DISCOVERY_MAX_INIT_ATTEMPTS (3)
+
+#define INOTIFY_BUFF_SIZE (16384)
+
+/*
+    PERFORMANCE NOTE:
+    In discovery mode, the tree of cgroups below the root cgroup is scanned only once at startup (and again only
+    in the unlikely case the inotify event queue overflows): each directory of the tree gets an inotify watch and
+    the creation/removal of cgroups is learnt by draining the (non-blocking) inotify file descriptor once per sample.
+    New cgroups are initialized lazily, right after the end of a sample, and emitted starting from the next one.
+    Event samples use a second inotify instance, watching only the memory.events file of each monitored cgroup:
+    the main loop polls it together with its sampling timer, so that no CPU is spent while there are no events.
+    The same inotify instance delivers the liveness notifications used by --num-samples=until-cgroup-alive, so that
+    the end of a cgroup is detected immediately instead of at the end of the sampling interval.
+*/
+
+static double get_monotonic_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupsSet
+// ----------------------------------------------------------------------------------
+
+CMonitorCgroupsSet::~CMonitorCgroupsSet()
+{
+    if (m_inotify_fd != -1)
+        close(m_inotify_fd);
+    if (m_events_inotify_fd != -1)
+        close(m_events_inotify_fd);
+}
+
+void CMonitorCgroupsSet::init(bool include_threads, const std::string& cgroup_prefix_for_test,
+    const std::string& proc_prefix_for_test, uint64_t my_own_pid_for_test)
+{
+    m_include_threads = include_threads;
+
+    if (!m_pCfg->m_strCGroupDiscoveryRoot.empty()) {
+        m_bMultiCgroup = true;
+        m_cgroup_prefix_for_test = cgroup_prefix_for_test;
+        m_proc_prefix_for_test = proc_prefix_for_test;
+        m_my_own_pid_for_test = my_own_pid_for_test;
+        if (init_discovery())
+            init_pending_cgroups(false /* bootstrap samples are taken by the caller */);
+        return;
+    }
+
+    std::vector<std::string> patterns = split_string_in_array(m_pCfg->m_strCGroupName, ',');
+    m_bMultiCgroup = patterns.size() > 1
+        || (patterns.size() == 1 && patterns[0].find_first_of("*?[") != std::string::npos);
+
+    if (!m_bMultiCgroup) {
+        // legacy mode: a single cgroup (possibly our own one) using the main configuration and no output labels
+        monitored_cgroup_t& entry = m_cgroups[""];
+        entry.collector.reset(new CMonitorCgroups(m_pCfg, m_pOutput));
+        entry.collector->init(include_threads, cgroup_prefix_for_test, proc_prefix_for_test, my_own_pid_for_test);
+        return;
+    }
+
+    // expand all glob patterns into a list of cgroup names:
+    for (const auto& pattern : patterns) {
+        std::vector<std::string> matches;
+        if (pattern.find_first_of("*?[") == std::string::npos) {
+            matches.push_back(pattern);
+        } else {
+            CMonitorCgroups probe(m_pCfg, m_pOutput);
+            if (!probe.list_cgroups_matching(pattern, matches))
+                continue; // the function has already logged errors
+            if (matches.empty())
+                CMonitorLogger::instance()->LogError("No cgroup matches the pattern [%s].", pattern.c_str());
+        }
+
+        for (const auto& name : matches)
+            if (m_cgroups.find(name) == m_cgroups.end())
+                add_cgroup(name);
+    }
+
+    CMonitorLogger::instance()->LogDebug("Monitoring %zu cgroups.", m_cgroups.size());
+}
+
+bool CMonitorCgroupsSet::add_cgroup(const std::string& name)
+{
+    // each collector gets its own copy of the configuration since collectors are allowed to turn off
+    // the collection of some KPI families, e.g. when some cgroup file is missing
+    monitored_cgroup_t& entry = m_cgroups[name];
+    entry.cfg = *m_pCfg;
+    entry.cfg.m_strCGroupName = name;
+
+    entry.collector.reset(new CMonitorCgroups(&entry.cfg, m_pOutput));
+    entry.collector->set_output_labels({ { "cgroup", name } });
+    entry.collector->init(m_include_threads, m_cgroup_prefix_for_test, m_proc_prefix_for_test, m_my_own_pid_for_test);
+    if (entry.collector->get_detected_cgroup_version() == CG_NONE) {
+        m_cgroups.erase(name);
+        return false; // the function has already logged errors
+    }
+
+    if (m_events_inotify_fd != -1)
+        watch_memory_events(name, entry);
+
+    CMonitorLogger::instance()->LogDebug("Monitoring cgroup [%s].", name.c_str());
+    return true;
+}
+
+void CMonitorCgroupsSet::remove_cgroup(const std::string& name)
+{
+    // when a cgroup is removed, all its children have necessarily been removed as well:
+    std::string children_prefix = name + "/";
+    for (auto it = m_cgroups.begin(); it != m_cgroups.end();) {
+        if (it->first == name || it->first.compare(0, children_prefix.size(), children_prefix) == 0) {
+            CMonitorLogger::instance()->LogDebug("Stop monitoring cgroup [%s].", it->first.c_str());
+            unwatch_cgroup(it->second);
+            it = m_cgroups.erase(it);
+        } else
+            ++it;
+    }
+    m_pending_cgroups.erase(name);
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupsSet - discovery mode
+// ----------------------------------------------------------------------------------
+
+bool CMonitorCgroupsSet::init_discovery()
+{
+    CMonitorCgroups probe(m_pCfg, m_pOutput);
+    if (!probe.get_cgroups_mount_point(
+            m_cgroups_mount_point, m_cgroup_prefix_for_test, m_proc_prefix_for_test, m_my_own_pid_for_test))
+        return false; // the function has already logged errors
+
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd == -1) {
+        CMonitorLogger::instance()->LogErrorWithErrno("Failed to initialize inotify. CGroup discovery disabled.");
+        return false;
+    }
+
+    std::string root_path = m_cgroups_mount_point + "/" + m_pCfg->m_strCGroupDiscoveryRoot;
+    if (!file_or_dir_exists(root_path.c_str())) {
+        CMonitorLogger::instance()->LogError(
+            "Cannot find the root cgroup directory [%s]. CGroup discovery disabled.", root_path.c_str());
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+        return false;
+    }
+
+    watch_cgroup_tree(m_pCfg->m_strCGroupDiscoveryRoot);
+    m_pending_cgroups.erase(m_pCfg->m_strCGroupDiscoveryRoot); // the root itself is not monitored
+    return true;
+}
+
+void CMonitorCgroupsSet::watch_cgroup_tree(const std::string& name)
+{
+    std::string path = m_cgroups_mount_point + "/" + name;
+
+    // the watch is added before listing the directory, so that no child cgroup can be missed;
+    // cgroups found twice are harmless since m_pending_cgroups is a map
+    int wd = inotify_add_watch(m_inotify_fd, path.c_str(), IN_CREATE | IN_DELETE | IN_ONLYDIR);
+    if (wd == -1) {
+        // the cgroup might have been already removed
+        CMonitorLogger::instance()->LogDebug("Failed to watch the cgroup directory [%s].", path.c_str());
+        return;
+    }
+    m_watches[wd] = name;
+    if (m_cgroups.find(name) == m_cgroups.end())
+        m_pending_cgroups.emplace(name, 0);
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+        return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_DIR || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        watch_cgroup_tree(name + "/" + entry->d_name);
+    }
+    closedir(dir);
+}
+
+void CMonitorCgroupsSet::init_pending_cgroups(bool bootstrap)
+{
+    for (auto it = m_pending_cgroups.begin(); it != m_pending_cgroups.end();) {
+        bool done = add_cgroup(it->first);
+        if (!done && ++it->second < CGROUP_DISCOVERY_MAX_INIT_ATTEMPTS) {
+            ++it;
+            continue;
+        }
+        if (done && bootstrap)
+            sample_bootstrap(m_cgroups[it->first].collector.get());
+        it = m_pending_cgroups.erase(it);
+    }
+}
+
+void CMonitorCgroupsSet::discover_cgroups()
+{
+    if (m_inotify_fd == -1)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    char buff[INOTIFY_BUFF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool rescan = false;
+    while (true) {
+        ssize_t len = read(m_inotify_fd, buff, sizeof(buff));
+        if (len <= 0)
+            break; // EAGAIN: no more events
+
+        for (char* ptr = buff; ptr < buff + len;) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                rescan = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // the watched directory has been removed
+                m_watches.erase(event->wd);
+                continue;
+            }
+
+            auto parent = m_watches.find(event->wd);
+            if (parent == m_watches.end() || (event->mask & IN_ISDIR) == 0 || event->len == 0)
+                continue;
+            std::string name = parent->second + "/" + event->name;
+            if (event->mask & IN_CREATE)
+                watch_cgroup_tree(name); // new cgroup (and maybe its children): initialize it lazily
+            else if (event->mask & IN_DELETE)
+                remove_cgroup(name);
+        }
+    }
+
+    if (rescan) {
+        // some events have been lost: this is the only case where the whole tree of cgroups gets rescanned
+        CMonitorLogger::instance()->LogDebug("The inotify event queue overflowed: rescanning the cgroups.");
+        for (const auto& it : m_watches)
+            inotify_rm_watch(m_inotify_fd, it.first);
+        m_watches.clear();
+        for (auto it = m_cgroups.begin(); it != m_cgroups.end();) {
+            if (it->second.collector->cgroup_still_exists())
+                ++it;
+            else
+                it = m_cgroups.erase(it);
+        }
+        watch_cgroup_tree(m_pCfg->m_strCGroupDiscoveryRoot);
+        m_pending_cgroups.erase(m_pCfg->m_strCGroupDiscoveryRoot);
+    }
+
+    init_pending_cgroups(true);
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupsSet - forwarding to all monitored cgroups
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroupsSet::get_list_monitored_files(std::set<std::string>& list)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->get_list_monitored_files(list);
+}
+
+void CMonitorCgroupsSet::output_config()
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->output_config();
+}
+
+void CMonitorCgroupsSet::sample_bootstrap(CMonitorCgroups* collector)
+{
+    collector->sample_cpuacct(0);
+    collector->sample_blkio(0, PF_NONE /* do not emit JSON */);
+    collector->sample_pressure(0, PF_NONE /* do not emit JSON */);
+    collector->sample_processes(0, PF_NONE /* do not emit JSON */);
+    collector->sample_processes(0, PF_NONE /* do not emit JSON */);
+}
+
+void CMonitorCgroupsSet::sample_bootstrap()
+{
+    for (auto& it : m_cgroups)
+        sample_bootstrap(it.second.collector.get());
+}
+
+void CMonitorCgroupsSet::sample_cpuacct(double elapsed_sec)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_cpuacct(elapsed_sec);
+}
+
+void CMonitorCgroupsSet::sample_memory(
+    const std::set<std::string>& allowedStatsNames_v1, const std::set<std::string>& allowedStatsNames_v2)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_memory(allowedStatsNames_v1, allowedStatsNames_v2);
+}
+
+void CMonitorCgroupsSet::sample_blkio(double elapsed_sec, OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_blkio(elapsed_sec, output_opts);
+}
+
+void CMonitorCgroupsSet::sample_process_list()
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_process_list();
+}
+
+void CMonitorCgroupsSet::sample_network_interfaces(double elapsed_sec, OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_network_interfaces(elapsed_sec, output_opts);
+}
+
+void CMonitorCgroupsSet::sample_processes(double elapsed_sec, OutputFields output_opts)
+{
+    double now = get_monotonic_time();
+    for (auto& it : m_cgroups) {
+        // if an event sample was taken after the last regular sample, deltas are computed against the event sample
+        double elapsed = elapsed_sec;
+        if (it.second.event_sample_time > m_processes_sample_time)
+            elapsed = now - it.second.event_sample_time;
+        it.second.collector->sample_processes(elapsed, output_opts);
+    }
+    m_processes_sample_time = now;
+}
+
+void CMonitorCgroupsSet::sample_pressure(double elapsed_sec, OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_pressure(elapsed_sec, output_opts);
+}
+
+void CMonitorCgroupsSet::sample_pids(OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_pids(output_opts);
+}
+
+void CMonitorCgroupsSet::sample_hugetlb(OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_hugetlb(output_opts);
+}
+
+void CMonitorCgroupsSet::sample_tcp(OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_tcp(output_opts);
+}
+
+void CMonitorCgroupsSet::sample_netstat(double elapsed_sec, OutputFields output_opts)
+{
+    for (auto& it : m_cgroups)
+        it.second.collector->sample_netstat(elapsed_sec, output_opts);
+}
+
+bool CMonitorCgroupsSet::cgroup_still_exists()
+{
+    if (!m_bMultiCgroup)
+        return !m_cgroups.empty() && m_cgroups.begin()->second.alive
+            && m_cgroups.begin()->second.collector->cgroup_still_exists();
+
+    if (m_inotify_fd != -1) {
+        // discovery mode: removed cgroups are already handled by discover_cgroups()
+        std::string root_path = m_cgroups_mount_point + "/" + m_pCfg->m_strCGroupDiscoveryRoot;
+        return file_or_dir_exists(root_path.c_str());
+    }
+
+    // stop monitoring the cgroups that have been removed:
+    bool any_alive = false;
+    for (auto it = m_cgroups.begin(); it != m_cgroups.end();) {
+        if (it->second.collector->cgroup_still_exists()) {
+            any_alive |= it->second.alive;
+            ++it;
+            continue;
+        }
+        CMonitorLogger::instance()->LogDebug("Stop monitoring removed cgroup [%s].", it->first.c_str());
+        unwatch_cgroup(it->second);
+        it = m_cgroups.erase(it);
+    }
+    return any_alive;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupsSet - event samples
+// ----------------------------------------------------------------------------------
+
+bool CMonitorCgroupsSet::init_events_inotify()
+{
+    if (m_events_inotify_fd == -1)
+        m_events_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return m_events_inotify_fd != -1;
+}
+
+void CMonitorCgroupsSet::unwatch_cgroup(monitored_cgroup_t& entry)
+{
+    if (entry.memory_events_wd != -1) {
+        inotify_rm_watch(m_events_inotify_fd, entry.memory_events_wd);
+        m_event_watches.erase(entry.memory_events_wd);
+        entry.memory_events_wd = -1;
+    }
+    for (int wd : entry.liveness_wds) {
+        inotify_rm_watch(m_events_inotify_fd, wd);
+        m_liveness_watches.erase(wd);
+    }
+    entry.liveness_wds.clear();
+}
+
+bool CMonitorCgroupsSet::init_event_watches()
+{
+    if (!init_events_inotify()) {
+        CMonitorLogger::instance()->LogErrorWithErrno("Failed to initialize inotify. Event samples disabled.");
+        return false;
+    }
+
+    for (auto& it : m_cgroups)
+        watch_memory_events(it.first, it.second);
+    if (m_event_watches.empty() && !m_bMultiCgroup) {
+        // nothing to watch, and no new cgroup will ever show up
+        CMonitorLogger::instance()->LogError(
+            "Event samples are available only for cgroups v2 with memory stats collection enabled.");
+        if (m_liveness_watches.empty()) {
+            close(m_events_inotify_fd);
+            m_events_inotify_fd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void CMonitorCgroupsSet::watch_memory_events(const std::string& name, monitored_cgroup_t& entry)
+{
+    std::string file = entry.collector->get_memory_events_file();
+    if (file.empty())
+        return;
+
+    // the kernel generates a file-modified event whenever any memory.events counter changes
+    entry.memory_events_wd = inotify_add_watch(m_events_inotify_fd, file.c_str(), IN_MODIFY);
+    if (entry.memory_events_wd == -1) {
+        CMonitorLogger::instance()->LogDebug("Failed to watch the file [%s].", file.c_str());
+        return;
+    }
+    m_event_watches[entry.memory_events_wd] = name;
+}
+
+bool CMonitorCgroupsSet::init_liveness_watches()
+{
+    if (m_inotify_fd != -1)
+        return false; // discovery mode: cgroup_still_exists() just checks the root cgroup at every sample
+    if (!init_events_inotify()) {
+        CMonitorLogger::instance()->LogErrorWithErrno(
+            "Failed to initialize inotify. CGroup liveness will be checked only once per sample.");
+        return false;
+    }
+
+    for (auto& it : m_cgroups)
+        watch_liveness(it.first, it.second);
+    return true;
+}
+
+void CMonitorCgroupsSet::watch_liveness(const std::string& name, monitored_cgroup_t& entry)
+{
+    // cgroups v1 and v2: the runtime removes the cgroup directories once all processes have exited
+    for (const auto& dir : entry.collector->get_cgroup_dirs()) {
+        int wd = inotify_add_watch(m_events_inotify_fd, dir.c_str(), IN_DELETE_SELF | IN_ONLYDIR);
+        if (wd == -1) {
+            CMonitorLogger::instance()->LogDebug("Failed to watch the cgroup directory [%s].", dir.c_str());
+            continue;
+        }
+        entry.liveness_wds.push_back(wd);
+        m_liveness_watches[wd] = name;
+    }
+
+    // cgroups v2 only: the kernel generates a file-modified event whenever the "populated" flag changes, which
+    // happens as soon as the last process exits, typically well before the removal of the cgroup directory
+    std::string file = entry.collector->get_cgroup_events_file();
+    if (file.empty())
+        return;
+    int wd = inotify_add_watch(m_events_inotify_fd, file.c_str(), IN_MODIFY);
+    if (wd == -1) {
+        CMonitorLogger::instance()->LogDebug("Failed to watch the file [%s].", file.c_str());
+        return;
+    }
+    entry.liveness_wds.push_back(wd);
+    m_liveness_watches[wd] = name;
+
+    // a cgroup that is still empty (e.g. created just before its first process gets moved into it) must not be
+    // considered terminated: only a transition from populated to unpopulated ends it
+    entry.populated_seen = entry.collector->cgroup_is_populated();
+}
+
+bool CMonitorCgroupsSet::read_events()
+{
+    if (m_events_inotify_fd == -1)
+        return false;
+
+    char buff[INOTIFY_BUFF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    double min_event_spacing_sec = (double)m_pCfg->m_nSamplingIntervalMsec / 1000;
+    bool pending = false;
+    while (true) {
+        ssize_t len = read(m_events_inotify_fd, buff, sizeof(buff));
+        if (len <= 0)
+            break; // EAGAIN: no more events
+
+        for (char* ptr = buff; ptr < buff + len;) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            auto liveness_watch = m_liveness_watches.find(event->wd);
+            if (liveness_watch != m_liveness_watches.end()) {
+                auto cgroup = m_cgroups.find(liveness_watch->second);
+                if (event->mask & IN_IGNORED) {
+                    // the watched directory or file has been removed
+                    if (cgroup != m_cgroups.end()) {
+                        std::vector<int>& wds = cgroup->second.liveness_wds;
+                        wds.erase(std::remove(wds.begin(), wds.end(), event->wd), wds.end());
+                    }
+                    m_liveness_watches.erase(liveness_watch);
+                    continue;
+                }
+                if (cgroup == m_cgroups.end())
+                    continue;
+                monitored_cgroup_t& entry = cgroup->second;
+                if (event->mask & IN_DELETE_SELF)
+                    entry.alive = false;
+                else if (event->mask & IN_MODIFY) {
+                    if (entry.collector->cgroup_is_populated())
+                        entry.populated_seen = true;
+                    else if (entry.populated_seen)
+                        entry.alive = false;
+                }
+                if (!entry.alive)
+                    CMonitorLogger::instance()->LogDebug(
+                        "The cgroup [%s] has no more processes.", liveness_watch->second.c_str());
+                continue;
+            }
+
+            auto watch = m_event_watches.find(event->wd);
+            if (watch == m_event_watches.end())
+                continue;
+            if (event->mask & IN_IGNORED) {
+                // the cgroup has been removed
+                auto cgroup = m_cgroups.find(watch->second);
+                if (cgroup != m_cgroups.end())
+                    cgroup->second.memory_events_wd = -1;
+                m_event_watches.erase(watch);
+                continue;
+            }
+
+            auto cgroup = m_cgroups.find(watch->second);
+            if (cgroup == m_cgroups.end() || (event->mask & IN_MODIFY) == 0)
+                continue;
+
+            // while the memory usage stays above memory.high, the kernel keeps updating memory.events many times
+            // per second: limit the event samples of each cgroup to one per sampling interval, the regular samples
+            // will report the rest
+            if (get_monotonic_time() - cgroup->second.event_sample_time < min_event_spacing_sec) {
+                CMonitorLogger::instance()->LogDebug(
+                    "Skipping an event sample of cgroup [%s]: too close to the previous one.", watch->second.c_str());
+                continue;
+            }
+            cgroup->second.memory_event_pending = true;
+            pending = true;
+        }
+    }
+
+    return pending;
+}
+
+void CMonitorCgroupsSet::sample_memory_events(const std::set<std::string>& allowedStatsNames_v1,
+    const std::set<std::string>& allowedStatsNames_v2, OutputFields output_opts)
+{
+    double now = get_monotonic_time();
+    for (auto& it : m_cgroups) {
+        monitored_cgroup_t& entry = it.second;
+        if (!entry.memory_event_pending)
+            continue;
+        entry.memory_event_pending = false;
+
+        CMonitorLogger::instance()->LogDebug("Taking an event sample of cgroup [%s].", it.first.c_str());
+        double last_sample_time = std::max(entry.event_sample_time, m_processes_sample_time);
+        entry.collector->sample_memory(allowedStatsNames_v1, allowedStatsNames_v2);
+        entry.collector->sample_process_list();
+        entry.collector->sample_processes(now - last_sample_time, output_opts);
+        entry.event_sample_time = now;
+    }
+}
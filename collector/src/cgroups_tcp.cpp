@@ -0,0 +1,122 @@
+/*
+ * cgroups_tcp.cpp -- code for collecting TCP statistics of the network namespace of a CGROUP
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "output_frontend.h"
+#include "utils_string.h"
+
+// ----------------------------------------------------------------------------------
+// C++ Helper functions
+// ----------------------------------------------------------------------------------
+
+// names of the TCP states, indexed by TCP state number, see <netinet/tcp.h>
+static const char* g_tcp_state_names[SOCK_DIAG_TCP_STATES] = {
+    "", // unused
+    "established", "syn_sent", "syn_recv", "fin_wait1", "fin_wait2", "time_wait", "close", "close_wait", "last_ack",
+    "listen", "closing",
+};
+
+static const char* g_tcp_rtt_bucket_names[SOCK_DIAG_RTT_BUCKETS] = {
+    "under_100us", "under_1ms", "under_10ms", "under_100ms", "under_1s", "over_1s",
+};
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - Functions used by the cmonitor_collector engine
+// ----------------------------------------------------------------------------------
+
+void CMonitorCgroups::init_tcp(const std::string& cgroup_prefix_for_test)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_TCP) == 0)
+        return;
+
+    // the sock_diag socket itself is opened by update_network_namespace() at first sample, since the
+    // network namespace of the cgroup is known only once its PIDs have been collected
+    if (!m_sock_diag.set_port_filter(m_pCfg->m_vecCgroupTcpPorts)) {
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_TCP;
+        CMonitorLogger::instance()->LogError(
+            "Too many TCP ports to filter: %zu. Disabling monitoring of cgroup TCP sockets.\n",
+            m_pCfg->m_vecCgroupTcpPorts.size());
+        return;
+    }
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_tcp) / sizeof(g_prometheus_kpi_cgroup_tcp[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_tcp, size);
+    }
+#endif
+
+    CMonitorLogger::instance()->LogDebug(
+        "Successfully initialized cgroup TCP monitoring filtering on %zu ports.\n", m_pCfg->m_vecCgroupTcpPorts.size());
+}
+
+void CMonitorCgroups::sample_tcp(OutputFields output_opts)
+{
+    if (m_nCGroupsFound == CG_NONE)
+        return;
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_TCP) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // like for sample_network_interfaces(), the network namespace of the cgroup is accessed through one of its PIDs
+    if (m_cgroup_all_pids.empty()) {
+        CMonitorLogger::instance()->LogError("ERROR: could not find any PID in cgroup");
+        return;
+    }
+    update_network_namespace();
+    if (!m_sock_diag.is_open())
+        return; // e.g. during unit testing or lacking privileges to enter the network namespace
+
+    if (!m_sock_diag.dump_tcp_summary()) {
+        CMonitorLogger::instance()->LogDebug("failed to dump the TCP sockets of the cgroup network namespace");
+        return;
+    }
+    if (output_opts == PF_NONE)
+        return;
+
+    const sock_diag_tcp_summary_t& summary = m_sock_diag.get_tcp_summary();
+    m_pOutput->psection_start("cgroup_tcp", m_output_labels);
+
+    m_pOutput->psubsection_start("totals");
+    m_pOutput->plong("sockets", summary.num_sockets);
+    if (summary.num_rtt_samples > 0) {
+        m_pOutput->plong("rtt_avg_us", summary.rtt_sum_usec / summary.num_rtt_samples);
+        m_pOutput->plong("rtt_max_us", summary.rtt_max_usec);
+    }
+    m_pOutput->plong("retransmitting", summary.num_retransmitting);
+    m_pOutput->plong("unacked", summary.unacked);
+    m_pOutput->plong("cwnd_limited", summary.num_cwnd_limited);
+    m_pOutput->psubsection_end();
+
+    // to keep the output compact, only the states having at least one socket are emitted
+    m_pOutput->psubsection_start("states");
+    for (unsigned int i = 1; i < SOCK_DIAG_TCP_STATES; i++)
+        if (summary.num_by_state[i] > 0)
+            m_pOutput->plong(g_tcp_state_names[i], summary.num_by_state[i]);
+    m_pOutput->psubsection_end();
+
+    m_pOutput->psubsection_start("rtt_histogram");
+    for (unsigned int i = 0; i < SOCK_DIAG_RTT_BUCKETS; i++)
+        m_pOutput->plong(g_tcp_rtt_bucket_names[i], summary.rtt_histogram[i]);
+    m_pOutput->psubsection_end();
+
+    m_pOutput->psection_end();
+}
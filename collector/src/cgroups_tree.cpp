@@ -0,0 +1,436 @@
+/*
+ * cgroups_tree.cpp -- code for collecting statistics of each cgroup of a whole cgroup (v2) subtree
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroups.h"
+#include "logger.h"
+#include "output_frontend.h"
+#include "utils_string.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// ----------------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------------
+
+// each node keeps a directory file descriptor open: limit the number of nodes to stay well below the
+// default limit of open file descriptors
+#define CGROUP_TREE_MAX_NODES (768)
+#define CGROUP_TREE_NO_PARENT (UINT32_MAX)
+#define CGROUP_TREE_DIRENTS_BUFF_SIZE (8192)
+
+/*
+    PERFORMANCE NOTE:
+    Each cgroup of the tree is a node identified by a small integer ID; all counters are stored in flat arrays
+    indexed by node ID and each node keeps its directory open. At each sample the tree is walked depth-first:
+    the children of each node are listed with getdents64() on the cached directory descriptor (recognizing the
+    already-known cgroups by their inode number) and stat files are opened with openat() relative to it, so that
+    the cost is linear in the number of nodes and no path string is ever built again, except for new cgroups.
+*/
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    const char* key;
+    CgroupTreeCounter counter;
+} cgroup_tree_key_t;
+
+static const cgroup_tree_key_t g_cpu_stat_keys[] = {
+    { "usage_usec", CGTREE_CPU_USAGE_USEC },
+    { "user_usec", CGTREE_CPU_USER_USEC },
+    { "system_usec", CGTREE_CPU_SYSTEM_USEC },
+    { "throttled_usec", CGTREE_CPU_THROTTLED_USEC },
+};
+
+static const cgroup_tree_key_t g_memory_stat_keys[] = {
+    { "anon", CGTREE_MEMORY_ANON },
+    { "file", CGTREE_MEMORY_FILE },
+    { "kernel_stack", CGTREE_MEMORY_KERNEL_STACK },
+    { "sock", CGTREE_MEMORY_SOCK },
+    { "shmem", CGTREE_MEMORY_SHMEM },
+};
+
+static const cgroup_tree_key_t g_io_stat_keys[] = {
+    { "rbytes=", CGTREE_IO_RBYTES },
+    { "wbytes=", CGTREE_IO_WBYTES },
+    { "rios=", CGTREE_IO_RIOS },
+    { "wios=", CGTREE_IO_WIOS },
+};
+
+// ----------------------------------------------------------------------------------
+// C Helper functions
+// ----------------------------------------------------------------------------------
+
+static bool read_file_at(int dir_fd, const char* filename, char* buff, size_t buff_size)
+{
+    int fd = openat(dir_fd, filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false; // e.g. the controller is not enabled for this cgroup
+    ssize_t nread = read(fd, buff, buff_size - 1);
+    close(fd);
+    if (nread <= 0)
+        return false;
+    buff[nread] = '\0';
+    return true;
+}
+
+// parses a "flat keyed" file like cpu.stat or memory.stat, made of "key value" lines
+static void parse_flat_keyed(char* buff, const cgroup_tree_key_t* keys, size_t nkeys, uint64_t* counters)
+{
+    for (char* line = buff; line && *line != '\0';) {
+        char* next_line = strchr(line, '\n');
+        if (next_line)
+            *next_line++ = '\0';
+
+        const char* space = strchr(line, ' ');
+        if (space) {
+            size_t key_len = space - line;
+            for (size_t i = 0; i < nkeys; i++) {
+                if (strncmp(line, keys[i].key, key_len) == 0 && keys[i].key[key_len] == '\0') {
+                    counters[keys[i].counter] = strtoull(space + 1, NULL, 10);
+                    break;
+                }
+            }
+        }
+        line = next_line;
+    }
+}
+
+// parses a "nested keyed" file like io.stat, made of "maj:min key=value key=value..." lines,
+// summing the values of all lines
+static void parse_nested_keyed_sum(char* buff, const cgroup_tree_key_t* keys, size_t nkeys, uint64_t* counters)
+{
+    string_field_t fields[16];
+    for (char* line = buff; line && *line != '\0';) {
+        char* next_line = strchr(line, '\n');
+        if (next_line)
+            *next_line++ = '\0';
+
+        size_t nfields = split_fields_on_whitespace(line, fields, 16);
+        for (size_t f = 1; f < nfields; f++) {
+            for (size_t i = 0; i < nkeys; i++) {
+                size_t key_len = strlen(keys[i].key);
+                if (fields[f].len > key_len && strncmp(fields[f].ptr, keys[i].key, key_len) == 0) {
+                    counters[keys[i].counter] += strtoull(fields[f].ptr + key_len, NULL, 10);
+                    break;
+                }
+            }
+        }
+        line = next_line;
+    }
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupTree
+// ----------------------------------------------------------------------------------
+
+CMonitorCgroupTree::~CMonitorCgroupTree()
+{
+    for (const auto& node : m_nodes)
+        if (node.in_use)
+            close(node.dir_fd);
+}
+
+void CMonitorCgroupTree::init(const std::string& cgroup_prefix_for_test)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_TREE) == 0)
+        return;
+
+    std::string mount_point = cgroup_prefix_for_test;
+    if (mount_point.empty()) {
+        CMonitorCgroups probe(m_pCfg, m_pOutput);
+        if (!probe.get_cgroups_mount_point(mount_point) || probe.get_detected_cgroup_version() != CG_VERSION2) {
+            CMonitorLogger::instance()->LogError(
+                "The tree of cgroups can be collected only with cgroups v2. Disabling cgroup tree monitoring.");
+            m_pCfg->m_nCollectFlags &= ~PK_CGROUP_TREE;
+            return;
+        }
+    }
+
+    std::string root_path = mount_point + "/" + m_pCfg->m_strCGroupTreeRoot;
+    int fd = open(root_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0) {
+        CMonitorLogger::instance()->LogErrorWithErrno(
+            "Could not open the root of the tree of cgroups [%s]. Disabling cgroup tree monitoring.",
+            root_path.c_str());
+        if (fd != -1)
+            close(fd);
+        m_pCfg->m_nCollectFlags &= ~PK_CGROUP_TREE;
+        return;
+    }
+
+    add_node(CGROUP_TREE_NO_PARENT, fd, st.st_ino, m_pCfg->m_strCGroupTreeRoot.c_str());
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled()) {
+        size_t size = sizeof(g_prometheus_kpi_cgroup_tree) / sizeof(g_prometheus_kpi_cgroup_tree[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_tree, size);
+    }
+#endif
+
+    CMonitorLogger::instance()->LogDebug("Successfully initialized cgroup tree monitoring from [%s].\n",
+        root_path.c_str());
+}
+
+uint32_t CMonitorCgroupTree::add_node(uint32_t parent, int dir_fd, uint64_t ino, const char* dirent_name)
+{
+    uint32_t id;
+    if (!m_free_nodes.empty()) {
+        id = m_free_nodes.back();
+        m_free_nodes.pop_back();
+    } else {
+        // this is the only case where the flat arrays grow:
+        id = m_nodes.size();
+        m_nodes.emplace_back();
+        m_counters.resize(m_nodes.size() * CGTREE_COUNTER_MAX);
+        m_prev_counters.resize(m_nodes.size() * CGTREE_COUNTER_MAX);
+        m_children_cpu_usage.resize(m_nodes.size());
+    }
+
+    cgroup_tree_node_t& node = m_nodes[id];
+    node.in_use = true;
+    node.dir_fd = dir_fd;
+    node.ino = ino;
+    node.parent = parent;
+    node.generation = m_generation;
+    node.files_read = 0;
+    node.prev_valid = false;
+    node.children.clear();
+    if (parent == CGROUP_TREE_NO_PARENT) {
+        node.depth = 0;
+        node.name = dirent_name;
+    } else {
+        cgroup_tree_node_t& parent_node = m_nodes[parent];
+        node.depth = parent_node.depth + 1;
+        node.name = parent_node.name.empty() ? dirent_name : parent_node.name + "/" + dirent_name;
+        parent_node.children.push_back(id);
+    }
+
+    m_ino2node[ino] = id;
+    return id;
+}
+
+void CMonitorCgroupTree::remove_subtree(uint32_t id)
+{
+    // NOTE: the caller is responsible for removing the node from the list of children of its parent
+    cgroup_tree_node_t& node = m_nodes[id];
+    for (uint32_t child : node.children)
+        remove_subtree(child);
+
+    CMonitorLogger::instance()->LogDebug("The cgroup [%s] has been removed.", node.name.c_str());
+    close(node.dir_fd);
+    m_ino2node.erase(node.ino);
+    node.in_use = false;
+    node.children.clear();
+    m_free_nodes.push_back(id);
+}
+
+void CMonitorCgroupTree::scan_children(uint32_t id)
+{
+    // rewind the cached directory descriptor and list its entries:
+    if (lseek(m_nodes[id].dir_fd, 0, SEEK_SET) != 0)
+        return;
+
+    char buff[CGROUP_TREE_DIRENTS_BUFF_SIZE] __attribute__((aligned(__alignof__(struct linux_dirent64))));
+    while (true) {
+        long nread = syscall(SYS_getdents64, m_nodes[id].dir_fd, buff, sizeof(buff));
+        if (nread <= 0)
+            break;
+
+        for (long offset = 0; offset < nread;) {
+            const struct linux_dirent64* d = (const struct linux_dirent64*)(buff + offset);
+            offset += d->d_reclen;
+            if (d->d_type != DT_DIR || strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+                continue;
+
+            auto it = m_ino2node.find(d->d_ino);
+            if (it != m_ino2node.end() && m_nodes[it->second].parent == id) {
+                m_nodes[it->second].generation = m_generation; // already-known cgroup
+                continue;
+            }
+
+            // new cgroup:
+            if (get_num_nodes() >= CGROUP_TREE_MAX_NODES) {
+                if (!m_max_nodes_warned)
+                    CMonitorLogger::instance()->LogError(
+                        "Too many cgroups in the tree: only the first %d will be monitored.", CGROUP_TREE_MAX_NODES);
+                m_max_nodes_warned = true;
+                continue;
+            }
+            int fd = openat(m_nodes[id].dir_fd, d->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd == -1)
+                continue; // the cgroup has probably just been removed
+            add_node(id, fd, d->d_ino, d->d_name);
+        }
+    }
+
+    // forget about the children that disappeared:
+    std::vector<uint32_t>& children = m_nodes[id].children;
+    size_t num_kept = 0;
+    for (size_t i = 0; i < children.size(); i++) {
+        if (m_nodes[children[i]].generation == m_generation)
+            children[num_kept++] = children[i];
+        else
+            remove_subtree(children[i]);
+    }
+    children.resize(num_kept);
+}
+
+void CMonitorCgroupTree::read_node_counters(uint32_t id)
+{
+    char buff[CGROUP_COLLECTOR_BUFF_SIZE];
+    int dir_fd = m_nodes[id].dir_fd;
+    uint64_t* counters = &m_counters[id * CGTREE_COUNTER_MAX];
+    memset(counters, 0, CGTREE_COUNTER_MAX * sizeof(uint64_t));
+
+    unsigned int files_read = 0;
+    if (read_file_at(dir_fd, "cpu.stat", buff, sizeof(buff))) {
+        parse_flat_keyed(buff, g_cpu_stat_keys, sizeof(g_cpu_stat_keys) / sizeof(g_cpu_stat_keys[0]), counters);
+        files_read |= CGTREE_FILE_CPU_STAT;
+    }
+    if (read_file_at(dir_fd, "memory.current", buff, sizeof(buff))) {
+        counters[CGTREE_MEMORY_CURRENT] = strtoull(buff, NULL, 10);
+        files_read |= CGTREE_FILE_MEMORY_CURRENT;
+    }
+    if (read_file_at(dir_fd, "memory.stat", buff, sizeof(buff))) {
+        parse_flat_keyed(
+            buff, g_memory_stat_keys, sizeof(g_memory_stat_keys) / sizeof(g_memory_stat_keys[0]), counters);
+        files_read |= CGTREE_FILE_MEMORY_STAT;
+    }
+    if (read_file_at(dir_fd, "io.stat", buff, sizeof(buff))) {
+        parse_nested_keyed_sum(buff, g_io_stat_keys, sizeof(g_io_stat_keys) / sizeof(g_io_stat_keys[0]), counters);
+        files_read |= CGTREE_FILE_IO_STAT;
+    }
+
+    // counters are comparable with previous ones only if the same files have been read:
+    if (files_read != m_nodes[id].files_read)
+        m_nodes[id].prev_valid = false;
+    m_nodes[id].files_read = files_read;
+}
+
+void CMonitorCgroupTree::sample(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_CGROUP_TREE) == 0 || m_nodes.empty())
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // depth-first walk of the tree, starting from the root node (always node 0):
+    m_generation++;
+    m_walk_order.clear();
+    m_walk_stack.clear();
+    m_walk_stack.push_back(0);
+    m_nodes[0].generation = m_generation;
+    while (!m_walk_stack.empty()) {
+        uint32_t id = m_walk_stack.back();
+        m_walk_stack.pop_back();
+        m_walk_order.push_back(id);
+
+        read_node_counters(id);
+        scan_children(id);
+
+        // visit the children right after their parent, in the order they have been discovered:
+        const std::vector<uint32_t>& children = m_nodes[id].children;
+        m_walk_stack.insert(m_walk_stack.end(), children.rbegin(), children.rend());
+    }
+
+    if (output_opts != PF_NONE && elapsed_sec > MIN_ELAPSED_SECS) {
+        // roll-up: compute the CPU usage of each node due to its children only
+        for (uint32_t id : m_walk_order)
+            m_children_cpu_usage[id] = 0;
+        for (uint32_t id : m_walk_order) {
+            const cgroup_tree_node_t& node = m_nodes[id];
+            if (node.parent == CGROUP_TREE_NO_PARENT || !node.prev_valid
+                || (node.files_read & CGTREE_FILE_CPU_STAT) == 0)
+                continue;
+            size_t base = id * CGTREE_COUNTER_MAX + CGTREE_CPU_USAGE_USEC;
+            if (m_counters[base] > m_prev_counters[base])
+                m_children_cpu_usage[node.parent] += m_counters[base] - m_prev_counters[base];
+        }
+
+        m_pOutput->psection_start("cgroup_tree");
+        for (uint32_t id : m_walk_order)
+            output_node(id, elapsed_sec, output_opts);
+        m_pOutput->psection_end();
+    }
+
+    // finally remember the last sampled counters:
+    for (uint32_t id : m_walk_order)
+        m_nodes[id].prev_valid = true;
+    m_counters.swap(m_prev_counters);
+}
+
+void CMonitorCgroupTree::output_node(uint32_t id, double elapsed_sec, OutputFields output_opts)
+{
+    const cgroup_tree_node_t& node = m_nodes[id];
+    if (!node.prev_valid || node.files_read == 0)
+        return; // new cgroup: deltas will be available from next sample
+
+    const uint64_t* current = &m_counters[id * CGTREE_COUNTER_MAX];
+    const uint64_t* prev = &m_prev_counters[id * CGTREE_COUNTER_MAX];
+
+#define DELTA_CGTREE(counter) (current[counter] > prev[counter] ? (double)(current[counter] - prev[counter]) : 0.0)
+#define USEC_TO_PCT(usec) ((usec) * 100.0 / (elapsed_sec * 1e6))
+
+    m_pOutput->psubsection_start(node.name.empty() ? "/" : node.name.c_str());
+    m_pOutput->plong("depth", node.depth);
+
+    if (node.files_read & CGTREE_FILE_CPU_STAT) {
+        double usage = DELTA_CGTREE(CGTREE_CPU_USAGE_USEC);
+        double self_usage = usage - (double)m_children_cpu_usage[id];
+        m_pOutput->pdouble("cpu_usage_pct", USEC_TO_PCT(usage));
+        m_pOutput->pdouble("cpu_self_pct", USEC_TO_PCT(self_usage > 0 ? self_usage : 0));
+        if (output_opts == PF_ALL) {
+            m_pOutput->pdouble("cpu_user_pct", USEC_TO_PCT(DELTA_CGTREE(CGTREE_CPU_USER_USEC)));
+            m_pOutput->pdouble("cpu_system_pct", USEC_TO_PCT(DELTA_CGTREE(CGTREE_CPU_SYSTEM_USEC)));
+            m_pOutput->pdouble("cpu_throttled_pct", USEC_TO_PCT(DELTA_CGTREE(CGTREE_CPU_THROTTLED_USEC)));
+        }
+    }
+
+    if (node.files_read & CGTREE_FILE_MEMORY_CURRENT)
+        m_pOutput->plong("memory_current", current[CGTREE_MEMORY_CURRENT]);
+    if (node.files_read & CGTREE_FILE_MEMORY_STAT) {
+        m_pOutput->plong("memory_anon", current[CGTREE_MEMORY_ANON]);
+        m_pOutput->plong("memory_file", current[CGTREE_MEMORY_FILE]);
+        if (output_opts == PF_ALL) {
+            m_pOutput->plong("memory_kernel_stack", current[CGTREE_MEMORY_KERNEL_STACK]);
+            m_pOutput->plong("memory_sock", current[CGTREE_MEMORY_SOCK]);
+            m_pOutput->plong("memory_shmem", current[CGTREE_MEMORY_SHMEM]);
+        }
+    }
+
+    if (node.files_read & CGTREE_FILE_IO_STAT) {
+        m_pOutput->pdouble("io_rbytes", DELTA_CGTREE(CGTREE_IO_RBYTES) / elapsed_sec);
+        m_pOutput->pdouble("io_wbytes", DELTA_CGTREE(CGTREE_IO_WBYTES) / elapsed_sec);
+        if (output_opts == PF_ALL) {
+            m_pOutput->pdouble("io_rios", DELTA_CGTREE(CGTREE_IO_RIOS) / elapsed_sec);
+            m_pOutput->pdouble("io_wios", DELTA_CGTREE(CGTREE_IO_WIOS) / elapsed_sec);
+        }
+    }
+
+    m_pOutput->psubsection_end();
+}
@@ -51,6 +51,7 @@ enum PerformanceKpiFamily {
     PK_BAREMETAL_MEMORY = 8, // collect memory stats from /proc/meminfo
     PK_BAREMETAL_NETWORK = 16, // collect cpu stats from /proc/net/dev
     PK_BAREMETAL_LOAD = 32, // collect avg load stats from /proc/loadavg
+    PK_BAREMETAL_NETWORK_ETHTOOL = 64, // collect NIC driver stats using SIOCETHTOOL ioctl
 
     PK_CGROUP_CPU_ACCT = 128, // collect CPU stats for the whole cgroup from controller "cpu accounting"
     PK_CGROUP_MEMORY = 256, // collect memory stats for the whole cgroup from controller "memory"
@@ -60,6 +61,21 @@ enum PerformanceKpiFamily {
     PK_CGROUP_PROCESSES = 2048, // provide per-PID info about CPU,memory,disk // FIXME: make granularity configurable
     PK_CGROUP_THREADS = 4096, // provide per-thread info about CPU,memory,disk // FIXME: make granularity configurable
 
+    PK_BAREMETAL_SOFTNET = 8192, // collect per-CPU packet processing stats from /proc/net/softnet_stat, /proc/softirqs
+    PK_BAREMETAL_INTERRUPTS = 16384, // collect per-CPU stats of the busiest IRQs from /proc/interrupts
+    PK_BAREMETAL_SCHEDSTAT = 32768, // collect run-queue latency from /proc/schedstat and per-task schedstat
+    PK_BAREMETAL_CPUPOWER = 65536, // collect per-CPU frequency and idle-state residency from sysfs
+    PK_BAREMETAL_FRAGMENTATION = 131072, // collect memory fragmentation from /proc/buddyinfo, /proc/zoneinfo
+    PK_BAREMETAL_PRESSURE = 262144, // collect Pressure Stall Information from /proc/pressure
+    PK_CGROUP_PRESSURE = 524288, // collect Pressure Stall Information from cgroup v2 cpu/memory/io.pressure files
+    PK_CGROUP_TREE = 1048576, // collect CPU, memory and IO stats for each cgroup of a whole cgroup v2 subtree
+    PK_CGROUP_MEMORY_EXT = 2097152, // collect also swap, NUMA, local events and limits from the "memory" cgroup
+    PK_CGROUP_PIDS = 4194304, // collect number of tasks, limit and fork failures from the "pids" cgroup
+    PK_CGROUP_HUGETLB = 8388608, // collect per-page-size usage, limit and failures from the "hugetlb" cgroup
+    PK_CGROUP_TCP = 16777216, // collect TCP socket states, RTT and retransmissions via sock_diag in the cgroup netns
+    PK_BAREMETAL_NETSTAT = 33554432, // collect TCP/UDP protocol counters from /proc/net/snmp, /proc/net/netstat
+    PK_CGROUP_NETSTAT = 67108864, // collect TCP/UDP protocol counters of the network namespace of the cgroup
+
     PK_MAX,
 
     PK_ALL_BAREMETAL
@@ -163,6 +179,10 @@ typedef struct procsinfo_s {
                                       // really did cause to be fetched from the storage layer.
     unsigned long long io_write_bytes; // Attempt to count the number of bytes which this process
                                        // caused to be sent to the storage layer.
+    /* Process stats for scheduler; see https://www.kernel.org/doc/html/latest/scheduler/sched-stats.html */
+    unsigned long long sched_run_ns; // time spent on the CPU
+    unsigned long long sched_wait_ns; // time spent waiting on a runqueue
+    unsigned long long sched_timeslices; // number of timeslices run on a CPU
 } procsinfo_t;
 
 typedef struct proc_topper_s {
@@ -200,7 +220,19 @@ public:
     unsigned int m_nCollectFlags = PK_ALL; // --collect; this is a bitmask of PerformanceKpiFamily values
     OutputFields m_nOutputFields = PF_USED_BY_CHART_SCRIPT_ONLY; // --deep-collect
     std::string m_strCGroupName; // --cgroup-name
+    std::string m_strCGroupDiscoveryRoot; // --cgroup-discovery-root
+    std::string m_strCGroupTreeRoot; // --cgroup-tree-root
+    std::vector<std::string> m_vecDiskInclude; // --disk-include
+    std::vector<std::string> m_vecDiskExclude; // --disk-exclude
+    std::vector<std::string> m_vecEthtoolInterfaces; // --ethtool-interfaces
+    std::vector<std::string> m_vecEthtoolStats = { "rx_missed_errors", "rx_fifo_errors", "rx_over_errors",
+        "rx_no_buffer_count", "rx_dropped", "tx_dropped", "rx_discards", "tx_discards" }; // --ethtool-stats
     uint64_t m_nProcessScoreThreshold = 1; // --score-threshold
+    uint64_t m_nInterruptsThreshold = 100; // --interrupts-threshold
+    uint64_t m_nFragmentationInterval = 10; // --fragmentation-interval
+    std::string m_strPressureTrigger; // --pressure-trigger
+    bool m_bCgroupEventSamples = false; // --cgroup-event-samples
+    std::vector<uint16_t> m_vecCgroupTcpPorts; // --cgroup-tcp-ports
     std::map<std::string, std::string> m_mapCustomMetadata; // --custom-metadata
     RemoteType m_nRemote = REMOTE_NONE; // --remote=none|influxdb|prometheus
 };
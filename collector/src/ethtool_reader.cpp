@@ -0,0 +1,190 @@
+/*
+ * ethtool_reader.cpp -- a class to quickly read over and over the NIC driver
+                         statistics of a network interface using SIOCETHTOOL
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ethtool_reader.h"
+#include "logger.h"
+#include "utils_string.h"
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// the ETHTOOL_GSTRINGS string table can be large (thousands of stats on multi-queue NICs) but it's read only
+// when the set of stats provided by the driver changes:
+#define ETHTOOL_MAX_NUM_STATS 65536
+
+/*
+    PERFORMANCE NOTE:
+    The ETHTOOL_GSTRINGS string table is resolved only once; at each sample an ETHTOOL_GSSET_INFO ioctl checks
+    that the number of stats did not change and a single ETHTOOL_GSTATS ioctl copies the whole u64 stats array
+    into a preallocated buffer, with no text formatting/parsing at all.
+    Only the values of the selected stats are then copied aside to compute rates.
+*/
+
+bool EthtoolStatsReader::get_num_stats(uint32_t& n_stats)
+{
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, m_ifname.c_str(), IFNAMSIZ - 1);
+
+    // ETHTOOL_GSSET_INFO is the modern way to retrieve the length of the string set:
+    uint64_t sset_info_buff[(sizeof(struct ethtool_sset_info) + sizeof(uint32_t)) / sizeof(uint64_t) + 1];
+    memset(sset_info_buff, 0, sizeof(sset_info_buff));
+    struct ethtool_sset_info* sset_info = (struct ethtool_sset_info*)sset_info_buff;
+    sset_info->cmd = ETHTOOL_GSSET_INFO;
+    sset_info->sset_mask = 1ULL << ETH_SS_STATS;
+    ifr.ifr_data = (char*)sset_info;
+    if (ioctl(m_fd, SIOCETHTOOL, &ifr) == 0) {
+        n_stats = sset_info->sset_mask ? sset_info->data[0] : 0;
+        return true;
+    }
+
+    // older drivers provide the number of stats only inside the driver info:
+    struct ethtool_drvinfo drvinfo;
+    memset(&drvinfo, 0, sizeof(drvinfo));
+    drvinfo.cmd = ETHTOOL_GDRVINFO;
+    ifr.ifr_data = (char*)&drvinfo;
+    if (ioctl(m_fd, SIOCETHTOOL, &ifr) != 0)
+        return false;
+
+    n_stats = drvinfo.n_stats;
+    return true;
+}
+
+bool EthtoolStatsReader::init(const std::string& ifname, const std::vector<std::string>& stat_patterns)
+{
+    close(); // in case a previous one had already been initialized
+
+    m_ifname = ifname;
+    m_stat_patterns = stat_patterns;
+    m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_fd == -1)
+        return false;
+
+    uint32_t n_stats = 0;
+    if (!get_num_stats(n_stats) || n_stats == 0 || n_stats > ETHTOOL_MAX_NUM_STATS) {
+        close();
+        return false;
+    }
+
+    // resolve the string table:
+    std::vector<char> gstrings_buff(sizeof(struct ethtool_gstrings) + n_stats * ETH_GSTRING_LEN);
+    struct ethtool_gstrings* gstrings = (struct ethtool_gstrings*)gstrings_buff.data();
+    gstrings->cmd = ETHTOOL_GSTRINGS;
+    gstrings->string_set = ETH_SS_STATS;
+    gstrings->len = n_stats;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, m_ifname.c_str(), IFNAMSIZ - 1);
+    ifr.ifr_data = (char*)gstrings;
+    if (ioctl(m_fd, SIOCETHTOOL, &ifr) != 0) {
+        close();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < gstrings->len && i < n_stats; i++) {
+        string_field_t name;
+        name.ptr = (const char*)&gstrings->data[i * ETH_GSTRING_LEN];
+        name.len = strnlen(name.ptr, ETH_GSTRING_LEN);
+        if (name.len == 0 || !string_field_matches_any_prefix(name, m_stat_patterns))
+            continue;
+
+        m_selected_index.push_back(i);
+        m_selected_name.push_back("ethtool_" + std::string(name.ptr, name.len));
+    }
+
+    if (m_selected_index.empty()) {
+        CMonitorLogger::instance()->LogDebug(
+            "None of the %u ethtool stats of network interface '%s' matches the configured ones\n", n_stats,
+            m_ifname.c_str());
+        close();
+        return false;
+    }
+
+    // preallocate all buffers:
+    m_num_stats = n_stats;
+    m_gstats_buff.resize(1 /* struct ethtool_stats header */ + n_stats);
+    m_current.resize(m_selected_index.size());
+    m_previous.resize(m_selected_index.size());
+    m_num_reads = 0;
+
+    CMonitorLogger::instance()->LogDebug("Monitoring %zu/%u ethtool stats of network interface '%s'\n",
+        m_selected_index.size(), n_stats, m_ifname.c_str());
+    return true;
+}
+
+void EthtoolStatsReader::close()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_selected_index.clear();
+    m_selected_name.clear();
+    m_current.clear();
+    m_previous.clear();
+}
+
+bool EthtoolStatsReader::read_stats()
+{
+    if (m_fd == -1)
+        return false;
+
+    // the kernel copies out as many stats as the driver currently has, regardless of the n_stats we provide:
+    // the current number must be checked before each ETHTOOL_GSTATS to avoid overflowing m_gstats_buff
+    uint32_t n_stats = 0;
+    if (!get_num_stats(n_stats))
+        return false;
+    if (n_stats != m_num_stats) {
+        // the driver changed its set of stats (e.g. after a change in the number of queues): the string table
+        // must be resolved again and no delta can be computed in this sample
+        CMonitorLogger::instance()->LogDebug(
+            "Number of ethtool stats of network interface '%s' changed; reloading them\n", m_ifname.c_str());
+        std::string ifname = m_ifname;
+        std::vector<std::string> stat_patterns = m_stat_patterns;
+        if (!init(ifname, stat_patterns))
+            return false;
+    }
+
+    static_assert(sizeof(struct ethtool_stats) == sizeof(uint64_t), "unexpected ethtool_stats header size");
+    struct ethtool_stats* gstats = (struct ethtool_stats*)m_gstats_buff.data();
+    gstats->cmd = ETHTOOL_GSTATS;
+    gstats->n_stats = m_num_stats;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, m_ifname.c_str(), IFNAMSIZ - 1);
+    ifr.ifr_data = (char*)gstats;
+    if (ioctl(m_fd, SIOCETHTOOL, &ifr) != 0)
+        return false;
+
+    if (gstats->n_stats != m_num_stats)
+        return false; // the set of stats changed again in the meantime: it will be reloaded at next sample
+
+    m_current.swap(m_previous);
+    for (size_t i = 0; i < m_selected_index.size(); i++)
+        m_current[i] = gstats->data[m_selected_index[i]];
+    m_num_reads++;
+    return true;
+}
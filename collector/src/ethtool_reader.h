@@ -0,0 +1,98 @@
+/*
+ * ethtool_reader.h -- a class to quickly read over and over the NIC driver
+                       statistics of a network interface using SIOCETHTOOL
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// The EthtoolStatsReader class
+// Usage example:
+/*
+    class MyClass {
+        void init() { m_reader.init("eth0", { "rx_missed_errors", "rx_queue_*" }); }
+       ...
+    private:
+       EthtoolStatsReader m_reader;
+    }
+
+    void MyClass::my_timer_func()
+    {
+        if (m_reader.read_stats() && m_reader.has_previous_stats()) {
+            for (size_t i = 0; i < m_reader.get_num_selected_stats(); i++)
+                // process m_reader.get_stat_name(i) and m_reader.get_stat_delta(i)
+        }
+    }
+*/
+//------------------------------------------------------------------------------
+
+class EthtoolStatsReader {
+public:
+    EthtoolStatsReader() { m_fd = -1; }
+    EthtoolStatsReader(const EthtoolStatsReader&) = delete; // owns a socket
+    ~EthtoolStatsReader() { close(); }
+
+    // configuration API:
+
+    // resolves the ETHTOOL_GSTRINGS string table of the given interface and selects the statistics whose name
+    // matches one of the given patterns (a trailing '*' matches all names starting with the given prefix);
+    // fails if the driver provides no statistics (e.g. loopback, veth, bridges) or no statistic gets selected
+    bool init(const std::string& ifname, const std::vector<std::string>& stat_patterns);
+    void close();
+    bool is_valid() const { return m_fd != -1; }
+
+    // actual statistics READING:
+
+    // fetches with a single ETHTOOL_GSTATS ioctl the whole stats array into a preallocated buffer and
+    // keeps both the current and the previous values of the selected statistics; if the driver changed its
+    // number of stats, the string table is resolved again before reading them
+    bool read_stats();
+    bool has_previous_stats() const { return m_num_reads > 1; }
+
+    size_t get_num_selected_stats() const { return m_selected_index.size(); }
+    const char* get_stat_name(size_t i) const { return m_selected_name[i].c_str(); }
+    uint64_t get_stat_delta(size_t i) const { return m_current[i] - m_previous[i]; }
+
+private:
+    bool get_num_stats(uint32_t& n_stats);
+
+private:
+    int m_fd; // socket used only as ioctl() target; if -1 indicates invalid reader
+    std::string m_ifname;
+    std::vector<std::string> m_stat_patterns;
+
+    std::vector<uint32_t> m_selected_index; // index of each selected stat inside the ETHTOOL_GSTATS array
+    std::vector<std::string> m_selected_name; // output name of each selected stat
+    std::vector<uint64_t> m_current, m_previous; // values of selected stats only
+
+    // the ETHTOOL_GSTATS buffer: a struct ethtool_stats header followed by the array of all stats
+    std::vector<uint64_t> m_gstats_buff;
+    uint32_t m_num_stats = 0;
+    unsigned int m_num_reads = 0;
+};
+
+typedef std::map<std::string /* interface name */, EthtoolStatsReader> ethtool_readers_map_t;
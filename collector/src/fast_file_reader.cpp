@@ -23,26 +23,24 @@
 #include "utils_string.h"
 #include <assert.h>
 #include <fcntl.h> // open()
-#include <unistd.h> // read()
+#include <unistd.h> // pread()
 
 /* static */ char FastFileReader::m_buff[FAST_FILE_READER_MAX_FILE_SIZE];
 
 /*
     PERFORMANCE NOTE:
-    Please check open_fopen_ifstream_benchmark.cpp to see how this solution (open()+lseek()+full file read)
+    Please check open_fopen_ifstream_benchmark.cpp to see how this solution (open()+pread() of the full file)
     compares for speed with other solutions...
+    Since the file descriptor is kept open and all reads are done with pread() at an explicit offset, rewinding
+    the file does not require any syscall: reading a small file costs a single pread() per sample.
 */
 
 bool FastFileReader::open_or_rewind()
 {
     m_start_next_line_to_process = NULL;
     m_num_lines = 0;
-    if (m_fd != -1 && !m_reopen_each_time) {
-        // file was already open, just seek again back to the beginning
-        off_t ret = lseek(m_fd, 0, SEEK_SET);
-        if (ret == -1)
-            return false;
-    } else {
+    m_read_offset = 0; // if the file was already open, next pread() will start again from the beginning
+    if (m_fd == -1 || m_reopen_each_time) {
         if (m_fd != -1)
             ::close(m_fd);
 
@@ -52,6 +50,15 @@ bool FastFileReader::open_or_rewind()
             return false;
     }
 
+    if (m_streaming) {
+        // read just the first chunk; next ones will be read by get_next_line()
+        m_buff_len = 0;
+        m_eof = false;
+        m_start_next_line_to_process = m_buff;
+        m_end_next_line_to_process = NULL;
+        return read_next_chunk() && m_buff_len > 0;
+    }
+
     // cache the entire file contents in memory
     return read_whole_file();
 }
@@ -68,7 +75,7 @@ void FastFileReader::close()
 bool FastFileReader::read_whole_file()
 {
     assert(m_fd != -1);
-    ssize_t nread = read(m_fd, m_buff, FAST_FILE_READER_MAX_FILE_SIZE);
+    ssize_t nread = pread(m_fd, m_buff, FAST_FILE_READER_MAX_FILE_SIZE, 0);
     if (nread <= 0 || nread >= (ssize_t)FAST_FILE_READER_MAX_FILE_SIZE)
         return false; // we expect a non-zero value less than the "m_buff" size
 
@@ -78,6 +85,33 @@ bool FastFileReader::read_whole_file()
     return true;
 }
 
+bool FastFileReader::read_next_chunk()
+{
+    assert(m_fd != -1);
+
+    // move the (partial) line not yet processed at the beginning of the buffer:
+    size_t remaining = m_buff + m_buff_len - m_start_next_line_to_process;
+    if (remaining > 0 && m_start_next_line_to_process != m_buff)
+        memmove(m_buff, m_start_next_line_to_process, remaining);
+    m_start_next_line_to_process = m_buff;
+    m_buff_len = remaining;
+
+    size_t available = FAST_FILE_READER_MAX_FILE_SIZE - 1 /* NUL terminator */ - m_buff_len;
+    if (available == 0)
+        return false; // a single line does not fit the buffer
+
+    ssize_t nread = pread(m_fd, m_buff + m_buff_len, available, m_read_offset);
+    if (nread < 0)
+        return false;
+    if (nread == 0)
+        m_eof = true;
+    m_read_offset += nread;
+
+    m_buff_len += nread;
+    m_buff[m_buff_len] = '\0'; // add NUL termination
+    return true;
+}
+
 const char* FastFileReader::get_next_line()
 {
     if (m_start_next_line_to_process == NULL)
@@ -96,6 +130,12 @@ const char* FastFileReader::get_next_line()
 
     // find first newline
     m_end_next_line_to_process = strchr(m_start_next_line_to_process, '\n');
+    while (m_end_next_line_to_process == NULL && m_streaming && !m_eof) {
+        // the next line is not complete yet: read more data from the file
+        if (!read_next_chunk())
+            break;
+        m_end_next_line_to_process = strchr(m_start_next_line_to_process, '\n');
+    }
     if (m_end_next_line_to_process == NULL) // no more newlines
     {
         m_start_next_line_to_process = NULL;
@@ -119,6 +159,23 @@ bool FastFileReader::read_integer(uint64_t& value)
     return string2int(get_next_line(), value);
 }
 
+bool FastFileReader::read_integer_or_max(uint64_t& value)
+{
+    if (!open_or_rewind())
+        return false; // file does not exist or not readable
+
+    const char* pline = get_next_line();
+    if (pline == NULL)
+        return false;
+    if (strcmp(pline, "max") == 0) {
+        value = UINT64_MAX;
+        return true;
+    }
+
+    value = 0;
+    return string2int(pline, value);
+}
+
 bool FastFileReader::read_numeric_stats(
     const std::set<std::string>& allowedStatsNames, key_value_map_t& out, numeric_parser_stats_t& out_stats)
 {
@@ -94,6 +94,7 @@ public:
         m_start_next_line_to_process = NULL;
         m_num_lines = 0;
         m_reopen_each_time = false;
+        m_streaming = false;
     }
     ~FastFileReader() { close(); }
 
@@ -109,6 +110,12 @@ public:
     }
     std::string get_file() const { return m_filepath; }
 
+    // by default the whole file is cached in memory at each open_or_rewind() and files larger than
+    // FAST_FILE_READER_MAX_FILE_SIZE cannot be read; in streaming mode the file is instead read in chunks
+    // of FAST_FILE_READER_MAX_FILE_SIZE bytes while lines are consumed with get_next_line(), so that there
+    // is no limit on the file size but just on the length of each line
+    void set_streaming_mode(bool streaming) { m_streaming = streaming; }
+
     // actual file READING:
 
     bool open_or_rewind();
@@ -120,6 +127,10 @@ public:
     // assume the whole file just contains a single integer and parse it
     bool read_integer(uint64_t& value);
 
+    // same as read_integer() but accepts also the special value "max" used by cgroups v2 to indicate
+    // the absence of a limit; in such case UINT64_MAX is returned
+    bool read_integer_or_max(uint64_t& value);
+
     // assume the whole file contains statistics in the format:
     //   STATNAME  <value>
     // and read all those listed in provided whitelist
@@ -128,10 +139,12 @@ public:
 
 private:
     bool read_whole_file();
+    bool read_next_chunk();
 
 private:
     std::string m_filepath;
     bool m_reopen_each_time;
+    bool m_streaming;
     int m_fd; // if -1 indicates invalid file descriptor
 
     // the cache buffer is static because cmonitor_collector is mono-thread so we don't
@@ -146,4 +159,9 @@ private:
     char* m_start_next_line_to_process;
     char* m_end_next_line_to_process;
     unsigned int m_num_lines;
+
+    // streaming mode status
+    size_t m_buff_len = 0; // number of valid bytes inside m_buff
+    bool m_eof = false;
+    off_t m_read_offset = 0; // file offset for the next pread()
 };
@@ -35,6 +35,7 @@
 #include <sstream>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -70,6 +71,10 @@
 */
 #define MIN_SAMPLING_TIME_SEC (0.01)
 
+// a single kernel event (e.g. an OOM kill) might update the cgroup files several times in a row: wait a bit
+// before taking an event sample, so that all these updates get coalesced into a single sample
+#define CGROUP_EVENT_COALESCING_MSEC (100)
+
 #define CMONITOR_DEFAULT_PROMETHEUS_PORT 8080
 #define CMONITOR_DEFAULT_PROMETHEUS_PORT_STR "8080"
 
@@ -89,11 +94,19 @@ bool g_bExiting = false;
 // The App object
 //------------------------------------------------------------------------------
 
+enum SamplingSleepResult {
+    SLEEP_COMPLETED, // the whole sleep time elapsed, or a signal was received
+    SLEEP_INTERRUPTED, // woken up too early for no relevant reason: sleep again for the time left
+    SLEEP_PRESSURE_TRIGGER, // a PSI trigger fired: take a new sample immediately
+    SLEEP_CGROUP_EVENT, // the kernel reported some cgroup event
+};
+
 class CMonitorCollectorApp {
 public:
     CMonitorCollectorApp()
         : m_header_info_generator(&m_cfg, &m_output)
         , m_cgroups_collector(&m_cfg, &m_output)
+        , m_cgroup_tree_collector(&m_cfg, &m_output)
         , m_system_collector(&m_cfg, &m_output)
     {
     }
@@ -105,8 +118,12 @@ public:
 private:
     void print_help();
     void check_pid_file();
-    void output_sample_date_time(long loop, const std::string& utcTime);
-    void do_sampling_sleep();
+    void output_sample_date_time(long loop, const std::string& utcTime, const char* event = nullptr);
+    SamplingSleepResult do_sampling_sleep(uint64_t sleep_msec);
+    bool sleep_until_next_sample(long last_loop, const std::set<std::string>& charted_stats_from_cgroup_memory_v1,
+        const std::set<std::string>& charted_stats_from_cgroup_memory_v2);
+    void sample_cgroup_events(long last_loop, const std::set<std::string>& charted_stats_from_cgroup_memory_v1,
+        const std::set<std::string>& charted_stats_from_cgroup_memory_v2);
     void fill_with_defaults();
 
 private:
@@ -124,7 +141,8 @@ private:
     // Stats collectors
     //------------------------------------------------------------------------------
     CMonitorHeaderInfo m_header_info_generator;
-    CMonitorCgroups m_cgroups_collector;
+    CMonitorCgroupsSet m_cgroups_collector;
+    CMonitorCgroupTree m_cgroup_tree_collector;
     CMonitorSystem m_system_collector;
 };
 
@@ -141,8 +159,19 @@ struct option g_long_opts[] = {
     { "collect", required_argument, 0, 'C' }, // force newline
     { "deep-collect", no_argument, 0, 'e' }, // force newline
     { "cgroup-name", required_argument, 0, 'g' }, // force newline
+    { "cgroup-discovery-root", required_argument, 0, 'G' }, // force newline
+    { "cgroup-tree-root", required_argument, 0, 'W' }, // force newline
     { "score-threshold", required_argument, 0, 't' }, // force newline
     { "custom-metadata", required_argument, 0, 'M' }, // force newline
+    { "disk-include", required_argument, 0, 'I' }, // force newline
+    { "disk-exclude", required_argument, 0, 'E' }, // force newline
+    { "ethtool-interfaces", required_argument, 0, 'N' }, // force newline
+    { "ethtool-stats", required_argument, 0, 'S' }, // force newline
+    { "interrupts-threshold", required_argument, 0, 'R' }, // force newline
+    { "fragmentation-interval", required_argument, 0, 'B' }, // force newline
+    { "pressure-trigger", required_argument, 0, 'T' }, // force newline
+    { "cgroup-event-samples", no_argument, 0, 'O' }, // force newline
+    { "cgroup-tcp-ports", required_argument, 0, 'L' }, // force newline
 
     // Options to save data locally
     { "output-directory", required_argument, 0, 'm' }, // force newline
@@ -174,7 +203,9 @@ struct option_extended {
     { "Data sampling options", &g_long_opts[1],
         "Number of samples to collect; special values are:\n" // force newline
         "   '0': means forever (default value)\n" // force newline
-        "   'until-cgroup-alive': until the cgroup selected by --cgroup-name is alive" },
+        "   'until-cgroup-alive': until the cgroup selected by --cgroup-name is alive (or, when many cgroups\n"
+        "                         are selected, until at least one of them is alive); with cgroups v2 a cgroup\n"
+        "                         without processes is not considered alive anymore" },
     { "Data sampling options", &g_long_opts[2],
         "Allow multiple simultaneously-running instances of cmonitor_collector on this system.\n"
         "Default is to block attempts to start more than one background instance." },
@@ -186,15 +217,33 @@ struct option_extended {
         "  'disk': collect disk stats from /proc/diskstats\n" // force newline
         "  'network': collect network stats from /proc/net/dev\n" // force newline
         "  'load': collect system load stats from /proc/loadavg\n" // force newline
+        "  'network_ethtool': collect also NIC driver stats via ethtool for interfaces monitored by 'network'\n"
+        "  'softnet': collect per-CPU packet processing stats from /proc/net/softnet_stat, /proc/softirqs\n"
+        "  'interrupts': collect per-CPU stats of the busiest IRQs from /proc/interrupts\n"
+        "  'schedstat': collect per-CPU runqueue latency from /proc/schedstat; when combined with\n"
+        "               'cgroup_processes' or 'cgroup_threads' collect also the per-task runqueue latency\n"
+        "  'cpupower': collect per-CPU frequency and idle-state residency from /sys/devices/system/cpu\n"
+        "  'fragmentation': collect memory fragmentation and watermarks from /proc/buddyinfo, /proc/zoneinfo\n"
+        "  'pressure': collect Pressure Stall Information from /proc/pressure\n"
+        "  'netstat': collect TCP/UDP protocol counters from /proc/net/snmp, /proc/net/netstat\n"
         "  'cgroup_cpu': collect CPU stats from the 'cpuacct' cgroup\n" // force newline
         "  'cgroup_memory': collect memory stats from 'memory' cgroup\n" // force newline
-        /*"  'cgroup_blkio': collect IO stats from 'blkio' cgroup\n" NOT YET AVAILABLE */
+        "  'cgroup_memory_ext': collect also per-NUMA-node, swap, local events and limits/headroom stats from\n"
+        "                       'memory' cgroup; implies 'cgroup_memory'\n"
+        "  'cgroup_pids': collect number of tasks, limit and fork failures from 'pids' cgroup\n"
+        "  'cgroup_hugetlb': collect per-page-size huge page usage, limit and failures from 'hugetlb' cgroup\n"
+        "  'cgroup_tcp': collect TCP socket states, RTT and retransmissions for the network namespace of the cgroup\n"
+        "  'cgroup_netstat': collect TCP/UDP protocol counters for the network namespace of the cgroup\n"
+        "  'cgroup_blkio': collect per-device IO stats from 'blkio' cgroup (v1) or 'io' cgroup (v2)\n"
         "  'cgroup_network': collect network statistics by interface for the network namespace of the cgroup\n" // force
                                                                                                                 // newline
         "  'cgroup_processes': collect stats for each process inside the 'cpuacct' cgroup\n" // force newline
         "  'cgroup_threads': collect stats for each thread inside the 'cpuacct' cgroup\n" // force newline
+        "  'cgroup_pressure': collect Pressure Stall Information from cpu/memory/io.pressure files of cgroups v2\n"
+        "  'cgroup_tree': collect CPU, memory and IO stats for each cgroup of the tree selected by\n"
+        "                 --cgroup-tree-root (cgroups v2 only)\n"
         "  'all_baremetal': the combination of 'cpu', 'memory', 'disk', 'network'\n" // force newline
-        "  'all_cgroup': the combination of 'cgroup_cpu', 'cgroup_memory', 'cgroup_processes'\n" // force newline
+        "  'all_cgroup': the combination of 'cgroup_cpu', 'cgroup_memory', 'cgroup_blkio', 'cgroup_processes'\n"
         "  'all': the combination of all previous stats (this is the default)\n" // force newline
         "Note that a comma-separated list of above stats can be provided." },
     { "Data sampling options", &g_long_opts[5],
@@ -206,47 +255,101 @@ struct option_extended {
         "the cgroup to monitor. If 'self' value is passed (the default), the statistics of the cgroups where\n"
         "cmonitor_collector runs will be collected. Note that this option is mostly useful when running\n"
         "cmonitor_collector directly on the baremetal since a process running inside a container cannot monitor\n"
-        "the performances of other containers." },
+        "the performances of other containers.\n"
+        "A comma-separated list of cgroup names and/or glob patterns (e.g. 'docker/*') can be provided to monitor\n"
+        "many cgroups at once: in such case each cgroup section in the JSON output is named '<section>:<cgroup>'\n"
+        "and InfluxDB/Prometheus data points are tagged/labelled with 'cgroup=<cgroup>'." },
     { "Data sampling options", &g_long_opts[7],
+        "If cgroup sampling is active (--collect=cgroups*), this option allows to monitor all cgroups found below\n"
+        "the provided root cgroup (e.g. 'kubepods.slice'), at any depth. Cgroups created or removed while\n"
+        "cmonitor_collector is running are automatically detected and monitored. Cannot be used together\n"
+        "with --cgroup-name. The output format is the same used when --cgroup-name selects many cgroups." },
+    { "Data sampling options", &g_long_opts[8],
+        "If cgroup tree sampling is active (--collect=cgroup_tree), this option allows to provide the name of the\n"
+        "cgroup at the root of the tree to walk (e.g. 'kubepods.slice'). By default the whole tree of cgroups is\n"
+        "walked, starting from the cgroup v2 mount point." },
+    { "Data sampling options", &g_long_opts[9],
         "If cgroup process/thread sampling is active (--collect=cgroup_processes/cgroup_threads) use the provided\n"
         "score threshold to filter out non-interesting processes/threads. The 'score' is a number that is linearly\n"
         "increasing with the CPU usage. Defaults to '1' to filter out all processes/threads having zero CPU usage.\n"
         "Use '0' to turn off filtering by score." },
-    { "Data sampling options", &g_long_opts[8],
+    { "Data sampling options", &g_long_opts[10],
         "Allows to specify custom metadata key:value pairs that will be saved into the JSON output (if saving data\n"
-        "locally) under the 'header.custom_metadata' path. Can be used multiple times. See usage examples below.\n" },
+        "locally) under the 'header.custom_metadata' path. Can be used multiple times. See usage examples below." },
+    { "Data sampling options", &g_long_opts[11],
+        "If disk sampling is active (--collect=disk), collect stats only for the provided comma-separated list of\n"
+        "devices. A trailing '*' matches all devices starting with the given prefix, e.g. 'sd*,nvme*'.\n"
+        "By default all devices listed in /proc/diskstats are monitored." },
+    { "Data sampling options", &g_long_opts[12],
+        "If disk sampling is active (--collect=disk), skip the provided comma-separated list of devices.\n"
+        "A trailing '*' matches all devices starting with the given prefix, e.g. 'loop*,ram*'." },
+    { "Data sampling options", &g_long_opts[13],
+        "If NIC driver stats sampling is active (--collect=network_ethtool), collect them only for the provided\n"
+        "comma-separated list of network interfaces. A trailing '*' matches all interfaces starting with the given\n"
+        "prefix, e.g. 'eth*,ens*'. By default all network interfaces supporting ethtool stats are monitored." },
+    { "Data sampling options", &g_long_opts[14],
+        "If NIC driver stats sampling is active (--collect=network_ethtool), emit only the provided comma-separated\n"
+        "list of ethtool stats (as shown by 'ethtool -S'). A trailing '*' matches all stats starting with the given\n"
+        "prefix, e.g. 'rx_queue_*'. By default only a few counters related to packet drops are emitted." },
+    { "Data sampling options", &g_long_opts[15],
+        "If interrupts sampling is active (--collect=interrupts), emit only the IRQs whose rate (summed over all\n"
+        "monitored CPUs) is at least the provided number of interrupts per second. Defaults to '100'.\n"
+        "The per-CPU rates of each IRQ are emitted only in the JSON output: Prometheus gets only the total rate of\n"
+        "each IRQ and the summary." },
+    { "Data sampling options", &g_long_opts[16],
+        "If memory fragmentation sampling is active (--collect=fragmentation), sample it only once every N samples\n"
+        "since /proc/zoneinfo is large and fragmentation changes slowly. Defaults to '10'." },
+    { "Data sampling options", &g_long_opts[17],
+        "If pressure sampling is active (--collect=pressure), register the provided PSI trigger on the cpu, memory\n"
+        "and io pressure files, e.g. 'some 150000 1000000' to be notified when tasks stall for at least 150ms\n"
+        "within a 1sec window. When a trigger fires, a new sample is taken immediately instead of waiting for the\n"
+        "end of the sampling interval, so that short stalls are captured at their onset. Such out-of-schedule\n"
+        "samples are marked with an 'event' field inside the 'timestamp' section and do not count towards\n"
+        "--num-samples nor --fragmentation-interval." },
+    { "Data sampling options", &g_long_opts[18],
+        "If cgroup memory sampling is active (--collect=cgroup_memory) on cgroups v2, watch the memory.events file\n"
+        "of the monitored cgroups and, as soon as the kernel reports an OOM kill or a memory.high/max breach, take\n"
+        "an extra sample of the cgroup memory and processes, to capture which tasks were using memory at that\n"
+        "moment. Such extra samples contain only the 'timestamp', 'cgroup_memory_stats' and 'cgroup_tasks'\n"
+        "sections and are marked with an 'event' field inside the 'timestamp' section. At most one extra sample\n"
+        "per sampling interval is taken for each cgroup." },
+    { "Data sampling options", &g_long_opts[19],
+        "If cgroup TCP sampling is active (--collect=cgroup_tcp), aggregate only the TCP sockets having one of the\n"
+        "provided comma-separated list of ports as local or remote port, e.g. '80,443'. The filter is evaluated\n"
+        "by the kernel, so that it bounds the sampling cost on hosts having a large number of sockets.\n"
+        "At most " SOCK_DIAG_MAX_PORTS_STR " ports can be provided. By default all TCP sockets are aggregated." },
 
     // Options to save data locally
-    { "Options to save data locally", &g_long_opts[9],
+    { "Options to save data locally", &g_long_opts[20],
         "Write output JSON and .err files to provided directory (defaults to current working directory)." },
-    { "Options to save data locally", &g_long_opts[10],
+    { "Options to save data locally", &g_long_opts[21],
         "Name the output files using provided prefix instead of defaulting to the filenames:\n"
         "\thostname_<year><month><day>_<hour><minutes>.json  (for JSON data)\n"
         "\thostname_<year><month><day>_<hour><minutes>.err   (for error log)\n"
         "Special argument 'stdout' means JSON output should be printed on stdout and errors/warnings on stderr.\n"
         "Special argument 'none' means that JSON output must be disabled." },
-    { "Options to save data locally", &g_long_opts[11],
+    { "Options to save data locally", &g_long_opts[22],
         "Generate a pretty-printed JSON file instead of a machine-friendly JSON (the default).\n" },
 
     // Options to stream data remotely
-    { "Options to stream data remotely", &g_long_opts[12],
+    { "Options to stream data remotely", &g_long_opts[23],
         "Set the type of remote target: 'none' (default), 'influxdb' or 'prometheus'." },
-    { "Options to stream data remotely", &g_long_opts[13],
+    { "Options to stream data remotely", &g_long_opts[24],
         "When remote is InfluxDB: IP address or hostname of the InfluxDB instance to send measurements to;\n"
         "When remote is Prometheus: listen address, defaults to 0.0.0.0 (to accept connections from all)." },
-    { "Options to stream data remotely", &g_long_opts[14],
+    { "Options to stream data remotely", &g_long_opts[25],
         "When remote is InfluxDB: port of server;\n"
         "When remote is Prometheus: listen port, defaults to " CMONITOR_DEFAULT_PROMETHEUS_PORT_STR "." },
-    { "Options to stream data remotely", &g_long_opts[15],
+    { "Options to stream data remotely", &g_long_opts[26],
         "InfluxDB only: set the collector secret (by default use environment variable CMONITOR_SECRET)." },
-    { "Options to stream data remotely", &g_long_opts[16],
+    { "Options to stream data remotely", &g_long_opts[27],
         "InfluxDB only: set the InfluxDB database name (default is 'cmonitor').\n" },
 
     // help
-    { "Other options", &g_long_opts[17], "Show version and exit" }, // force newline
-    { "Other options", &g_long_opts[18],
+    { "Other options", &g_long_opts[28], "Show version and exit" }, // force newline
+    { "Other options", &g_long_opts[29],
         "Enable debug mode; automatically activates --foreground mode" }, // force newline
-    { "Other options", &g_long_opts[19], "Show this help" },
+    { "Other options", &g_long_opts[30], "Show this help" },
 
     { NULL, NULL, NULL }
 };
@@ -286,6 +389,22 @@ PerformanceKpiFamily string2PerformanceKpiFamily(const std::string& str)
         return PK_BAREMETAL_NETWORK;
     if (to_lower(str) == "load")
         return PK_BAREMETAL_LOAD;
+    if (to_lower(str) == "network_ethtool")
+        return PK_BAREMETAL_NETWORK_ETHTOOL;
+    if (to_lower(str) == "softnet")
+        return PK_BAREMETAL_SOFTNET;
+    if (to_lower(str) == "interrupts")
+        return PK_BAREMETAL_INTERRUPTS;
+    if (to_lower(str) == "schedstat")
+        return PK_BAREMETAL_SCHEDSTAT;
+    if (to_lower(str) == "cpupower")
+        return PK_BAREMETAL_CPUPOWER;
+    if (to_lower(str) == "fragmentation")
+        return PK_BAREMETAL_FRAGMENTATION;
+    if (to_lower(str) == "pressure")
+        return PK_BAREMETAL_PRESSURE;
+    if (to_lower(str) == "netstat")
+        return PK_BAREMETAL_NETSTAT;
 
     if (to_lower(str) == "cgroup_cpu")
         return PK_CGROUP_CPU_ACCT;
@@ -299,6 +418,20 @@ PerformanceKpiFamily string2PerformanceKpiFamily(const std::string& str)
         return PK_CGROUP_PROCESSES;
     if (to_lower(str) == "cgroup_threads")
         return PK_CGROUP_THREADS;
+    if (to_lower(str) == "cgroup_pressure")
+        return PK_CGROUP_PRESSURE;
+    if (to_lower(str) == "cgroup_tree")
+        return PK_CGROUP_TREE;
+    if (to_lower(str) == "cgroup_memory_ext")
+        return PK_CGROUP_MEMORY_EXT;
+    if (to_lower(str) == "cgroup_pids")
+        return PK_CGROUP_PIDS;
+    if (to_lower(str) == "cgroup_hugetlb")
+        return PK_CGROUP_HUGETLB;
+    if (to_lower(str) == "cgroup_tcp")
+        return PK_CGROUP_TCP;
+    if (to_lower(str) == "cgroup_netstat")
+        return PK_CGROUP_NETSTAT;
 
     if (to_lower(str) == "all_baremetal")
         return PK_ALL_BAREMETAL;
@@ -323,6 +456,22 @@ std::string performanceKpiFamily2string(PerformanceKpiFamily k)
         return "network";
     case PK_BAREMETAL_LOAD:
         return "load";
+    case PK_BAREMETAL_NETWORK_ETHTOOL:
+        return "network_ethtool";
+    case PK_BAREMETAL_SOFTNET:
+        return "softnet";
+    case PK_BAREMETAL_INTERRUPTS:
+        return "interrupts";
+    case PK_BAREMETAL_SCHEDSTAT:
+        return "schedstat";
+    case PK_BAREMETAL_CPUPOWER:
+        return "cpupower";
+    case PK_BAREMETAL_FRAGMENTATION:
+        return "fragmentation";
+    case PK_BAREMETAL_PRESSURE:
+        return "pressure";
+    case PK_BAREMETAL_NETSTAT:
+        return "netstat";
 
     case PK_CGROUP_CPU_ACCT:
         return "cgroup_cpu";
@@ -336,6 +485,20 @@ std::string performanceKpiFamily2string(PerformanceKpiFamily k)
         return "cgroup_processes";
     case PK_CGROUP_THREADS:
         return "cgroup_threads";
+    case PK_CGROUP_PRESSURE:
+        return "cgroup_pressure";
+    case PK_CGROUP_TREE:
+        return "cgroup_tree";
+    case PK_CGROUP_MEMORY_EXT:
+        return "cgroup_memory_ext";
+    case PK_CGROUP_PIDS:
+        return "cgroup_pids";
+    case PK_CGROUP_HUGETLB:
+        return "cgroup_hugetlb";
+    case PK_CGROUP_TCP:
+        return "cgroup_tcp";
+    case PK_CGROUP_NETSTAT:
+        return "cgroup_netstat";
 
     default:
         return "";
@@ -532,6 +695,13 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
                     }
                     m_cfg.m_nCollectFlags |= k;
                 }
+
+                // NIC driver stats are emitted together with the /proc/net/dev ones:
+                if (m_cfg.m_nCollectFlags & PK_BAREMETAL_NETWORK_ETHTOOL)
+                    m_cfg.m_nCollectFlags |= PK_BAREMETAL_NETWORK;
+                // ...and the extended cgroup memory stats together with the basic ones:
+                if (m_cfg.m_nCollectFlags & PK_CGROUP_MEMORY_EXT)
+                    m_cfg.m_nCollectFlags |= PK_CGROUP_MEMORY;
             } break;
             case 'e':
                 m_cfg.m_nOutputFields = PF_ALL;
@@ -542,6 +712,12 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
             case 'g':
                 m_cfg.m_strCGroupName = optarg;
                 break;
+            case 'G':
+                m_cfg.m_strCGroupDiscoveryRoot = optarg;
+                break;
+            case 'W':
+                m_cfg.m_strCGroupTreeRoot = optarg;
+                break;
             case 't':
                 if (!string2int(optarg, m_cfg.m_nProcessScoreThreshold)) {
                     printf("Unrecognized score threshold: %s\n", optarg);
@@ -562,6 +738,53 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
                 m_cfg.m_mapCustomMetadata.insert(std::make_pair(key_value_tokens[0], key_value_tokens[1]));
             } break;
 
+            case 'I':
+                m_cfg.m_vecDiskInclude = split_string_in_array(optarg, ',');
+                break;
+            case 'E':
+                m_cfg.m_vecDiskExclude = split_string_in_array(optarg, ',');
+                break;
+            case 'N':
+                m_cfg.m_vecEthtoolInterfaces = split_string_in_array(optarg, ',');
+                break;
+            case 'S':
+                m_cfg.m_vecEthtoolStats = split_string_in_array(optarg, ',');
+                break;
+            case 'R':
+                if (!string2int(optarg, m_cfg.m_nInterruptsThreshold)) {
+                    printf("Unrecognized interrupts threshold: %s\n", optarg);
+                    exit(51);
+                }
+                break;
+            case 'T':
+                m_cfg.m_strPressureTrigger = optarg;
+                break;
+            case 'O':
+                m_cfg.m_bCgroupEventSamples = true;
+                break;
+            case 'L': {
+                std::vector<std::string> tokens = split_string_in_array(optarg, ',');
+                if (tokens.size() > SOCK_DIAG_MAX_PORTS) {
+                    printf("Too many TCP ports provided: %s. At most %d ports are supported.\n", optarg,
+                        SOCK_DIAG_MAX_PORTS);
+                    exit(51);
+                }
+                for (const auto& token : tokens) {
+                    uint64_t port;
+                    if (!string2int(token.c_str(), port) || port == 0 || port > UINT16_MAX) {
+                        printf("Unrecognized TCP port: %s\n", token.c_str());
+                        exit(51);
+                    }
+                    m_cfg.m_vecCgroupTcpPorts.push_back((uint16_t)port);
+                }
+            } break;
+            case 'B':
+                if (!string2int(optarg, m_cfg.m_nFragmentationInterval) || m_cfg.m_nFragmentationInterval == 0) {
+                    printf("Unrecognized fragmentation interval: %s\n", optarg);
+                    exit(51);
+                }
+                break;
+
                 // Local data saving options
             case 'm':
                 m_cfg.m_strOutputDir = optarg;
@@ -654,6 +877,11 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
         exit(55);
     }
 
+    if (!m_cfg.m_strCGroupName.empty() && !m_cfg.m_strCGroupDiscoveryRoot.empty()) {
+        printf("Options --cgroup-name and --cgroup-discovery-root cannot be used together\n");
+        exit(56);
+    }
+
     optind = 0; /* reset getopt lib */
 
     // if some options were not provided, we'll provide good defaults:
@@ -696,11 +924,13 @@ void CMonitorCollectorApp::fill_with_defaults()
 // Application core functions
 //------------------------------------------------------------------------------
 
-void CMonitorCollectorApp::output_sample_date_time(long loop, const std::string& utcTime)
+void CMonitorCollectorApp::output_sample_date_time(long loop, const std::string& utcTime, const char* event)
 {
     m_output.psection_start("timestamp");
     m_output.pstring("UTC", utcTime.c_str());
     m_output.plong("sample_index", loop);
+    if (event)
+        m_output.pstring("event", event); // out-of-schedule sample: sample_index is the one of the previous sample
     m_output.psection_end();
 }
 
@@ -721,16 +951,99 @@ void CMonitorCollectorApp::check_pid_file()
     // else: this is the first instance of this software... continue
 }
 
-void CMonitorCollectorApp::do_sampling_sleep()
+SamplingSleepResult CMonitorCollectorApp::do_sampling_sleep(uint64_t sleep_msec)
 {
-    if (m_cfg.m_nSamplingIntervalMsec > 1000) {
+    int cgroup_events_fd = m_cgroups_collector.get_events_fd();
+    if (m_system_collector.has_pressure_triggers() || cgroup_events_fd != -1) {
+        // sleep but wake up as soon as a PSI trigger fires or the kernel reports a cgroup event:
+        struct pollfd fds[PSI_MAX + 1];
+        unsigned int nfds = m_system_collector.get_pressure_trigger_pollfds(fds);
+        if (cgroup_events_fd != -1) {
+            fds[nfds].fd = cgroup_events_fd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            nfds++;
+        }
+
+        int ret = poll(fds, nfds, (int)std::min(sleep_msec, (uint64_t)INT32_MAX));
+        if (ret <= 0)
+            return SLEEP_COMPLETED; // timeout or EINTR (e.g. SIGTERM received)
+        if (m_system_collector.check_pressure_trigger_pollfds(fds, nfds)) {
+            CMonitorLogger::instance()->LogDebug("PSI trigger fired: taking an out-of-schedule sample");
+            return SLEEP_PRESSURE_TRIGGER;
+        }
+        if (cgroup_events_fd != -1 && (fds[nfds - 1].revents & POLLIN))
+            return SLEEP_CGROUP_EVENT;
+        return SLEEP_INTERRUPTED;
+    }
+
+    if (sleep_msec > 1000) {
         // usleep() cannot sleep more than 1sec, so actually do 2 sleeps:
-        unsigned int num_secs = m_cfg.m_nSamplingIntervalMsec / 1000;
-        unsigned int num_msecs_left = (m_cfg.m_nSamplingIntervalMsec - num_secs * 1000);
+        unsigned int num_secs = sleep_msec / 1000;
+        unsigned int num_msecs_left = (sleep_msec - num_secs * 1000);
         if (sleep(num_secs) == 0)
             usleep(num_msecs_left * 1000);
     } else
-        usleep(m_cfg.m_nSamplingIntervalMsec * 1000);
+        usleep(sleep_msec * 1000);
+    return SLEEP_COMPLETED;
+}
+
+/*
+ Returns true if the sampling interval was cut short by a PSI trigger, i.e. the next sample is out-of-schedule
+ */
+bool CMonitorCollectorApp::sleep_until_next_sample(long last_loop,
+    const std::set<std::string>& charted_stats_from_cgroup_memory_v1,
+    const std::set<std::string>& charted_stats_from_cgroup_memory_v2)
+{
+    double start_time, now;
+    std::string unused;
+    if (!get_timestamp(&start_time, unused))
+        return do_sampling_sleep(m_cfg.m_nSamplingIntervalMsec) == SLEEP_PRESSURE_TRIGGER;
+
+    uint64_t sleep_msec = m_cfg.m_nSamplingIntervalMsec;
+    while (true) {
+        switch (do_sampling_sleep(sleep_msec)) {
+        case SLEEP_COMPLETED:
+            return false;
+        case SLEEP_PRESSURE_TRIGGER:
+            return true;
+        case SLEEP_INTERRUPTED:
+            break;
+        case SLEEP_CGROUP_EVENT:
+            // a single OOM kill updates memory.events several times in a row: coalesce all notifications
+            usleep(CGROUP_EVENT_COALESCING_MSEC * 1000);
+            if (m_cgroups_collector.read_events())
+                sample_cgroup_events(
+                    last_loop, charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2);
+            if (m_cfg.m_nSamples == SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE && !m_cgroups_collector.cgroup_still_exists())
+                return false; // take the last sample right now, covering the last partial interval
+            break;
+        }
+
+        // keep sleeping for the rest of the sampling interval:
+        if (g_bExiting || !get_timestamp(&now, unused))
+            return false;
+        double elapsed_msec = (now - start_time) * 1000;
+        if (elapsed_msec >= (double)m_cfg.m_nSamplingIntervalMsec)
+            return false;
+        sleep_msec = m_cfg.m_nSamplingIntervalMsec - (uint64_t)elapsed_msec;
+    }
+}
+
+void CMonitorCollectorApp::sample_cgroup_events(long last_loop,
+    const std::set<std::string>& charted_stats_from_cgroup_memory_v1,
+    const std::set<std::string>& charted_stats_from_cgroup_memory_v2)
+{
+    double current_time;
+    std::string current_time_str;
+    if (!get_timestamp(&current_time, current_time_str))
+        return;
+
+    m_output.psample_start();
+    output_sample_date_time(last_loop, current_time_str, "cgroup_memory");
+    m_cgroups_collector.sample_memory_events(
+        charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2, m_cfg.m_nOutputFields);
+    m_output.push_current_sample();
 }
 
 void CMonitorCollectorApp::init_collector(int argc, char** argv)
@@ -802,7 +1115,13 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
         (m_cfg.m_nCollectFlags & PK_CGROUP_MEMORY) || // force newline
         (m_cfg.m_nCollectFlags & PK_CGROUP_BLKIO) || // force newline
         (m_cfg.m_nCollectFlags & PK_CGROUP_PROCESSES) || // force newline
-        (m_cfg.m_nCollectFlags & PK_CGROUP_THREADS);
+        (m_cfg.m_nCollectFlags & PK_CGROUP_THREADS) || // force newline
+        (m_cfg.m_nCollectFlags & PK_CGROUP_NETWORK_INTERFACES) || // force newline
+        (m_cfg.m_nCollectFlags & PK_CGROUP_PRESSURE) || // force newline
+        (m_cfg.m_nCollectFlags & PK_CGROUP_PIDS) || // force newline
+        (m_cfg.m_nCollectFlags & PK_CGROUP_HUGETLB) || // force newline
+        (m_cfg.m_nCollectFlags & PK_CGROUP_TCP) || // force newline
+        (m_cfg.m_nCollectFlags & PK_CGROUP_NETSTAT);
     std::set<std::string> monitoredFiles;
 
     // if (bCollectCGroupInfo)
@@ -813,21 +1132,29 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
     // INIT SYSTEM/BAREMETAL STATS COLLECTOR
     m_system_collector.init();
     m_system_collector.sample_cpu_stat(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_vmstat(0, PF_NONE /* do not emit JSON data */);
     m_system_collector.sample_diskstats(0, PF_NONE /* do not emit JSON data */);
     m_system_collector.sample_net_dev(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_netstat(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_softnet_stats(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_interrupts(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_schedstat(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_cpupower(0, PF_NONE /* do not emit JSON data */);
+    m_system_collector.sample_pressure(0, PF_NONE /* do not emit JSON data */);
     m_system_collector.get_list_monitored_files(monitoredFiles);
 
     // INIT CGROUP STATS COLLECTOR
     if (bCollectCGroupInfo) {
         m_cgroups_collector.init(m_cfg.m_nCollectFlags & PK_CGROUP_THREADS);
-
-        m_cgroups_collector.sample_cpuacct(0);
-        m_cgroups_collector.sample_processes(0, PF_NONE /* do not emit JSON */);
-        m_cgroups_collector.sample_processes(0, PF_NONE /* do not emit JSON */);
+        m_cgroups_collector.sample_bootstrap();
 
         m_cgroups_collector.get_list_monitored_files(monitoredFiles);
     }
 
+    // INIT CGROUP TREE STATS COLLECTOR
+    m_cgroup_tree_collector.init();
+    m_cgroup_tree_collector.sample(0, PF_NONE /* do not emit JSON */);
+
     // debug info
     monitoredFiles.erase(""); // remove empty string in case it was added by mistake
     CMonitorLogger::instance()->LogDebug("List of continuosly-open monitored files (%zu): %s", monitoredFiles.size(),
@@ -854,7 +1181,7 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
     if (m_cfg.m_nSamplingIntervalMsec <= 60000) {
         CMonitorLogger::instance()->LogDebug(
             "Sleeping for the first sampling interval=%lumsecs", m_cfg.m_nSamplingIntervalMsec);
-        do_sampling_sleep();
+        do_sampling_sleep(m_cfg.m_nSamplingIntervalMsec);
     } else {
         CMonitorLogger::instance()->LogDebug("Sleeping for the first sampling interval=60secs");
         sleep(60); // if a long time between snapshot do a quick one now so we have one in the bank
@@ -892,12 +1219,19 @@ int CMonitorCollectorApp::run_main_loop()
     CMonitorLogger::instance()->LogDebug("Starting sampling of performance data; collect flags=%u, interval=%lumsecs",
         m_cfg.m_nCollectFlags, m_cfg.m_nSamplingIntervalMsec);
     m_output.psample_array_start();
+    if (m_cfg.m_bCgroupEventSamples)
+        m_cgroups_collector.init_event_watches();
+    if (m_cfg.m_nSamples == SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE)
+        m_cgroups_collector.init_liveness_watches();
     double previous_time = current_time;
-    for (unsigned int loop = 0; m_cfg.m_nSamples == 0 || loop < m_cfg.m_nSamples; loop++) {
+    bool out_of_schedule = false;
+    // out-of-schedule samples (taken as soon as a PSI trigger fires) do not advance the loop counter:
+    for (unsigned int loop = 0; m_cfg.m_nSamples == 0 || loop < m_cfg.m_nSamples; loop += out_of_schedule ? 0 : 1) {
 #ifndef TEST_COLLECTOR_PERFORMANCES // when testing performances we want to push cmonitor_collector at 100% CPU usage
                                     // and then look at hotspots
         if (loop != 0) {
-            do_sampling_sleep();
+            out_of_schedule = sleep_until_next_sample(
+                loop - 1, charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2);
         }
 #endif
         CMonitorLogger::instance()->LogDebug("*** Starting sample %u/%lu ***", loop, m_cfg.m_nSamples);
@@ -911,25 +1245,47 @@ int CMonitorCollectorApp::run_main_loop()
         m_output.psample_start();
 
         // always provide basic sample information like timestamp
-        output_sample_date_time(loop, current_time_str);
+        if (out_of_schedule)
+            output_sample_date_time(loop - 1, current_time_str, "pressure");
+        else
+            output_sample_date_time(loop, current_time_str);
 
         // baremetal stats:
         m_system_collector.sample_loadavg();
         m_system_collector.sample_cpu_stat(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
         m_system_collector.sample_memory(charted_stats_from_meminfo);
+        m_system_collector.sample_vmstat(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
         m_system_collector.sample_net_dev(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_system_collector.sample_netstat(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_system_collector.sample_softnet_stats(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_system_collector.sample_interrupts(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_system_collector.sample_schedstat(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_system_collector.sample_cpupower(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        if (!out_of_schedule) // keep the "once every N samples" schedule
+            m_system_collector.sample_fragmentation(m_cfg.m_nOutputFields /* emit JSON */);
+        m_system_collector.sample_pressure(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
         m_system_collector.sample_diskstats(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
         // m_system_collector.sample_filesystems(); // not really useful...specially for ephemeral containers!
 
         // cgroup stats:
         m_cgroups_collector.sample_cpuacct(elapsed);
         m_cgroups_collector.sample_memory(charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2);
+        m_cgroups_collector.sample_pids(m_cfg.m_nOutputFields /* emit JSON */);
+        m_cgroups_collector.sample_hugetlb(m_cfg.m_nOutputFields /* emit JSON */);
+        m_cgroups_collector.sample_blkio(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_cgroups_collector.sample_pressure(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
         m_cgroups_collector.sample_process_list();
         m_cgroups_collector.sample_network_interfaces(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_cgroups_collector.sample_tcp(m_cfg.m_nOutputFields /* emit JSON */);
+        m_cgroups_collector.sample_netstat(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
         m_cgroups_collector.sample_processes(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_cgroup_tree_collector.sample(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
 
         m_output.push_current_sample();
 
+        // new cgroups get their bootstrap sample now, so that their first emitted sample covers a whole interval:
+        m_cgroups_collector.discover_cgroups();
+
         // in debug mode provide an indication of how much optimized is cmonitor_collector:
         if (m_cfg.m_bDebug) {
             std::string tmp;
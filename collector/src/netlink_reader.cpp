@@ -0,0 +1,569 @@
+/*
+ * netlink_reader.cpp -- a class to quickly dump network interface statistics
+                         over and over using a persistent rtnetlink socket
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "netlink_reader.h"
+#include "logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h> // open()
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // struct tcp_info
+#include <sched.h> // setns()
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* static */ char NetlinkStatsReader::m_buff[NETLINK_READER_BUFF_SIZE];
+
+/*
+    PERFORMANCE NOTE:
+    A single RTM_GETSTATS dump returns the 64bit counters of all links of a network namespace, without
+    any text formatting/parsing on kernel and user side, unlike /proc/net/dev.
+    RTM_GETSTATS is available since Linux 4.7; on older kernels dump_link_stats() fails and callers
+    are expected to fall back to /proc/net/dev.
+*/
+
+// creates a netlink socket of the given protocol inside the network namespace referenced by netns_fd
+// (or inside the current network namespace if -1 is provided) and binds it
+static int open_netlink_socket(int protocol, int netns_fd)
+{
+    // to create a socket inside another network namespace we need to temporarily enter it:
+    int orig_netns_fd = -1;
+    if (netns_fd != -1) {
+        orig_netns_fd = ::open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+        if (orig_netns_fd == -1)
+            return -1;
+        if (setns(netns_fd, CLONE_NEWNET) != 0) {
+            ::close(orig_netns_fd);
+            return -1;
+        }
+    }
+
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+
+    if (orig_netns_fd != -1) {
+        if (setns(orig_netns_fd, CLONE_NEWNET) != 0)
+            CMonitorLogger::instance()->LogErrorWithErrno("failed to restore the original network namespace");
+        ::close(orig_netns_fd);
+    }
+
+    if (fd == -1)
+        return -1;
+
+    struct sockaddr_nl local;
+    memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    if (bind(fd, (struct sockaddr*)&local, sizeof(local)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool NetlinkStatsReader::open(int netns_fd)
+{
+    close(); // in case a previous one had already been opened
+
+    m_fd = open_netlink_socket(NETLINK_ROUTE, netns_fd);
+    if (m_fd == -1)
+        return false;
+
+    m_ifindex2name.clear();
+    return true;
+}
+
+void NetlinkStatsReader::close()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool NetlinkStatsReader::send_dump_request(uint16_t msg_type)
+{
+    struct {
+        struct nlmsghdr nlh;
+        union {
+#ifdef IFLA_STATS_FILTER_BIT
+            struct if_stats_msg ifsm;
+#endif
+            struct ifinfomsg ifi;
+        };
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_type = msg_type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++m_seq;
+    if (msg_type == RTM_GETLINK) {
+        req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+        req.ifi.ifi_family = AF_UNSPEC;
+    } else {
+#ifdef IFLA_STATS_FILTER_BIT
+        req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct if_stats_msg));
+        req.ifsm.family = AF_UNSPEC;
+        req.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+#else
+        return false;
+#endif
+    }
+
+    return send(m_fd, &req, req.nlh.nlmsg_len, 0) == (ssize_t)req.nlh.nlmsg_len;
+}
+
+bool NetlinkStatsReader::receive_dump(uint16_t msg_type)
+{
+    while (true) {
+        ssize_t nread = recv(m_fd, m_buff, NETLINK_READER_BUFF_SIZE, 0);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return false;
+
+        int len = (int)nread;
+        for (struct nlmsghdr* nlh = (struct nlmsghdr*)m_buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != m_seq)
+                continue; // stale reply to a previous (failed) request
+            if (nlh->nlmsg_type == NLMSG_DONE)
+                return true;
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr* err = (struct nlmsgerr*)NLMSG_DATA(nlh);
+                errno = -err->error;
+                return false;
+            }
+
+            if (msg_type == RTM_GETLINK && nlh->nlmsg_type == RTM_NEWLINK) {
+                struct ifinfomsg* ifi = (struct ifinfomsg*)NLMSG_DATA(nlh);
+                int attrlen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+                for (struct rtattr* rta = IFLA_RTA(ifi); RTA_OK(rta, attrlen); rta = RTA_NEXT(rta, attrlen)) {
+                    if (rta->rta_type == IFLA_IFNAME) {
+                        m_ifindex2name[ifi->ifi_index] = (const char*)RTA_DATA(rta);
+                        break;
+                    }
+                }
+            }
+#ifdef IFLA_STATS_FILTER_BIT
+            else if (msg_type == RTM_GETSTATS && nlh->nlmsg_type == RTM_NEWSTATS) {
+                struct if_stats_msg* ifsm = (struct if_stats_msg*)NLMSG_DATA(nlh);
+                int attrlen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifsm));
+                struct rtattr* rta = (struct rtattr*)((char*)ifsm + NLMSG_ALIGN(sizeof(*ifsm)));
+                for (; RTA_OK(rta, attrlen); rta = RTA_NEXT(rta, attrlen)) {
+                    if (rta->rta_type != IFLA_STATS_LINK_64)
+                        continue;
+
+                    m_link_stats.emplace_back();
+                    netlink_link_stats_t& link = m_link_stats.back();
+                    memset(&link, 0, sizeof(link));
+                    link.ifindex = ifsm->ifindex;
+                    memcpy(&link.stats, RTA_DATA(rta),
+                        std::min(sizeof(link.stats), (size_t)RTA_PAYLOAD(rta))); // older kernels have fewer fields
+
+                    const auto it = m_ifindex2name.find(ifsm->ifindex);
+                    if (it != m_ifindex2name.end())
+                        strncpy(link.ifname, it->second.c_str(), IF_NAMESIZE - 1);
+                    else
+                        m_unresolved_ifindex = true;
+                    break;
+                }
+            }
+#endif
+        }
+    }
+}
+
+bool NetlinkStatsReader::resolve_ifindex_names()
+{
+    m_ifindex2name.clear();
+    if (!send_dump_request(RTM_GETLINK) || !receive_dump(RTM_GETLINK))
+        return false;
+
+    for (auto& link : m_link_stats) {
+        const auto it = m_ifindex2name.find(link.ifindex);
+        if (it != m_ifindex2name.end())
+            strncpy(link.ifname, it->second.c_str(), IF_NAMESIZE - 1);
+        else
+            // e.g. a short-lived link removed in the meantime: remember the failed lookup with an empty name,
+            // otherwise each following sample would trigger a new RTM_GETLINK dump; the whole map is rebuilt
+            // anyway at the next dump, triggered by a genuinely new interface index
+            m_ifindex2name[link.ifindex] = "";
+    }
+    return true;
+}
+
+bool NetlinkStatsReader::dump_link_stats()
+{
+    if (m_fd == -1)
+        return false;
+
+    m_link_stats.clear(); // IMPORTANT: clear() but do not shrink_to_fit() to avoid reallocations
+    m_unresolved_ifindex = false;
+
+#ifdef IFLA_STATS_FILTER_BIT
+    if (!send_dump_request(RTM_GETSTATS) || !receive_dump(RTM_GETSTATS))
+        return false;
+#else
+    return false;
+#endif
+
+    // a new interface appeared since last dump: refresh the ifindex -> name mapping
+    if (m_unresolved_ifindex && !resolve_ifindex_names())
+        return false;
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------------
+// NetlinkLinkMonitor
+// ----------------------------------------------------------------------------------
+
+/* static */ char NetlinkLinkMonitor::m_buff[NETLINK_READER_BUFF_SIZE];
+
+bool NetlinkLinkMonitor::open()
+{
+    close(); // in case a previous one had already been opened
+
+    m_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_fd == -1)
+        return false;
+
+    // subscribe BEFORE dumping existing links so that no link creation can be missed in between:
+    struct sockaddr_nl local;
+    memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_LINK;
+    if (bind(m_fd, (struct sockaddr*)&local, sizeof(local)) != 0 || !dump_links()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void NetlinkLinkMonitor::close()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_links.clear();
+}
+
+bool NetlinkLinkMonitor::dump_links()
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifi;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nlh.nlmsg_type = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++m_seq;
+    req.ifi.ifi_family = AF_UNSPEC;
+
+    m_links.clear();
+    if (send(m_fd, &req, req.nlh.nlmsg_len, 0) != (ssize_t)req.nlh.nlmsg_len)
+        return false;
+
+    while (true) {
+        ssize_t nread = recv(m_fd, m_buff, NETLINK_READER_BUFF_SIZE, 0);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return false;
+
+        // notifications interleaved with the dump replies are applied as well; no event is generated
+        // since the caller is going to consider the whole mapping anyway
+        if (process_messages(nread, nullptr))
+            return true;
+    }
+}
+
+bool NetlinkLinkMonitor::process_messages(ssize_t nread, std::vector<netlink_link_event_t>* events)
+{
+    bool dump_done = false;
+    int len = (int)nread;
+    for (struct nlmsghdr* nlh = (struct nlmsghdr*)m_buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+        if (nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR) {
+            if (nlh->nlmsg_seq == m_seq)
+                dump_done = true;
+            continue;
+        }
+        if (nlh->nlmsg_type != RTM_NEWLINK && nlh->nlmsg_type != RTM_DELLINK)
+            continue;
+
+        struct ifinfomsg* ifi = (struct ifinfomsg*)NLMSG_DATA(nlh);
+        const char* ifname = nullptr;
+        int attrlen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+        for (struct rtattr* rta = IFLA_RTA(ifi); RTA_OK(rta, attrlen); rta = RTA_NEXT(rta, attrlen)) {
+            if (rta->rta_type == IFLA_IFNAME) {
+                ifname = (const char*)RTA_DATA(rta);
+                break;
+            }
+        }
+        if (ifname == nullptr)
+            continue;
+
+        netlink_link_event_t ev;
+        memset(&ev, 0, sizeof(ev));
+        strncpy(ev.ifname, ifname, IF_NAMESIZE - 1);
+
+        const auto it = m_links.find(ifi->ifi_index);
+        if (nlh->nlmsg_type == RTM_DELLINK) {
+            if (it == m_links.end())
+                continue;
+            m_links.erase(it);
+            ev.removed = true;
+        } else if (it == m_links.end()) {
+            m_links[ifi->ifi_index] = ifname;
+        } else if (it->second != ifname) {
+            strncpy(ev.prev_ifname, it->second.c_str(), IF_NAMESIZE - 1);
+            it->second = ifname;
+        } else {
+            continue; // e.g. a change of the UP/DOWN flags or MTU: not interesting
+        }
+
+        if (events)
+            events->push_back(ev);
+    }
+
+    return dump_done;
+}
+
+bool NetlinkLinkMonitor::poll_link_events(std::vector<netlink_link_event_t>& events)
+{
+    if (m_fd == -1)
+        return false;
+
+    while (true) {
+        ssize_t nread = recv(m_fd, m_buff, NETLINK_READER_BUFF_SIZE, MSG_DONTWAIT);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true; // all pending notifications have been drained
+        if (nread <= 0) {
+            // typically ENOBUFS: some notifications have been dropped by the kernel, so that the only way to
+            // recover a consistent state is to dump again all links
+            if (!dump_links())
+                close();
+            return false;
+        }
+
+        process_messages(nread, &events);
+    }
+}
+
+// ----------------------------------------------------------------------------------
+// SockDiagReader
+// ----------------------------------------------------------------------------------
+
+/* static */ char SockDiagReader::m_buff[NETLINK_READER_BUFF_SIZE];
+
+/*
+    PERFORMANCE NOTE:
+    Each dump returns the binary tcp_info of the sockets, which is aggregated while walking the receive buffer,
+    unlike /proc/net/tcp which provides much less information in text format.
+    inet_diag requests must select a single address family, so that each dump_tcp_summary() issues one request
+    for AF_INET and one for AF_INET6.
+*/
+
+bool SockDiagReader::open(int netns_fd)
+{
+    close(); // in case a previous one had already been opened
+
+    m_fd = open_netlink_socket(NETLINK_SOCK_DIAG, netns_fd);
+    return m_fd != -1;
+}
+
+void SockDiagReader::close()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool SockDiagReader::set_port_filter(const std::vector<uint16_t>& ports)
+{
+    if (ports.size() > SOCK_DIAG_MAX_PORTS)
+        return false;
+
+    /*
+        The bytecode is a sequence of inet_diag_bc_op: each of them jumps forward by "yes" or "no" bytes
+        depending on the result of its comparison; the socket is accepted only if the program ends exactly
+        at its last byte. Port comparisons store the port in the "no" field of a second inet_diag_bc_op.
+        Each "port == P" condition is implemented as "port >= P && port <= P" (the EQ comparisons are not
+        available on older kernels) and conditions are OR-ed using unconditional jumps to the end:
+            [sport>=P1][sport<=P1][jmp end][dport>=P1][dport<=P1][jmp end] ... [dport>=Pn][dport<=Pn]
+        When a comparison fails, the program continues from the next condition, or falls beyond the end
+        of the program (rejecting the socket) for the last condition.
+    */
+    m_bytecode.clear();
+    size_t num_conditions = ports.size() * 2;
+    for (size_t i = 0; i < num_conditions; i++) {
+        bool is_last = (i == num_conditions - 1);
+        uint16_t port = ports[i / 2];
+        bool is_source = (i % 2) == 0;
+
+        struct inet_diag_bc_op ops[5];
+        memset(ops, 0, sizeof(ops));
+        ops[0].code = is_source ? INET_DIAG_BC_S_GE : INET_DIAG_BC_D_GE;
+        ops[0].yes = 2 * sizeof(struct inet_diag_bc_op);
+        ops[0].no = 5 * sizeof(struct inet_diag_bc_op); // skip also the [jmp end]; beyond the end if last
+        ops[1].no = port;
+        ops[2].code = is_source ? INET_DIAG_BC_S_LE : INET_DIAG_BC_D_LE;
+        ops[2].yes = 2 * sizeof(struct inet_diag_bc_op);
+        ops[2].no = 3 * sizeof(struct inet_diag_bc_op);
+        ops[3].no = port;
+        size_t nops = 4;
+        if (!is_last) {
+            size_t remaining = (num_conditions - i - 1) * 4 * sizeof(struct inet_diag_bc_op)
+                + (num_conditions - i - 2) * sizeof(struct inet_diag_bc_op);
+            ops[4].code = INET_DIAG_BC_JMP;
+            ops[4].yes = sizeof(struct inet_diag_bc_op);
+            ops[4].no = sizeof(struct inet_diag_bc_op) + remaining;
+            nops++;
+        }
+
+        m_bytecode.insert(m_bytecode.end(), (uint8_t*)ops, (uint8_t*)(ops + nops));
+    }
+
+    return true;
+}
+
+bool SockDiagReader::send_dump_request(uint8_t family)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 r;
+        struct rtattr rta;
+        uint8_t bytecode[SOCK_DIAG_MAX_PORTS * 2 * 5 * sizeof(struct inet_diag_bc_op)];
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct inet_diag_req_v2));
+    req.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++m_seq;
+    req.r.sdiag_family = family;
+    req.r.sdiag_protocol = IPPROTO_TCP;
+    req.r.idiag_states = (1 << SOCK_DIAG_TCP_STATES) - 1; // all states
+    req.r.idiag_ext = 1 << (INET_DIAG_INFO - 1);
+    if (!m_bytecode.empty()) {
+        req.rta.rta_type = INET_DIAG_REQ_BYTECODE;
+        req.rta.rta_len = RTA_LENGTH(m_bytecode.size());
+        memcpy(req.bytecode, m_bytecode.data(), m_bytecode.size());
+        req.nlh.nlmsg_len += RTA_ALIGN(req.rta.rta_len);
+    }
+
+    return send(m_fd, &req, req.nlh.nlmsg_len, 0) == (ssize_t)req.nlh.nlmsg_len;
+}
+
+void SockDiagReader::process_socket(uint8_t state, const void* tcp_info, size_t tcp_info_len)
+{
+    m_summary.num_sockets++;
+    if (state < SOCK_DIAG_TCP_STATES)
+        m_summary.num_by_state[state]++;
+    if (tcp_info == nullptr || state == TCP_LISTEN)
+        return; // e.g. TIME_WAIT sockets do not carry any tcp_info
+
+    // older kernels provide a shorter tcp_info: copy only what is available
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info));
+    memcpy(&info, tcp_info, std::min(sizeof(info), tcp_info_len));
+
+    static const uint32_t rtt_bucket_limits_usec[SOCK_DIAG_RTT_BUCKETS - 1] = { 100, 1000, 10000, 100000, 1000000 };
+    unsigned int bucket = 0;
+    while (bucket < SOCK_DIAG_RTT_BUCKETS - 1 && info.tcpi_rtt >= rtt_bucket_limits_usec[bucket])
+        bucket++;
+    m_summary.rtt_histogram[bucket]++;
+    m_summary.rtt_sum_usec += info.tcpi_rtt;
+    m_summary.rtt_max_usec = std::max(m_summary.rtt_max_usec, (uint64_t)info.tcpi_rtt);
+    m_summary.num_rtt_samples++;
+
+    if (info.tcpi_retransmits > 0)
+        m_summary.num_retransmitting++;
+    m_summary.unacked += info.tcpi_unacked;
+    if (info.tcpi_snd_cwnd > 0 && info.tcpi_unacked >= info.tcpi_snd_cwnd)
+        m_summary.num_cwnd_limited++;
+}
+
+bool SockDiagReader::receive_dump()
+{
+    while (true) {
+        ssize_t nread = recv(m_fd, m_buff, NETLINK_READER_BUFF_SIZE, 0);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return false;
+
+        int len = (int)nread;
+        for (struct nlmsghdr* nlh = (struct nlmsghdr*)m_buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != m_seq)
+                continue; // stale reply to a previous (failed) request
+            if (nlh->nlmsg_type == NLMSG_DONE)
+                return true;
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr* err = (struct nlmsgerr*)NLMSG_DATA(nlh);
+                errno = -err->error;
+                return false;
+            }
+            if (nlh->nlmsg_type != SOCK_DIAG_BY_FAMILY)
+                continue;
+
+            struct inet_diag_msg* msg = (struct inet_diag_msg*)NLMSG_DATA(nlh);
+            const void* tcp_info = nullptr;
+            size_t tcp_info_len = 0;
+            int attrlen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*msg));
+            struct rtattr* rta = (struct rtattr*)((char*)msg + NLMSG_ALIGN(sizeof(*msg)));
+            for (; RTA_OK(rta, attrlen); rta = RTA_NEXT(rta, attrlen)) {
+                if (rta->rta_type == INET_DIAG_INFO) {
+                    tcp_info = RTA_DATA(rta);
+                    tcp_info_len = RTA_PAYLOAD(rta);
+                    break;
+                }
+            }
+            process_socket(msg->idiag_state, tcp_info, tcp_info_len);
+        }
+    }
+}
+
+bool SockDiagReader::dump_tcp_summary()
+{
+    if (m_fd == -1)
+        return false;
+
+    memset(&m_summary, 0, sizeof(m_summary));
+    if (!send_dump_request(AF_INET) || !receive_dump())
+        return false;
+
+    // IPv6 might be disabled (e.g. booting with ipv6.disable=1): a failure of the AF_INET6 dump is not fatal,
+    // the IPv4 sockets are still worth reporting
+    if (send_dump_request(AF_INET6))
+        receive_dump();
+
+    return true;
+}
@@ -0,0 +1,264 @@
+/*
+ * netlink_reader.h -- a class to quickly dump network interface statistics
+                       over and over using a persistent rtnetlink socket
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+// the kernel never puts more than 32KB of messages in a single netlink dump reply:
+#define NETLINK_READER_BUFF_SIZE 32768
+
+// max number of TCP ports accepted by SockDiagReader::set_port_filter():
+#define SOCK_DIAG_MAX_PORTS 16
+#define SOCK_DIAG_MAX_PORTS_STR "16"
+
+// TCP states are numbered from TCP_ESTABLISHED=1 to TCP_CLOSING=11, see <netinet/tcp.h>:
+#define SOCK_DIAG_TCP_STATES 12
+
+// RTT histogram buckets: <100us, <1ms, <10ms, <100ms, <1s, >=1s
+#define SOCK_DIAG_RTT_BUCKETS 6
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct netlink_link_stats_s {
+    uint32_t ifindex;
+    char ifname[IF_NAMESIZE];
+    struct rtnl_link_stats64 stats;
+} netlink_link_stats_t;
+
+typedef struct netlink_link_event_s {
+    bool removed; // true for RTM_DELLINK, false for a new or renamed link
+    char ifname[IF_NAMESIZE];
+    char prev_ifname[IF_NAMESIZE]; // non-empty only when an existing link has been renamed
+} netlink_link_event_t;
+
+typedef struct sock_diag_tcp_summary_s {
+    uint64_t num_sockets;
+    uint64_t num_by_state[SOCK_DIAG_TCP_STATES]; // indexed by TCP state
+
+    // the following ones are aggregated from the tcp_info of all non-listening sockets:
+    uint64_t rtt_histogram[SOCK_DIAG_RTT_BUCKETS];
+    uint64_t rtt_sum_usec;
+    uint64_t rtt_max_usec;
+    uint64_t num_rtt_samples;
+    uint64_t num_retransmitting; // sockets currently waiting for a retransmitted segment to be acked
+    uint64_t unacked; // segments in flight
+    uint64_t num_cwnd_limited; // sockets having as many segments in flight as their congestion window allows
+} sock_diag_tcp_summary_t;
+
+//------------------------------------------------------------------------------
+// The NetlinkStatsReader class
+// Usage example:
+/*
+    class MyClass {
+        void init() { m_reader.open(); }
+       ...
+    private:
+       NetlinkStatsReader m_reader;
+    }
+
+    void MyClass::my_timer_func()
+    {
+        if (m_reader.dump_link_stats()) {
+            for (const auto& link : m_reader.get_link_stats())
+                // process link.ifname and link.stats
+        }
+    }
+*/
+//------------------------------------------------------------------------------
+
+class NetlinkStatsReader {
+public:
+    NetlinkStatsReader()
+    {
+        m_fd = -1;
+        m_seq = 0;
+    }
+    ~NetlinkStatsReader() { close(); }
+
+    // configuration API:
+
+    // opens the NETLINK_ROUTE socket inside the network namespace referenced by the given file descriptor
+    // (e.g. an open /proc/<pid>/ns/net file) or inside the current network namespace if -1 is provided;
+    // once created, the socket stays bound to that network namespace for its whole lifetime
+    bool open(int netns_fd = -1);
+    void close();
+    bool is_open() const { return m_fd != -1; }
+
+    // actual statistics READING:
+
+    // sends a single RTM_GETSTATS dump request for all links in the namespace and stores the
+    // IFLA_STATS_LINK_64 counters of each link into a reused array
+    bool dump_link_stats();
+    const std::vector<netlink_link_stats_t>& get_link_stats() const { return m_link_stats; }
+
+private:
+    bool send_dump_request(uint16_t msg_type);
+    bool receive_dump(uint16_t msg_type);
+    bool resolve_ifindex_names();
+
+private:
+    int m_fd; // if -1 indicates invalid socket
+    uint32_t m_seq;
+
+    // interface names are not part of RTM_NEWSTATS messages: they get resolved with a RTM_GETLINK dump
+    // only when a new interface index is found; indexes that could not be resolved map to an empty name:
+    std::unordered_map<uint32_t /* ifindex */, std::string /* ifname */> m_ifindex2name;
+    bool m_unresolved_ifindex = false;
+
+    // results of last dump; the vector capacity is reused across dumps
+    std::vector<netlink_link_stats_t> m_link_stats;
+
+    // the receive buffer is static for the same reasons explained in FastFileReader
+    static char m_buff[NETLINK_READER_BUFF_SIZE];
+};
+
+//------------------------------------------------------------------------------
+// The NetlinkLinkMonitor class
+// Keeps an up-to-date ifindex -> ifname mapping of all links of the current network
+// namespace by subscribing to the RTNLGRP_LINK multicast group.
+// Usage example:
+/*
+    void MyClass::my_timer_func()
+    {
+        std::vector<netlink_link_event_t> events;
+        if (!m_monitor.poll_link_events(events))
+            // notifications have been lost: rescan all links using get_links()
+        for (const auto& ev : events)
+            // process ev.ifname, ev.prev_ifname, ev.removed
+    }
+*/
+//------------------------------------------------------------------------------
+
+class NetlinkLinkMonitor {
+public:
+    NetlinkLinkMonitor() { m_fd = -1; }
+    ~NetlinkLinkMonitor() { close(); }
+
+    // opens a NETLINK_ROUTE socket subscribed to link notifications and dumps all existing links; the socket
+    // is blocking (the initial dump waits for the kernel replies), only poll_link_events() reads it with MSG_DONTWAIT
+    bool open();
+    void close();
+    bool is_open() const { return m_fd != -1; }
+
+    // drains all pending link notifications without blocking, appending to the given vector only the events
+    // that change the set of link names (notifications about e.g. UP/DOWN flag changes are discarded).
+    // Returns false if the kernel dropped some notifications (socket receive buffer overrun): in that case
+    // the mapping returned by get_links() has been rebuilt from scratch and should be used to resync.
+    bool poll_link_events(std::vector<netlink_link_event_t>& events);
+
+    const std::unordered_map<uint32_t /* ifindex */, std::string /* ifname */>& get_links() const { return m_links; }
+
+private:
+    bool dump_links();
+    bool process_messages(ssize_t nread, std::vector<netlink_link_event_t>* events);
+
+private:
+    int m_fd; // if -1 indicates invalid socket
+    uint32_t m_seq = 0;
+    std::unordered_map<uint32_t /* ifindex */, std::string /* ifname */> m_links;
+
+    static char m_buff[NETLINK_READER_BUFF_SIZE];
+};
+
+//------------------------------------------------------------------------------
+// The SockDiagReader class
+// Aggregates the tcp_info of all TCP sockets of a network namespace using a persistent
+// NETLINK_SOCK_DIAG socket. Usage example:
+/*
+    class MyClass {
+        void init() { m_reader.set_port_filter({ 80, 443 }); m_reader.open(); }
+       ...
+    private:
+       SockDiagReader m_reader;
+    }
+
+    void MyClass::my_timer_func()
+    {
+        if (m_reader.dump_tcp_summary())
+            // process m_reader.get_tcp_summary()
+    }
+*/
+//------------------------------------------------------------------------------
+
+class SockDiagReader {
+public:
+    SockDiagReader()
+    {
+        m_fd = -1;
+        m_seq = 0;
+        memset(&m_summary, 0, sizeof(m_summary));
+    }
+    ~SockDiagReader() { close(); }
+
+    // configuration API:
+
+    // opens the NETLINK_SOCK_DIAG socket inside the network namespace referenced by the given file descriptor
+    // or inside the current network namespace if -1 is provided; see NetlinkStatsReader::open()
+    bool open(int netns_fd = -1);
+    void close();
+    bool is_open() const { return m_fd != -1; }
+
+    // restricts the dump to the sockets having the given local or remote port; the filter is evaluated
+    // by the kernel, so that the cost of each dump is bounded even on hosts with a huge number of sockets.
+    // Returns false if more than SOCK_DIAG_MAX_PORTS ports are provided.
+    bool set_port_filter(const std::vector<uint16_t>& ports);
+
+    // actual statistics READING:
+
+    // sends a single inet_diag dump request for each address family and aggregates on the fly the
+    // tcp_info of all returned sockets; no per-socket storage is used.
+    // Returns false only if the IPv4 sockets cannot be dumped: IPv6 might be disabled.
+    bool dump_tcp_summary();
+    const sock_diag_tcp_summary_t& get_tcp_summary() const { return m_summary; }
+
+private:
+    bool send_dump_request(uint8_t family);
+    bool receive_dump();
+    void process_socket(uint8_t state, const void* tcp_info, size_t tcp_info_len);
+
+private:
+    int m_fd; // if -1 indicates invalid socket
+    uint32_t m_seq;
+
+    // INET_DIAG_REQ_BYTECODE program matching the ports given to set_port_filter(); empty if no filter
+    std::vector<uint8_t> m_bytecode;
+
+    // results of last dump
+    sock_diag_tcp_summary_t m_summary;
+
+    static char m_buff[NETLINK_READER_BUFF_SIZE];
+};
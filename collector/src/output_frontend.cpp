@@ -154,6 +154,9 @@ void CMonitorOutputFrontend::init_prometheus_kpis(const prometheus_kpi_descripto
 {
     // loop the metric list and create the prometheus KPI metrics.
     for (size_t i = 0; i < size; i++) {
+        if (m_prometheus_kpi_map.find(kpi[i].kpi_name) != m_prometheus_kpi_map.end())
+            continue; // e.g. when monitoring many cgroups, each of them asks to register the same KPIs
+
         PrometheusKpi* prometheus_kpi = NULL;
         if (kpi[i].kpi_type == prometheus::MetricType::Counter) {
             prometheus_kpi
@@ -229,8 +232,8 @@ void CMonitorOutputFrontend::get_quoted_tag_value(std::string& out, const char*
     }
 }
 
-std::string CMonitorOutputFrontend::generate_influxdb_line(
-    CMonitorMeasurementVector& measurements, const std::string& meas_name, const std::string& ts_nsec)
+std::string CMonitorOutputFrontend::generate_influxdb_line(CMonitorMeasurementVector& measurements,
+    const std::string& meas_name, const std::string& ts_nsec, const std::map<std::string, std::string>& extra_tags)
 {
     // format data according to the InfluxDB "line protocol":
     // see https://docs.influxdata.com/influxdb/v1.7/write_protocols/line_protocol_tutorial/
@@ -249,27 +252,34 @@ std::string CMonitorOutputFrontend::generate_influxdb_line(
     //       for them:
     if (!m_influxdb_tagset.empty())
         ret += "," + m_influxdb_tagset;
+    std::string tmp;
+    for (const auto& tag : extra_tags) {
+        assert(!contains_char_to_escape(tag.first.c_str()));
+        get_quoted_tag_value(tmp, tag.second.c_str());
+        ret += "," + tag.first + "=" + tmp;
+    }
 
     // Whitespace I
     ret += " ";
 
     // Field set
-    std::string tmp;
     tmp.reserve(256);
     for (size_t n = 0; n < measurements.size(); n++) {
         auto& m = measurements[n];
 
         // Field Name
-        assert(!contains_char_to_escape(m.m_name.data()));
-        ret += m.m_name.data();
+        const char* name = get_string(m.m_name);
+        assert(!contains_char_to_escape(name));
+        ret += name;
 
         ret += "=";
 
         // Field Value
-        if (m.m_numeric) {
-            ret += m.m_value.data();
+        if (m.is_numeric()) {
+            char value[CMONITOR_MEASUREMENT_VALUE_MAXLEN];
+            ret.append(value, format_numeric_value(m, value, sizeof(value)));
         } else {
-            get_quoted_field_value(tmp, m.m_value.data());
+            get_quoted_field_value(tmp, get_string(m.m_svalue));
 
             ret += "\"";
             ret += tmp;
@@ -298,18 +308,21 @@ void CMonitorOutputFrontend::push_current_sections_to_influxdb(bool is_header)
         std::vector<std::pair<std::string /* tag name */, std::string /* tag value */>> tags;
         for (auto& sec : m_current_sections) {
             if (sec.m_name == "identity") {
-                tags.push_back(std::make_pair("hostname", sec.get_value_for_measurement("hostname")));
+                tags.push_back(std::make_pair("hostname", get_value_for_measurement(sec.m_measurements, "hostname")));
 
-                std::string ips = sec.get_value_for_measurement("all_ip_addresses");
+                std::string ips = get_value_for_measurement(sec.m_measurements, "all_ip_addresses");
                 replace_string(ips, ",", " ", true);
                 tags.push_back(std::make_pair("all_ip_addresses", ips));
             } else if (sec.m_name == "os_release") {
-                tags.push_back(std::make_pair("os_name", sec.get_value_for_measurement("name")));
-                tags.push_back(std::make_pair("os_pretty_name", sec.get_value_for_measurement("pretty_name")));
-            } else if (sec.m_name == "cgroup_config") {
-                tags.push_back(std::make_pair("cgroup_name", sec.get_value_for_measurement("name")));
+                tags.push_back(std::make_pair("os_name", get_value_for_measurement(sec.m_measurements, "name")));
+                tags.push_back(
+                    std::make_pair("os_pretty_name", get_value_for_measurement(sec.m_measurements, "pretty_name")));
+            } else if (sec.m_name == "cgroup_config" && sec.m_labels.empty()) {
+                // when monitoring many cgroups, the cgroup name is added as tag of each measurement instead
+                tags.push_back(std::make_pair("cgroup_name", get_value_for_measurement(sec.m_measurements, "name")));
             } else if (sec.m_name == "lscpu") {
-                tags.push_back(std::make_pair("cpu_model_name", sec.get_value_for_measurement("model_name")));
+                tags.push_back(
+                    std::make_pair("cpu_model_name", get_value_for_measurement(sec.m_measurements, "model_name")));
             }
         }
 
@@ -353,15 +366,15 @@ void CMonitorOutputFrontend::push_current_sections_to_influxdb(bool is_header)
                         for (size_t subsubsec_idx = 0; subsubsec_idx < subsec.m_subsubsections.size();
                              subsubsec_idx++) {
                             auto& subsubsec = subsec.m_subsubsections[subsubsec_idx];
-                            all_measurements += generate_influxdb_line(
-                                subsubsec.m_measurements, subsubsec.m_name + "_" + subsubsec.m_name, ts_nsec_str);
+                            all_measurements += generate_influxdb_line(subsubsec.m_measurements,
+                                subsubsec.m_name + "_" + subsubsec.m_name, ts_nsec_str, sec.m_labels);
 
                             if (subsubsec_idx < subsec.m_subsubsections.size() - 1)
                                 all_measurements += "\n";
                         }
                     } else {
                         all_measurements += generate_influxdb_line(
-                            subsec.m_measurements, subsec.m_name + "_" + subsec.m_name, ts_nsec_str);
+                            subsec.m_measurements, subsec.m_name + "_" + subsec.m_name, ts_nsec_str, sec.m_labels);
 
                         if (subsec_idx < sec.m_subsections.size() - 1)
                             all_measurements += "\n";
@@ -369,7 +382,7 @@ void CMonitorOutputFrontend::push_current_sections_to_influxdb(bool is_header)
                 }
 
             } else {
-                all_measurements += generate_influxdb_line(sec.m_measurements, sec.m_name, ts_nsec_str);
+                all_measurements += generate_influxdb_line(sec.m_measurements, sec.m_name, ts_nsec_str, sec.m_labels);
             }
 
             if (sec_idx < m_current_sections.size() - 1)
@@ -404,6 +417,7 @@ void CMonitorOutputFrontend::push_current_sections_to_prometheus()
                     for (size_t i = 0; i < subsec.m_subsubsections.size(); i++) {
                         auto& subsubsec = subsec.m_subsubsections[i];
                         lbl = { { "metric", subsubsec.m_name } };
+                        lbl.insert(sec.m_labels.begin(), sec.m_labels.end());
                         if (!subsubsec.m_labels.empty()) {
                             for (const auto& entry : subsubsec.m_labels) {
                                 lbl.insert(std::make_pair(entry.first, entry.second));
@@ -412,8 +426,8 @@ void CMonitorOutputFrontend::push_current_sections_to_prometheus()
                         for (size_t n = 0; n < subsubsec.m_measurements.size(); n++) {
                             auto& measurement = subsubsec.m_measurements[n];
                             if (subsubsec.m_name != "proc_info")
-                                generate_prometheus_metric(
-                                    metric_name, measurement.m_name.data(), measurement.m_dvalue, lbl);
+                                generate_prometheus_metric(metric_name, get_string(measurement.m_name),
+                                    measurement.get_double_value(), lbl);
                         }
                     }
 
@@ -421,14 +435,17 @@ void CMonitorOutputFrontend::push_current_sections_to_prometheus()
                     for (size_t n = 0; n < subsec.m_measurements.size(); n++) {
                         auto& measurement = subsec.m_measurements[n];
                         lbl = { { "metric", subsec.m_name } };
-                        generate_prometheus_metric(metric_name, measurement.m_name.data(), measurement.m_dvalue, lbl);
+                        lbl.insert(sec.m_labels.begin(), sec.m_labels.end());
+                        generate_prometheus_metric(
+                            metric_name, get_string(measurement.m_name), measurement.get_double_value(), lbl);
                     }
                 }
             }
         } else {
             for (size_t n = 0; n < sec.m_measurements.size(); n++) {
                 auto& measurement = sec.m_measurements[n];
-                generate_prometheus_metric(sec.m_name, measurement.m_name.data(), measurement.m_dvalue);
+                generate_prometheus_metric(
+                    sec.m_name, get_string(measurement.m_name), measurement.get_double_value(), sec.m_labels);
             }
         }
     }
@@ -480,21 +497,23 @@ void CMonitorOutputFrontend::push_json_measurements(CMonitorMeasurementVector& m
         push_json_indent(indent);
 
         fputs("\"", m_outputJson);
-        fputs(m.m_name.data(), m_outputJson);
-        if (m.m_numeric) {
+        fputs(get_string(m.m_name), m_outputJson);
+        if (m.is_numeric()) {
             fputs("\": ", m_outputJson);
 
-            // m_value comes from an integer -> string conversion so it contains only chars in range [0-9.]
+            // the number -> string conversion produces only chars in range [0-9.-]
             // no need to enclose it in double quotes
-            fputs(m.m_value.data(), m_outputJson);
+            char value[CMONITOR_MEASUREMENT_VALUE_MAXLEN];
+            fwrite(value, 1, format_numeric_value(m, value, sizeof(value)), m_outputJson);
         } else {
 
-            // m_value cannot be trusted since this was a string read probably from disk or from kernel...
+            // the value cannot be trusted since this was a string read probably from disk or from kernel...
             // process it to make sure it's valid JSON:
-            m.enforce_valid_json_string_value();
+            char* value = get_string(m.m_svalue);
+            enforce_valid_json_string_value(value);
 
             fputs("\": \"", m_outputJson);
-            fputs(m.m_value.data(), m_outputJson);
+            fputs(value, m_outputJson);
             fputs("\"", m_outputJson);
         }
 
@@ -567,7 +586,7 @@ void CMonitorOutputFrontend::push_current_sections_to_json(bool is_header)
     for (size_t sec_idx = 0; sec_idx < m_current_sections.size(); sec_idx++) {
         auto& sec = m_current_sections[sec_idx];
 
-        push_json_object_start(sec.m_name, SECOND_LEVEL);
+        push_json_object_start(sec.get_json_name(), SECOND_LEVEL);
         if (sec.m_measurements.empty()) {
             for (size_t subsec_idx = 0; subsec_idx < sec.m_subsections.size(); subsec_idx++) {
                 auto& subsec = sec.m_subsections[subsec_idx];
@@ -628,6 +647,7 @@ void CMonitorOutputFrontend::push_current_sections(bool is_header)
 
     // IMPORTANT: clear() but do not shrink_to_fit() to avoid a bunch of reallocations for next sample:
     m_current_sections.clear();
+    m_current_strings.clear();
 }
 
 size_t CMonitorOutputFrontend::get_current_sample_measurements() const
@@ -638,12 +658,9 @@ size_t CMonitorOutputFrontend::get_current_sample_measurements() const
         if (sec.m_measurements.empty()) {
             for (size_t i = 0; i < sec.m_subsections.size(); i++) {
                 auto& subsec = sec.m_subsections[i];
-                ;
                 if (subsec.m_measurements.empty()) {
-                    auto& subsubsec = subsec.m_subsubsections[i];
-                    for (size_t i = 0; i < subsec.m_subsubsections.size(); i++) {
+                    for (const auto& subsubsec : subsec.m_subsubsections)
                         ntotal_meas += subsubsec.m_measurements.size();
-                    }
                 } else {
                     ntotal_meas += subsec.m_measurements.size();
                 }
@@ -697,12 +714,13 @@ void CMonitorOutputFrontend::psample_start()
     // empty for now
 }
 
-void CMonitorOutputFrontend::psection_start(const char* section)
+void CMonitorOutputFrontend::psection_start(const char* section, const std::map<std::string, std::string>& labels)
 {
     m_sections++;
 
     CMonitorOutputSection sec;
     sec.m_name = section;
+    sec.m_labels = labels;
     m_current_sections.push_back(sec);
 
     // when adding new measurements, add them as children of this new section:
@@ -754,6 +772,74 @@ void CMonitorOutputFrontend::psubsubsection_end()
     m_current_meas_list = nullptr;
 }
 
+//------------------------------------------------------------------------------
+// Measurement storage
+//------------------------------------------------------------------------------
+
+uint32_t CMonitorOutputFrontend::store_string(const char* str, size_t maxlen)
+{
+    // strings longer than maxlen-1 chars are truncated, as done by the JSON/InfluxDB writers since the beginning
+    uint32_t offset = m_current_strings.size();
+    size_t len = strnlen(str, maxlen - 1);
+    m_current_strings.insert(m_current_strings.end(), str, str + len);
+    m_current_strings.push_back('\0');
+    return offset;
+}
+
+std::string CMonitorOutputFrontend::get_value_for_measurement(
+    const CMonitorMeasurementVector& measurements, const std::string& name)
+{
+    for (const auto& m : measurements) {
+        if (strcmp(get_string(m.m_name), name.c_str()) != 0)
+            continue;
+        if (!m.is_numeric())
+            return get_string(m.m_svalue);
+
+        char value[CMONITOR_MEASUREMENT_VALUE_MAXLEN];
+        return std::string(value, format_numeric_value(m, value, sizeof(value)));
+    }
+    return "";
+}
+
+/* static */
+size_t CMonitorOutputFrontend::format_numeric_value(const CMonitorOutputMeasurement& m, char* out, size_t out_size)
+{
+    out_size--; // numeric values used to be formatted into a NUL-terminated buffer of out_size chars
+    if (m.m_type == CMonitorOutputMeasurement::MT_LONG) {
+        // according to https://www.zverovich.net/2020/06/13/fast-int-to-string-revisited.html
+        // fmt::format_int is be the fastest way to convert integers
+#if FMTLIB_MAJOR_VER >= 6
+        fmt::format_int tmp(m.m_lvalue);
+        size_t len = std::min(tmp.size(), out_size);
+        memcpy(out, tmp.data(), len);
+        return len;
+#else
+        return fmt::format_to_n(out, out_size, "{}", m.m_lvalue).size;
+#endif
+    }
+
+    // with std::to_string() you cannot specify the accuracy (how many decimal digits)
+    auto result = fmt::format_to_n(out, out_size, "{:.3f}", m.m_dvalue);
+    return std::min(result.size, out_size);
+}
+
+/* static */
+void CMonitorOutputFrontend::enforce_valid_json_string_value(char* p)
+{
+    while (*p != '\0') {
+        // isgraph() returns != 0 for following chars:
+        //  !"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\]^_`abcdefghijklmnopqrstuvwxyz{|}~
+        // which are all valid in JSON output, except for the \ character which should be repeated twice to
+        // escape it; however we don't care about that and replace it with space if it appears for some reason
+        // Same thing is done for the double quotes " character since we use to enclose
+        if (*p != ' ' && (isgraph(*p) == 0 || *p == '\\' || *p == '"')) {
+            *p = '*';
+        }
+
+        p++;
+    }
+}
+
 //------------------------------------------------------------------------------
 // JSON field/values
 //------------------------------------------------------------------------------
@@ -763,7 +849,8 @@ void CMonitorOutputFrontend::plong(const char* name, long long value)
     m_long++;
     assert(m_current_meas_list);
 
-    m_current_meas_list->push_back(CMonitorOutputMeasurement(name, value));
+    m_current_meas_list->push_back(
+        CMonitorOutputMeasurement(store_string(name, CMONITOR_MEASUREMENT_NAME_MAXLEN), value));
 }
 
 void CMonitorOutputFrontend::pdouble(const char* name, double value)
@@ -771,7 +858,8 @@ void CMonitorOutputFrontend::pdouble(const char* name, double value)
     m_double++;
     assert(m_current_meas_list);
 
-    m_current_meas_list->push_back(CMonitorOutputMeasurement(name, value));
+    m_current_meas_list->push_back(
+        CMonitorOutputMeasurement(store_string(name, CMONITOR_MEASUREMENT_NAME_MAXLEN), value));
 }
 
 void CMonitorOutputFrontend::pstring(const char* name, const char* value)
@@ -779,5 +867,7 @@ void CMonitorOutputFrontend::pstring(const char* name, const char* value)
     m_string++;
     assert(m_current_meas_list);
 
-    m_current_meas_list->push_back(CMonitorOutputMeasurement(name, value));
+    uint32_t name_offset = store_string(name, CMONITOR_MEASUREMENT_NAME_MAXLEN);
+    m_current_meas_list->push_back(
+        CMonitorOutputMeasurement(name_offset, store_string(value, CMONITOR_MEASUREMENT_VALUE_MAXLEN)));
 }
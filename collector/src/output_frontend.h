@@ -23,7 +23,6 @@
 // Includes
 //------------------------------------------------------------------------------
 
-#include <array>
 #include <set>
 #include <string.h>
 #include <string>
@@ -110,7 +109,7 @@ public:
     void psample_array_start();
     void psample_array_end();
 
-    void psection_start(const char* section);
+    void psection_start(const char* section, const std::map<std::string, std::string>& labels = {});
     void psection_end();
 
     void psubsection_start(const char* resource, const std::map<std::string, std::string>& labels = {});
@@ -139,70 +138,45 @@ public:
     void push_current_sample() { push_current_sections(false); } // writes on file, stdout or socket
 
 private:
+    // Measurements are stored in compact form: names and string values are copied into m_current_strings, a buffer
+    // reused across samples, while numbers are kept in binary form and converted to text only by the JSON and
+    // InfluxDB writers, directly into their output; the Prometheus frontend uses the binary value
     class CMonitorOutputMeasurement {
     public:
-        CMonitorOutputMeasurement(const char* name = "", const char* value = "")
+        enum Type : uint8_t { MT_LONG, MT_DOUBLE, MT_STRING };
+
+        CMonitorOutputMeasurement(uint32_t name, long long value)
+            : m_name(name)
+            , m_type(MT_LONG)
+            , m_lvalue(value)
         {
-            strncpy(m_name.data(), name, CMONITOR_MEASUREMENT_NAME_MAXLEN - 1);
-            strncpy(m_value.data(), value, CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
-            m_dvalue = 0;
-            m_numeric = false;
         }
-        CMonitorOutputMeasurement(const char* name, double value)
+        CMonitorOutputMeasurement(uint32_t name, double value)
+            : m_name(name)
+            , m_type(MT_DOUBLE)
+            , m_dvalue(value)
         {
-            strncpy(m_name.data(), name, CMONITOR_MEASUREMENT_NAME_MAXLEN - 1);
-            // FIXME1: we should find a way to format directly into m_value!
-            // FIXME:2 we should do the double -> string conversion only when JSON output is enabled; e.g. Prometheus
-            // output frontend does not need m_value conversion; or even better we should remove entirely m_value and do
-            // the conversion on the fly ONLY when producing JSON output
-
-            // with std::to_string() you cannot specify the accuracy (how many decimal digits)
-            auto tmp = fmt::format("{:.3f}", value);
-            strncpy(m_value.data(), tmp.c_str(), CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
-            m_dvalue = value;
-            m_numeric = true;
         }
-        CMonitorOutputMeasurement(const char* name, long long value)
+        CMonitorOutputMeasurement(uint32_t name, uint32_t string_value)
+            : m_name(name)
+            , m_type(MT_STRING)
+            , m_svalue(string_value)
         {
-            strncpy(m_name.data(), name, CMONITOR_MEASUREMENT_NAME_MAXLEN - 1);
-            // FIXME1: we should find a way to format directly into m_value!
-            // FIXME:2 we should do the double -> string conversion only when JSON output is enabled; e.g. Prometheus
-            // output frontend does not need m_value conversion; or even better we should remove entirely m_value and do
-            // the conversion on the fly ONLY when producing JSON output
-
-            // according to https://www.zverovich.net/2020/06/13/fast-int-to-string-revisited.html
-            // fmt::format_int is be the fastest way to convert integers
-#if FMTLIB_MAJOR_VER >= 6
-            auto tmp = fmt::format_int(value);
-#else
-            auto tmp = fmt::format("{}", value);
-#endif
-            strncpy(m_value.data(), tmp.c_str(), CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
-            m_dvalue = value;
-            m_numeric = true;
         }
 
-        void enforce_valid_json_string_value()
+        bool is_numeric() const { return m_type != MT_STRING; }
+        double get_double_value() const
         {
-            char* p = &m_value[0];
-            while (*p != '\0') {
-                // isgraph() returns != 0 for following chars:
-                //  !"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\]^_`abcdefghijklmnopqrstuvwxyz{|}~
-                // which are all valid in JSON output, except for the \ character which should be repeated twice to
-                // escape it; however we don't care about that and replace it with space if it appears for some reason
-                // Same thing is done for the double quotes " character since we use to enclose
-                if (*p != ' ' && (isgraph(*p) == 0 || *p == '\\' || *p == '"')) {
-                    *p = '*';
-                }
-
-                p++;
-            }
+            return m_type == MT_DOUBLE ? m_dvalue : (m_type == MT_LONG ? (double)m_lvalue : 0);
         }
 
-        std::array<char, CMONITOR_MEASUREMENT_NAME_MAXLEN> m_name; // use std::array to void dynamic allocations
-        std::array<char, CMONITOR_MEASUREMENT_VALUE_MAXLEN> m_value; // use std::array to void dynamic allocations
-        double m_dvalue = 0; // double value to avoid atof conversion
-        bool m_numeric;
+        uint32_t m_name; // offset of the NUL-terminated name inside m_current_strings
+        Type m_type;
+        union {
+            long long m_lvalue;
+            double m_dvalue;
+            uint32_t m_svalue; // offset of the NUL-terminated value inside m_current_strings
+        };
     };
 
     typedef std::vector<CMonitorOutputMeasurement> CMonitorMeasurementVector;
@@ -212,14 +186,6 @@ private:
         std::string m_name;
         std::map<std::string, std::string> m_labels;
         CMonitorMeasurementVector m_measurements;
-
-        std::string get_value_for_measurement(const std::string& name) const
-        {
-            for (const auto& m : m_measurements)
-                if (strncmp(m.m_name.data(), name.c_str(), m.m_name.size()) == 0)
-                    return std::string(m.m_value.data());
-            return "";
-        }
     };
 
     class CMonitorOutputSubsection {
@@ -228,31 +194,37 @@ private:
         std::map<std::string, std::string> m_labels;
         std::vector<CMonitorOutputSubSubsection> m_subsubsections;
         CMonitorMeasurementVector m_measurements;
-
-        std::string get_value_for_measurement(const std::string& name) const
-        {
-            for (const auto& m : m_measurements)
-                if (strncmp(m.m_name.data(), name.c_str(), m.m_name.size()) == 0)
-                    return std::string(m.m_value.data());
-            return "";
-        }
     };
 
     class CMonitorOutputSection {
     public:
         std::string m_name;
+        std::map<std::string, std::string> m_labels; // e.g. the name of the cgroup when monitoring many cgroups
         std::vector<CMonitorOutputSubsection> m_subsections;
         CMonitorMeasurementVector m_measurements;
 
-        std::string get_value_for_measurement(const std::string& name) const
+        std::string get_json_name() const
         {
-            for (const auto& m : m_measurements)
-                if (strncmp(m.m_name.data(), name.c_str(), m.m_name.size()) == 0)
-                    return std::string(m.m_value.data());
-            return "";
+            // JSON objects cannot have duplicated keys: label values are appended to tell apart the sections
+            // having the same name, e.g. "cgroup_memory_stats:docker/<ID>"
+            std::string ret = m_name;
+            for (const auto& entry : m_labels)
+                ret += ":" + entry.second;
+            return ret;
         }
     };
 
+    //------------------------------------------------------------------------------
+    // Measurement storage
+    //------------------------------------------------------------------------------
+
+    uint32_t store_string(const char* str, size_t maxlen);
+    char* get_string(uint32_t offset) { return &m_current_strings[offset]; }
+    std::string get_value_for_measurement(const CMonitorMeasurementVector& measurements, const std::string& name);
+    // formats at most out_size-1 chars, i.e. the same truncation applied by store_string()
+    static size_t format_numeric_value(const CMonitorOutputMeasurement& m, char* out, size_t out_size);
+    static void enforce_valid_json_string_value(char* p);
+
     //------------------------------------------------------------------------------
     // JSON low-level functions
     //------------------------------------------------------------------------------
@@ -273,8 +245,8 @@ private:
     static void get_quoted_field_value(std::string& out, const char* value);
     static void get_quoted_tag_value(std::string& out, const char* value);
 
-    std::string generate_influxdb_line(
-        CMonitorMeasurementVector& measurements, const std::string& meas_name, const std::string& ts_nsec);
+    std::string generate_influxdb_line(CMonitorMeasurementVector& measurements, const std::string& meas_name,
+        const std::string& ts_nsec, const std::map<std::string, std::string>& extra_tags = {});
 
     void push_current_sections_to_influxdb(bool is_header);
 
@@ -295,6 +267,7 @@ private:
     std::vector<CMonitorOutputSection> m_current_sections;
     CMonitorMeasurementVector* m_current_meas_list
         = nullptr; // pointer to current CMonitorMeasurementVector inside m_current_sections
+    std::vector<char> m_current_strings; // names and string values of all measurements of last sample
 
     // InfluxDB internals
     influx_client_t* m_influxdb_client_conn = nullptr;
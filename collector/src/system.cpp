@@ -35,6 +35,50 @@ void CMonitorSystem::init()
     m_loadavg.set_file("/proc/loadavg");
     m_meminfo.set_file("/proc/meminfo");
     m_vmstat.set_file("/proc/vmstat");
+    m_softnet_stat.set_file("/proc/net/softnet_stat");
+    m_net_dev.set_file("/proc/net/dev");
+    m_softirqs.set_file("/proc/softirqs");
+    m_interrupts.set_file("/proc/interrupts");
+    m_schedstat.set_file("/proc/schedstat");
+    m_buddyinfo.set_file("/proc/buddyinfo");
+    m_zoneinfo.set_file("/proc/zoneinfo");
+    m_pressure[PSI_CPU].reader.set_file("/proc/pressure/cpu");
+    m_pressure[PSI_MEMORY].reader.set_file("/proc/pressure/memory");
+    m_pressure[PSI_IO].reader.set_file("/proc/pressure/io");
+    init_netstat_readers(m_netstat, "/proc/net", false);
+
+    // these files grow with the number of CPUs (or network interfaces) and easily exceed
+    // FAST_FILE_READER_MAX_FILE_SIZE:
+    m_net_dev.set_streaming_mode(true);
+    m_softnet_stat.set_streaming_mode(true);
+    m_softirqs.set_streaming_mode(true);
+    m_interrupts.set_streaming_mode(true);
+    m_schedstat.set_streaming_mode(true);
+    m_zoneinfo.set_streaming_mode(true);
+
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_SCHEDSTAT) && !m_schedstat.open_or_rewind()) {
+        // the kernel exposes this file only when built with CONFIG_SCHEDSTATS, while the per-task schedstat
+        // files only need CONFIG_SCHED_INFO: keep the PK_BAREMETAL_SCHEDSTAT flag for the per-task stats
+        m_schedstat_per_cpu_available = false;
+        CMonitorLogger::instance()->LogError(
+            "Could not read the scheduler statistics file '%s'. Per-CPU runqueue latency will not be collected.\n",
+            m_schedstat.get_file().c_str());
+    }
+
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPUPOWER)
+        init_cpupower();
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_PRESSURE) && !m_pCfg->m_strPressureTrigger.empty())
+        init_pressure_triggers();
+
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETWORK) {
+        if (!m_netlink_stats.open())
+            CMonitorLogger::instance()->LogDebug(
+                "Failed to open a rtnetlink socket; network stats will be read from /proc/net/dev\n");
+        if (!m_netlink_links.open())
+            CMonitorLogger::instance()->LogDebug(
+                "Failed to subscribe to rtnetlink link notifications; network interfaces created after startup "
+                "will not be monitored\n");
+    }
 
 #ifdef PROMETHEUS_SUPPORT
     if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPU) == 0)) {
@@ -55,6 +99,9 @@ void CMonitorSystem::init()
             size_t size = sizeof(g_prometheus_kpi_proc_vmstat) / sizeof(g_prometheus_kpi_proc_vmstat[0]);
             m_pOutput->init_prometheus_kpis(g_prometheus_kpi_proc_vmstat, size);
         }
+
+        size = sizeof(g_prometheus_kpi_proc_vmstat_rates) / sizeof(g_prometheus_kpi_proc_vmstat_rates[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_proc_vmstat_rates, size);
     }
 
     if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETWORK) == 0)) {
@@ -62,6 +109,41 @@ void CMonitorSystem::init()
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_network, size);
     }
 
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETSTAT) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_netstat) / sizeof(g_prometheus_kpi_netstat[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_netstat, size);
+    }
+
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_SOFTNET) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_softnet) / sizeof(g_prometheus_kpi_softnet[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_softnet, size);
+    }
+
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_INTERRUPTS) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_interrupts) / sizeof(g_prometheus_kpi_interrupts[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_interrupts, size);
+    }
+
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_SCHEDSTAT) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_schedstat) / sizeof(g_prometheus_kpi_schedstat[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_schedstat, size);
+    }
+
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPUPOWER) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_cpupower) / sizeof(g_prometheus_kpi_cpupower[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cpupower, size);
+    }
+
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_FRAGMENTATION) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_fragmentation) / sizeof(g_prometheus_kpi_fragmentation[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_fragmentation, size);
+    }
+
+    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_PRESSURE) == 0)) {
+        size_t size = sizeof(g_prometheus_kpi_pressure) / sizeof(g_prometheus_kpi_pressure[0]);
+        m_pOutput->init_prometheus_kpis(g_prometheus_kpi_pressure, size);
+    }
+
     if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_LOAD) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_load) / sizeof(g_prometheus_kpi_load[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_load, size);
@@ -206,4 +288,34 @@ void CMonitorSystem::get_list_monitored_files(std::set<std::string>& list)
     }
     if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_DISK)
         list.insert(m_disk_stat.get_file());
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETSTAT) {
+        for (unsigned int i = 0; i < NETSTAT_FILE_MAX; i++)
+            list.insert(m_netstat.files[i].get_file());
+    }
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_SOFTNET) {
+        list.insert(m_softnet_stat.get_file());
+        list.insert(m_softirqs.get_file());
+    }
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_INTERRUPTS)
+        list.insert(m_interrupts.get_file());
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_SCHEDSTAT) && m_schedstat_per_cpu_available)
+        list.insert(m_schedstat.get_file());
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_PRESSURE) {
+        for (unsigned int i = 0; i < PSI_MAX; i++)
+            list.insert(m_pressure[i].reader.get_file());
+    }
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_FRAGMENTATION) {
+        list.insert(m_buddyinfo.get_file());
+        list.insert(m_zoneinfo.get_file());
+    }
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPUPOWER) {
+        for (const auto& c : m_cpupower_cpus) {
+            if (c.has_freq)
+                list.insert(c.cur_freq_reader.get_file());
+            for (const auto& state : c.states) {
+                list.insert(state.time_reader.get_file());
+                list.insert(state.usage_reader.get_file());
+            }
+        }
+    }
 }
@@ -25,7 +25,12 @@
 
 #include "cmonitor.h"
 #include "fast_file_reader.h"
+#include "ethtool_reader.h"
+#include "netlink_reader.h"
+#include "utils_string.h"
+#include <deque>
 #include <map>
+#include <poll.h>
 #include <set>
 #include <string.h>
 #include <string>
@@ -68,6 +73,14 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_disk[] = {
     { "disks_backlog", prometheus::MetricType::Gauge, "weighted time spent doing I/Os (ms)" },
     { "disks_xfers", prometheus::MetricType::Gauge, "total reads/writes in Kbyte" },
     { "disks_bsize", prometheus::MetricType::Gauge, "total I/Os in Kbyte" },
+    { "disks_ravg_msec", prometheus::MetricType::Gauge, "average time spent for each read (ms)" },
+    { "disks_wavg_msec", prometheus::MetricType::Gauge, "average time spent for each write (ms)" },
+    { "disks_discards", prometheus::MetricType::Gauge, "total discards completed successfully" },
+    { "disks_dmerge", prometheus::MetricType::Gauge, "total discards merged" },
+    { "disks_dkb", prometheus::MetricType::Gauge, "total Kbytes discarded" },
+    { "disks_dmsec", prometheus::MetricType::Gauge, "total time spent discarding (ms)" },
+    { "disks_flushes", prometheus::MetricType::Gauge, "total flush requests completed successfully" },
+    { "disks_fmsec", prometheus::MetricType::Gauge, "total time spent flushing (ms)" },
 };
 
 static const prometheus_kpi_descriptor g_prometheus_kpi_network[] = {
@@ -95,6 +108,143 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_network[] = {
         "number of carrier losses detected by the device driver" },
 };
 
+static const prometheus_kpi_descriptor g_prometheus_kpi_softnet[] = {
+    // baremetal : softnet
+    { "softnet_processed", prometheus::MetricType::Gauge, "packets processed per second by the CPU backlog/NAPI" },
+    { "softnet_dropped", prometheus::MetricType::Gauge, "packets dropped per second because the backlog was full" },
+    { "softnet_time_squeeze", prometheus::MetricType::Gauge,
+        "times per second net_rx_action() ran out of budget or time with work remaining" },
+    { "softnet_received_rps", prometheus::MetricType::Gauge, "RPS inter-processor interrupts received per second" },
+    { "softnet_net_rx_softirqs", prometheus::MetricType::Gauge, "NET_RX softirqs executed per second" },
+    { "softnet_net_tx_softirqs", prometheus::MetricType::Gauge, "NET_TX softirqs executed per second" },
+    { "softnet_processed_max_cpu", prometheus::MetricType::Gauge, "index of the CPU processing most packets" },
+    { "softnet_processed_imbalance", prometheus::MetricType::Gauge,
+        "ratio between packets processed by the busiest CPU and the average among CPUs (1 = perfectly balanced)" },
+    { "softnet_net_rx_softirqs_imbalance", prometheus::MetricType::Gauge,
+        "ratio between NET_RX softirqs of the busiest CPU and the average among CPUs (1 = perfectly balanced)" },
+};
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_interrupts[] = {
+    // baremetal : interrupts
+    // NOTE: the per-CPU rates of each IRQ ("cpuN" measurements) are emitted only in the JSON output; Prometheus
+    //       gets the "total" rate of each IRQ (labelled with the IRQ name) and the summary
+    { "interrupts_total", prometheus::MetricType::Gauge, "interrupts per second summed over all monitored CPUs" },
+    { "interrupts_num_irqs_above_threshold", prometheus::MetricType::Gauge,
+        "number of IRQs whose rate is above the configured threshold" },
+};
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_schedstat[] = {
+    // baremetal : schedstat
+    { "schedstat_run_pct", prometheus::MetricType::Gauge, "percentage of time the CPU spent running tasks" },
+    { "schedstat_wait_pct", prometheus::MetricType::Gauge,
+        "time spent by tasks waiting on the CPU runqueue, as percentage of the elapsed time (can exceed 100%)" },
+    { "schedstat_timeslices", prometheus::MetricType::Gauge, "timeslices run on the CPU per second" },
+    { "schedstat_avg_wait_usec", prometheus::MetricType::Gauge, "average runqueue delay for each timeslice" },
+    { "schedstat_max_avg_wait_usec", prometheus::MetricType::Gauge,
+        "highest average runqueue delay among all monitored CPUs" },
+    { "schedstat_max_avg_wait_cpu", prometheus::MetricType::Gauge, "CPU having the highest average runqueue delay" },
+};
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_cpupower[] = {
+    // baremetal : cpupower
+    // NOTE: the KPIs for the residency of each idle state are registered at runtime, see init_cpupower()
+    { "cpupower_freq_mhz", prometheus::MetricType::Gauge, "current (or average) CPU frequency" },
+    { "cpupower_min_freq_mhz", prometheus::MetricType::Gauge, "lowest current frequency among the CPUs" },
+    { "cpupower_max_freq_mhz", prometheus::MetricType::Gauge, "highest current frequency among the CPUs" },
+};
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_fragmentation[] = {
+    // baremetal : fragmentation
+    { "fragmentation_free_pages", prometheus::MetricType::Gauge, "free pages in the zone" },
+    { "fragmentation_largest_free_order", prometheus::MetricType::Gauge,
+        "order of the largest free block in the zone (-1 if there are no free pages)" },
+    { "fragmentation_unusable_index_order3", prometheus::MetricType::Gauge,
+        "fraction of the free memory that cannot satisfy allocations of order 3 (costly order)" },
+    { "fragmentation_unusable_index_order9", prometheus::MetricType::Gauge,
+        "fraction of the free memory that cannot satisfy allocations of order 9 (transparent huge pages on x86)" },
+    { "fragmentation_min_wmark_pages", prometheus::MetricType::Gauge, "min watermark of the zone" },
+    { "fragmentation_low_wmark_pages", prometheus::MetricType::Gauge,
+        "low watermark of the zone: below this kswapd gets woken up" },
+    { "fragmentation_high_wmark_pages", prometheus::MetricType::Gauge, "high watermark of the zone" },
+    { "fragmentation_low_wmark_distance_pages", prometheus::MetricType::Gauge,
+        "free pages minus the low watermark: when negative, allocations are slowed down by reclaim" },
+};
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_pressure[] = {
+    // baremetal : pressure
+    { "pressure_some_avg10", prometheus::MetricType::Gauge,
+        "percentage of time at least one task was stalled on the resource, averaged over 10secs" },
+    { "pressure_some_avg60", prometheus::MetricType::Gauge,
+        "percentage of time at least one task was stalled on the resource, averaged over 60secs" },
+    { "pressure_some_avg300", prometheus::MetricType::Gauge,
+        "percentage of time at least one task was stalled on the resource, averaged over 300secs" },
+    { "pressure_some_stall_pct", prometheus::MetricType::Gauge,
+        "percentage of time at least one task was stalled on the resource since the previous sample" },
+    { "pressure_full_avg10", prometheus::MetricType::Gauge,
+        "percentage of time all non-idle tasks were stalled on the resource, averaged over 10secs" },
+    { "pressure_full_avg60", prometheus::MetricType::Gauge,
+        "percentage of time all non-idle tasks were stalled on the resource, averaged over 60secs" },
+    { "pressure_full_avg300", prometheus::MetricType::Gauge,
+        "percentage of time all non-idle tasks were stalled on the resource, averaged over 300secs" },
+    { "pressure_full_stall_pct", prometheus::MetricType::Gauge,
+        "percentage of time all non-idle tasks were stalled on the resource since the previous sample" },
+    { "pressure_triggered", prometheus::MetricType::Gauge,
+        "1 if the PSI trigger registered on the resource fired since the previous sample" },
+};
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_netstat[] = {
+    // baremetal : protocol stats from /proc/net/snmp and /proc/net/netstat
+    { "proc_net_snmp_tcp_active_opens", prometheus::MetricType::Gauge, "TCP connections opened actively per second" },
+    { "proc_net_snmp_tcp_passive_opens", prometheus::MetricType::Gauge,
+        "TCP connections opened passively (accepted) per second" },
+    { "proc_net_snmp_tcp_attempt_fails", prometheus::MetricType::Gauge, "TCP connection attempts failed per second" },
+    { "proc_net_snmp_tcp_estab_resets", prometheus::MetricType::Gauge,
+        "TCP connections reset from ESTABLISHED or CLOSE_WAIT state per second" },
+    { "proc_net_snmp_tcp_in_segs", prometheus::MetricType::Gauge, "TCP segments received per second" },
+    { "proc_net_snmp_tcp_out_segs", prometheus::MetricType::Gauge, "TCP segments sent per second" },
+    { "proc_net_snmp_tcp_retrans_segs", prometheus::MetricType::Gauge, "TCP segments retransmitted per second" },
+    { "proc_net_snmp_tcp_in_errs", prometheus::MetricType::Gauge, "TCP segments received with errors per second" },
+    { "proc_net_snmp_tcp_out_rsts", prometheus::MetricType::Gauge, "TCP segments sent with the RST flag per second" },
+    { "proc_net_snmp_udp_in_datagrams", prometheus::MetricType::Gauge,
+        "UDP datagrams delivered to sockets per second" },
+    { "proc_net_snmp_udp_out_datagrams", prometheus::MetricType::Gauge, "UDP datagrams sent per second" },
+    { "proc_net_snmp_udp_no_ports", prometheus::MetricType::Gauge,
+        "UDP datagrams received for a port without listener per second" },
+    { "proc_net_snmp_udp_in_errors", prometheus::MetricType::Gauge,
+        "UDP datagrams that could not be delivered per second" },
+    { "proc_net_snmp_udp_rcvbuf_errors", prometheus::MetricType::Gauge,
+        "UDP datagrams dropped because the socket receive buffer was full per second" },
+    { "proc_net_snmp_udp_sndbuf_errors", prometheus::MetricType::Gauge,
+        "UDP datagrams dropped because the socket send buffer was full per second" },
+    { "proc_net_snmp_tcp_listen_overflows", prometheus::MetricType::Gauge,
+        "TCP connections dropped because the accept queue of a listening socket was full per second" },
+    { "proc_net_snmp_tcp_listen_drops", prometheus::MetricType::Gauge,
+        "TCP SYNs dropped by listening sockets for any reason per second" },
+    { "proc_net_snmp_tcp_timeouts", prometheus::MetricType::Gauge, "TCP retransmission timeouts per second" },
+    { "proc_net_snmp_tcp_syn_retrans", prometheus::MetricType::Gauge,
+        "TCP SYN and SYN/ACK retransmissions per second" },
+    { "proc_net_snmp_tcp_fast_retrans", prometheus::MetricType::Gauge, "TCP fast retransmissions per second" },
+    { "proc_net_snmp_tcp_lost_retransmit", prometheus::MetricType::Gauge,
+        "TCP retransmitted segments lost again per second" },
+    { "proc_net_snmp_tcp_backlog_drop", prometheus::MetricType::Gauge,
+        "TCP segments dropped because the socket backlog was full per second" },
+    { "proc_net_snmp_tcp_abort_on_data", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of unexpected data per second" },
+    { "proc_net_snmp_tcp_abort_on_close", prometheus::MetricType::Gauge,
+        "TCP connections aborted on close with unread data per second" },
+    { "proc_net_snmp_tcp_abort_on_memory", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of memory pressure per second" },
+    { "proc_net_snmp_tcp_abort_on_timeout", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of too many retransmissions per second" },
+    { "proc_net_snmp_tcp_abort_on_linger", prometheus::MetricType::Gauge,
+        "TCP connections aborted because of the SO_LINGER timeout per second" },
+    { "proc_net_snmp_tcp_abort_failed", prometheus::MetricType::Gauge,
+        "TCP aborts that failed to send a RST per second" },
+    { "proc_net_snmp_tcp_aborts", prometheus::MetricType::Gauge, "TCP connections aborted for any reason per second" },
+    { "proc_net_snmp_tcp_retrans_pct", prometheus::MetricType::Gauge,
+        "percentage of sent TCP segments that were retransmissions" },
+};
+
 static const prometheus_kpi_descriptor g_prometheus_kpi_cpu[] = {
     // baremetal : cpu
     { "stat_user", prometheus::MetricType::Gauge, "time spent in user mode" },
@@ -343,10 +493,33 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_proc_vmstat[] = {
     { "proc_vmstat_workingset_refault", prometheus::MetricType::Counter, "proc_vmstat_workingset_refault" },
     { "proc_vmstat_zone_reclaim_failed", prometheus::MetricType::Counter, "proc_vmstat_zone_reclaim_failed" },
 };
+
+static const prometheus_kpi_descriptor g_prometheus_kpi_proc_vmstat_rates[] = {
+    // baremetal: proc_vmstat_rates
+    { "proc_vmstat_rates_pgscan_kswapd", prometheus::MetricType::Gauge, "pages scanned by kswapd per second" },
+    { "proc_vmstat_rates_pgscan_direct", prometheus::MetricType::Gauge, "pages scanned by direct reclaim per second" },
+    { "proc_vmstat_rates_pgsteal_kswapd", prometheus::MetricType::Gauge, "pages reclaimed by kswapd per second" },
+    { "proc_vmstat_rates_pgsteal_direct", prometheus::MetricType::Gauge,
+        "pages reclaimed by direct reclaim per second" },
+    { "proc_vmstat_rates_compact_stall", prometheus::MetricType::Gauge, "direct compaction stalls per second" },
+    { "proc_vmstat_rates_thp_fault_fallback", prometheus::MetricType::Gauge,
+        "page faults per second that fell back to small pages after failing to allocate a huge page" },
+    { "proc_vmstat_rates_pswpin", prometheus::MetricType::Gauge, "pages swapped in per second" },
+    { "proc_vmstat_rates_pswpout", prometheus::MetricType::Gauge, "pages swapped out per second" },
+    { "proc_vmstat_rates_workingset_refault", prometheus::MetricType::Gauge,
+        "refaults per second of previously evicted pages" },
+    { "proc_vmstat_rates_oom_kill", prometheus::MetricType::Gauge, "processes killed by the OOM killer per second" },
+    { "proc_vmstat_rates_direct_scan_pct", prometheus::MetricType::Gauge,
+        "percentage of the scanned pages that were scanned by direct reclaim instead of kswapd" },
+    { "proc_vmstat_rates_reclaim_efficiency_pct", prometheus::MetricType::Gauge,
+        "percentage of the scanned pages that were actually reclaimed" },
+};
 #endif
 
 typedef std::map<std::string /* interface name */, std::string /* address */> netdevices_map_t;
 
+#define NET_DEV_NUM_COUNTERS (16) // number of counters for each interface in /proc/net/dev
+
 typedef struct {
     uint64_t if_ibytes;
     uint64_t if_ipackets;
@@ -388,6 +561,203 @@ typedef struct cpu_specs_s {
 
 #define MAX_LOGICAL_CPU (256)
 
+/*
+ * Structure to store per-CPU network packet processing counters as reported in
+ * /proc/net/softnet_stat and in the NET_RX/NET_TX rows of /proc/softirqs
+ */
+typedef struct softnet_cpu_stats_s {
+    bool valid; // true if this CPU has been found in last sample
+    uint64_t processed; // packets processed by the backlog/NAPI poll
+    uint64_t dropped; // packets dropped because the backlog queue was full
+    uint64_t time_squeeze; // net_rx_action() exits with work remaining
+    uint64_t received_rps; // RPS inter-processor interrupts received
+    uint64_t net_rx_softirqs;
+    uint64_t net_tx_softirqs;
+} softnet_cpu_stats_t;
+
+/*
+ * Structure to store per-CPU scheduler stats as reported in /proc/schedstat
+ */
+typedef struct schedstat_cpu_s {
+    bool valid; // true if this CPU has been found in last sample
+    uint64_t run_ns; // time spent running tasks on this CPU
+    uint64_t wait_ns; // time spent by tasks waiting on the runqueue of this CPU
+    uint64_t timeslices; // number of timeslices run on this CPU
+} schedstat_cpu_t;
+
+/*
+ * Structures to store the readers of the per-CPU cpufreq/cpuidle files in /sys/devices/system/cpu
+ */
+#define MAX_CPUIDLE_STATES (16)
+
+typedef struct cpuidle_state_s {
+    std::string name; // lowercase name of the idle state, e.g. "c1e"
+    std::string residency_kpi_name; // e.g. "c1e_pct"
+    std::string usage_kpi_name; // e.g. "c1e_usage"
+    FastFileReader time_reader; // total time spent in this idle state, in usecs
+    FastFileReader usage_reader; // number of times this idle state was entered
+    uint64_t prev_time_us = 0;
+    uint64_t prev_usage = 0;
+    bool valid = false; // true if prev_* members have been sampled
+} cpuidle_state_t;
+
+typedef struct cpupower_cpu_s {
+    unsigned int cpu = 0;
+    int numa_node = -1; // -1 if the NUMA node is unknown
+    FastFileReader cur_freq_reader; // current frequency, in kHz
+    bool has_freq = false; // false if the cpufreq subsystem is not available for this CPU
+    std::deque<cpuidle_state_t> states;
+} cpupower_cpu_t;
+
+typedef struct cpupower_aggregate_s {
+    unsigned int num_cpus;
+    unsigned int num_cpus_with_freq;
+    double freq_mhz; // sum over all CPUs with cpufreq
+    double min_freq_mhz;
+    double max_freq_mhz;
+    double residency_pct[MAX_CPUIDLE_STATES]; // sum over all CPUs, for each idle state
+} cpupower_aggregate_t;
+
+/*
+ * Counters of /proc/vmstat that get sampled; see g_vmstat_counters in system_memory.cpp
+ */
+enum VmstatCounter {
+    VMSTAT_PGSCAN_KSWAPD,
+    VMSTAT_PGSCAN_DIRECT,
+    VMSTAT_PGSTEAL_KSWAPD,
+    VMSTAT_PGSTEAL_DIRECT,
+    VMSTAT_COMPACT_STALL,
+    VMSTAT_THP_FAULT_FALLBACK,
+    VMSTAT_PSWPIN,
+    VMSTAT_PSWPOUT,
+    VMSTAT_WORKINGSET_REFAULT,
+    VMSTAT_OOM_KILL,
+
+    VMSTAT_MAX
+};
+
+/*
+ * Counters of /proc/net/snmp and /proc/net/netstat that get sampled; see g_netstat_counters in system_netstat.cpp
+ */
+enum NetstatCounter {
+    NETSTAT_TCP_ACTIVE_OPENS,
+    NETSTAT_TCP_PASSIVE_OPENS,
+    NETSTAT_TCP_ATTEMPT_FAILS,
+    NETSTAT_TCP_ESTAB_RESETS,
+    NETSTAT_TCP_IN_SEGS,
+    NETSTAT_TCP_OUT_SEGS,
+    NETSTAT_TCP_RETRANS_SEGS,
+    NETSTAT_TCP_IN_ERRS,
+    NETSTAT_TCP_OUT_RSTS,
+    NETSTAT_UDP_IN_DATAGRAMS,
+    NETSTAT_UDP_OUT_DATAGRAMS,
+    NETSTAT_UDP_NO_PORTS,
+    NETSTAT_UDP_IN_ERRORS,
+    NETSTAT_UDP_RCVBUF_ERRORS,
+    NETSTAT_UDP_SNDBUF_ERRORS,
+    NETSTAT_TCP_LISTEN_OVERFLOWS,
+    NETSTAT_TCP_LISTEN_DROPS,
+    NETSTAT_TCP_TIMEOUTS,
+    NETSTAT_TCP_SYN_RETRANS,
+    NETSTAT_TCP_FAST_RETRANS,
+    NETSTAT_TCP_LOST_RETRANSMIT,
+    NETSTAT_TCP_BACKLOG_DROP,
+    NETSTAT_TCP_ABORT_ON_DATA,
+    NETSTAT_TCP_ABORT_ON_CLOSE,
+    NETSTAT_TCP_ABORT_ON_MEMORY,
+    NETSTAT_TCP_ABORT_ON_TIMEOUT,
+    NETSTAT_TCP_ABORT_ON_LINGER,
+    NETSTAT_TCP_ABORT_FAILED,
+
+    NETSTAT_MAX
+};
+
+enum NetstatFile {
+    NETSTAT_FILE_SNMP, // /proc/net/snmp
+    NETSTAT_FILE_NETSTAT, // /proc/net/netstat
+
+    NETSTAT_FILE_MAX
+};
+
+/*
+ * Both /proc/net/snmp and /proc/net/netstat are made of pairs of lines like:
+ *     Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens ...
+ *     Tcp: 1 200 120000 -1 34 ...
+ * Each group stores the columns of the value line that must be parsed, resolved once from the header line.
+ */
+typedef struct {
+    std::string prefix; // e.g. "Tcp:"
+    std::vector<std::pair<unsigned int /* column */, NetstatCounter>> columns; // sorted by column
+} netstat_group_t;
+
+/*
+ * Readers of /proc/net/snmp and /proc/net/netstat of a network namespace, used by both the system and the
+ * cgroup collectors
+ */
+typedef struct {
+    FastFileReader files[NETSTAT_FILE_MAX];
+    bool resolved = false; // true once the columns of the "groups" have been resolved
+    std::vector<netstat_group_t> groups[NETSTAT_FILE_MAX];
+    uint64_t prev_values[NETSTAT_MAX];
+    bool prev_valid = false;
+} netstat_readers_t;
+
+/*
+ * Structure to store the free memory of each zone as reported in /proc/buddyinfo and /proc/zoneinfo
+ */
+#define MAX_BUDDY_ORDERS (16)
+#define ZONE_NAME_MAXLEN (16)
+
+typedef struct zone_frag_info_s {
+    unsigned int node;
+    char zone[ZONE_NAME_MAXLEN]; // e.g. "Normal"
+    unsigned int num_orders;
+    uint64_t free_blocks[MAX_BUDDY_ORDERS]; // number of free blocks of 2^order pages
+    bool has_watermarks; // true if the zone has been found in /proc/zoneinfo
+    uint64_t free_pages;
+    uint64_t min_wmark_pages;
+    uint64_t low_wmark_pages;
+    uint64_t high_wmark_pages;
+} zone_frag_info_t;
+
+/*
+ * Structure to store the Pressure Stall Information of a resource as reported in /proc/pressure
+ */
+enum PressureResource {
+    PSI_CPU,
+    PSI_MEMORY,
+    PSI_IO,
+
+    PSI_MAX
+};
+
+enum PressureLine {
+    PSI_SOME, // some tasks were stalled
+    PSI_FULL, // all non-idle tasks were stalled
+
+    PSI_LINE_MAX
+};
+
+typedef struct pressure_stats_s {
+    bool valid = false;
+    double avg[3] = {}; // avg10, avg60, avg300 percentages computed by the kernel
+    uint64_t total_us = 0; // cumulative stall time
+} pressure_stats_t;
+
+typedef struct pressure_resource_s {
+    FastFileReader reader;
+    int trigger_fd = -1; // file descriptor of the PSI trigger registered on this resource, if any
+    bool triggered = false; // true if the PSI trigger fired since the last sample
+    pressure_stats_t prev_values[PSI_LINE_MAX];
+} pressure_resource_t;
+
+#define IRQ_LABEL_MAXLEN (16)
+
+typedef struct irq_row_s {
+    bool valid;
+    char label[IRQ_LABEL_MAXLEN]; // e.g. "125" or "LOC"
+} irq_row_t;
+
 // please refer https://www.kernel.org/doc/Documentation/iostats.txt
 
 typedef struct {
@@ -413,9 +783,20 @@ typedef struct {
                        // percentage]
     long long dk_backlog; // Field 11: weighted # of milliseconds spent doing I/Os
 
+    // discards (kernel 4.18+)
+    long long dk_discards; // Field 12: This is the total number of discards completed successfully.
+    long long dk_dmerge; // Field 13: Same as Field 2 but for discards
+    long long dk_dkb; // Field 14: Same as Field 3 but for discards [converted by us from sectors]
+    long long dk_dmsec; // Field 15: This is the total number of milliseconds spent by all discards
+
+    // flushes (kernel 5.5+)
+    long long dk_flushes; // Field 16: This is the total number of flush requests completed successfully.
+    long long dk_fmsec; // Field 17: This is the total number of milliseconds spent by all flush requests
+
     // computed by ourselves:
     long long dk_xfers; // sum of number of read/write operations
     long long dk_bsize;
+    unsigned int dk_num_fields; // number of fields found in /proc/diskstats, depends on the kernel version
 } diskinfo_t;
 
 typedef std::map<std::string /* disk name */, diskinfo_t> diskinfo_map_t;
@@ -431,11 +812,18 @@ public:
     {
         memset(&m_cpu_stat_prev_values[0], 0, MAX_LOGICAL_CPU * sizeof(cpu_specs_t));
     }
+    ~CMonitorSystem();
 
     void init();
     void set_monitored_cpus(const std::set<uint64_t>& cpus) { m_monitored_cpus = cpus; }
     void get_list_monitored_files(std::set<std::string>& list);
 
+    // PSI triggers allow to take out-of-schedule samples: the caller polls the trigger file descriptors
+    // (possibly together with other ones) and then checks if any trigger fired
+    bool has_pressure_triggers() const { return m_pressure_triggers_active; }
+    unsigned int get_pressure_trigger_pollfds(struct pollfd* fds); // fills at most PSI_MAX entries
+    bool check_pressure_trigger_pollfds(const struct pollfd* fds, unsigned int nfds); // true if a trigger fired
+
     //------------------------------------------------------------------------------
     // Functions to collect /proc stats (baremetal), invoked by main app
     //------------------------------------------------------------------------------
@@ -444,8 +832,16 @@ public:
     void sample_uptime();
     void sample_cpu_stat(double elapsed, OutputFields output_opts);
     void sample_memory(const std::set<std::string>& allowedStatsNames);
+    void sample_vmstat(double elapsed, OutputFields output_opts);
     void sample_net_dev(double elapsed, OutputFields output_opts);
     void sample_diskstats(double elapsed, OutputFields output_opts);
+    void sample_softnet_stats(double elapsed, OutputFields output_opts);
+    void sample_interrupts(double elapsed, OutputFields output_opts);
+    void sample_schedstat(double elapsed, OutputFields output_opts);
+    void sample_cpupower(double elapsed, OutputFields output_opts);
+    void sample_fragmentation(OutputFields output_opts);
+    void sample_pressure(double elapsed, OutputFields output_opts);
+    void sample_netstat(double elapsed, OutputFields output_opts);
     void sample_filesystems();
 
     //------------------------------------------------------------------------------
@@ -456,9 +852,22 @@ public:
 
     static bool get_net_dev_list(netdevices_map_t& out_map, bool include_only_interfaces_up);
     static bool read_net_dev_stats(
-        const std::string& filename, const std::set<std::string>& net_iface_whitelist, netinfo_map_t& out_infos);
+        FastFileReader& reader, const std::set<std::string>& net_iface_whitelist, netinfo_map_t& out_infos);
+    static bool read_net_dev_stats(NetlinkStatsReader& netlink_reader, FastFileReader& fallback_reader,
+        const std::set<std::string>& net_iface_whitelist, netinfo_map_t& out_infos);
     static bool output_net_dev_stats(CMonitorOutputFrontend* pOutput, double elapsed_sec,
-        const netinfo_map_t& new_stats, const netinfo_map_t& prev_stats, OutputFields output_opts);
+        const netinfo_map_t& new_stats, const netinfo_map_t& prev_stats, OutputFields output_opts,
+        const ethtool_readers_map_t* ethtool_stats = nullptr);
+
+    static void init_netstat_readers(
+        netstat_readers_t& readers, const std::string& proc_net_path, bool reopen_each_time);
+    static bool read_netstat_stats(netstat_readers_t& readers, uint64_t* out_values /* NETSTAT_MAX entries */);
+    static void output_netstat_stats(CMonitorOutputFrontend* pOutput, double elapsed_sec, const uint64_t* new_values,
+        const uint64_t* prev_values, OutputFields output_opts);
+
+    static bool read_pressure_stats(FastFileReader& reader, pressure_stats_t* out_stats /* PSI_LINE_MAX entries */);
+    static void output_pressure_stats(CMonitorOutputFrontend* pOutput, double elapsed_sec,
+        const pressure_stats_t* new_stats, const pressure_stats_t* prev_stats, OutputFields output_opts);
 
     //------------------------------------------------------------------------------
     // Utilities shared with CMonitorHeaderInfo
@@ -479,6 +888,16 @@ private:
         return m_monitored_cpus.find(cpu) != m_monitored_cpus.end();
     }
 
+    bool is_monitored_disk(const string_field_t& disk_name) const;
+    void update_monitored_net_devs();
+    void read_ethtool_stats();
+    bool read_softnet_stats(softnet_cpu_stats_t* new_values);
+    void init_cpupower();
+    bool read_buddyinfo();
+    bool read_zoneinfo();
+    void init_pressure_triggers();
+    static bool resolve_netstat_columns(FastFileReader& reader, NetstatFile file, std::vector<netstat_group_t>& groups);
+
     int proc_stat_cpu_index(const char* cpu_data, cpu_specs_t* cpu_values_out);
     // void proc_stat_cpu_total(const char* cpu_data, double elapsed_sec, OutputFields output_opts, cpu_specs_t&
     // total_cpu,
@@ -500,15 +919,55 @@ private:
     // memory stats
     FastFileReader m_meminfo;
     FastFileReader m_vmstat;
+    uint64_t m_vmstat_prev_values[VMSTAT_MAX] = {};
+    bool m_vmstat_prev_valid = false;
 
     // disk stats
     FastFileReader m_disk_stat;
-    std::set<std::string> m_disks;
     diskinfo_map_t m_previous_diskinfo;
 
     // network stats
+    bool m_network_interfaces_scanned = false;
     std::set<std::string> m_network_interfaces_up;
     netinfo_map_t m_previous_netinfo;
+    NetlinkStatsReader m_netlink_stats;
+    FastFileReader m_net_dev; // used only if m_netlink_stats cannot be opened
+    NetlinkLinkMonitor m_netlink_links; // tracks creation/removal/renaming of network interfaces
+    ethtool_readers_map_t m_ethtool_readers; // includes also invalid readers for interfaces not supporting ethtool
+
+    // protocol stats
+    netstat_readers_t m_netstat;
+
+    // softnet stats
+    FastFileReader m_softnet_stat;
+    FastFileReader m_softirqs;
+    softnet_cpu_stats_t m_softnet_prev_values[MAX_LOGICAL_CPU] = {};
+
+    // interrupts stats
+    FastFileReader m_interrupts;
+    std::vector<irq_row_t> m_irq_rows; // one entry for each line of /proc/interrupts
+    std::vector<uint64_t> m_irq_prev_counters; // flat matrix of (IRQ line) x (column) counters
+    size_t m_irq_num_columns = 0;
+    unsigned int m_irq_column2cpu[MAX_LOGICAL_CPU] = {};
+
+    // scheduler stats
+    FastFileReader m_schedstat;
+    bool m_schedstat_per_cpu_available = true;
+    schedstat_cpu_t m_schedstat_prev_values[MAX_LOGICAL_CPU] = {};
+
+    // CPU frequency and idle states
+    std::deque<cpupower_cpu_t> m_cpupower_cpus; // one entry for each monitored CPU
+    std::vector<cpupower_aggregate_t> m_cpupower_nodes; // one entry for each NUMA node
+
+    // memory fragmentation
+    FastFileReader m_buddyinfo;
+    FastFileReader m_zoneinfo;
+    std::vector<zone_frag_info_t> m_zones; // one entry for each populated zone of each NUMA node
+    uint64_t m_fragmentation_sample_counter = 0;
+
+    // pressure stall information
+    pressure_resource_t m_pressure[PSI_MAX];
+    bool m_pressure_triggers_active = false;
 
     // uptime
     FastFileReader m_uptime;
@@ -20,6 +20,7 @@
 #include "logger.h"
 #include "output_frontend.h"
 #include "system.h"
+#include "utils_string.h"
 #include <assert.h>
 
 // ----------------------------------------------------------------------------------
@@ -220,6 +221,118 @@ void CMonitorSystem::sample_cpu_stat(double elapsed_sec, OutputFields output_opt
         m_cpu_stat_prev_values[i] = new_values[i];
 }
 
+/*
+read /proc/schedstat
+*/
+void CMonitorSystem::sample_schedstat(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_SCHEDSTAT) == 0 || !m_schedstat_per_cpu_available)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // clang-format off
+    /*
+        the file has a format like (see https://www.kernel.org/doc/html/latest/scheduler/sched-stats.html):
+
+            version 15
+            timestamp 4297299139
+            cpu0 0 0 0 0 0 0 1145467466452 233962113212 2362834
+            domain0 00000003 4342 4340 2 4 0 0 0 4340 ...
+            cpu1 0 0 0 0 0 0 1198364328452 251278462386 2293744
+            domain0 00000003 ...
+
+        the last 3 fields of each "cpuN" line are:
+            - sum of all time spent running by tasks on this processor (in nanoseconds)
+            - sum of all time spent waiting to run by tasks on this processor (in nanoseconds)
+            - # of timeslices run on this cpu
+    */
+    // clang-format on
+
+    if (!m_schedstat.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_schedstat.get_file().c_str());
+        return;
+    }
+
+    schedstat_cpu_t new_values[MAX_LOGICAL_CPU] = {};
+    string_field_t fields[16];
+    for (const char* line = m_schedstat.get_next_line(); line; line = m_schedstat.get_next_line()) {
+        if (strncmp(line, "cpu", 3) != 0)
+            continue; // skip the version, timestamp and domain lines
+
+        size_t nfields = split_fields_on_whitespace(line, fields, 16);
+        if (nfields < 4)
+            continue;
+
+        unsigned long cpuno = strtoul(&line[3], NULL, 10);
+        if (cpuno >= MAX_LOGICAL_CPU)
+            continue;
+
+        schedstat_cpu_t& current = new_values[cpuno];
+        current.valid = string_field2int(fields[nfields - 3], current.run_ns)
+            && string_field2int(fields[nfields - 2], current.wait_ns)
+            && string_field2int(fields[nfields - 1], current.timeslices);
+    }
+
+    if (output_opts != PF_NONE) {
+        double total_avg_wait = 0, max_avg_wait = 0;
+        int max_avg_wait_cpu = -1;
+        unsigned int num_cpus = 0;
+
+        m_pOutput->psection_start("schedstat");
+        for (int i = 0; i < MAX_LOGICAL_CPU; i++) {
+            const schedstat_cpu_t& current = new_values[i];
+            const schedstat_cpu_t& previous = m_schedstat_prev_values[i];
+            if (!current.valid || !previous.valid || !is_monitored_cpu(i))
+                continue;
+
+            // nanoseconds / (elapsed_sec * 1e9) * 100 gives a percentage:
+            double run_pct = (double)(current.run_ns - previous.run_ns) / elapsed_sec / 1e7;
+            double wait_pct = (double)(current.wait_ns - previous.wait_ns) / elapsed_sec / 1e7;
+            double timeslices = (double)(current.timeslices - previous.timeslices);
+            double avg_wait_usec
+                = timeslices > 0 ? (double)(current.wait_ns - previous.wait_ns) / timeslices / 1000 : 0;
+
+            m_pOutput->psubsection_start(fmt::format("cpu{:d}", i).c_str());
+            switch (output_opts) {
+            case PF_NONE:
+                assert(0);
+                break;
+            case PF_ALL:
+                m_pOutput->pdouble("run_pct", run_pct);
+                m_pOutput->pdouble("wait_pct", wait_pct);
+                m_pOutput->pdouble("timeslices", timeslices / elapsed_sec);
+                m_pOutput->pdouble("avg_wait_usec", avg_wait_usec);
+                break;
+            case PF_USED_BY_CHART_SCRIPT_ONLY:
+                m_pOutput->pdouble("wait_pct", wait_pct);
+                m_pOutput->pdouble("avg_wait_usec", avg_wait_usec);
+                break;
+            }
+            m_pOutput->psubsection_end();
+
+            total_avg_wait += avg_wait_usec;
+            if (max_avg_wait_cpu == -1 || avg_wait_usec > max_avg_wait) {
+                max_avg_wait = avg_wait_usec;
+                max_avg_wait_cpu = i;
+            }
+            num_cpus++;
+        }
+
+        if (num_cpus > 0) {
+            m_pOutput->psubsection_start("summary");
+            m_pOutput->pdouble("avg_wait_usec", total_avg_wait / num_cpus);
+            m_pOutput->pdouble("max_avg_wait_usec", max_avg_wait);
+            m_pOutput->plong("max_avg_wait_cpu", max_avg_wait_cpu);
+            m_pOutput->psubsection_end();
+        }
+        m_pOutput->psection_end();
+    }
+
+    // finally remember the last sampled stats:
+    memcpy(m_schedstat_prev_values, new_values, sizeof(m_schedstat_prev_values));
+}
+
 /* static */
 unsigned int CMonitorSystem::get_all_cpus(std::set<uint64_t>& cpu_indexes, const std::string& stat_file)
 {
@@ -0,0 +1,260 @@
+/*
+ * system_cpupower.cpp - code for collecting SYSTEM-level per-CPU frequency and idle-state statistics
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logger.h"
+#include "output_frontend.h"
+#include "system.h"
+#include "utils_files.h"
+#include "utils_string.h"
+#include <algorithm>
+#include <assert.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+/*
+    PERFORMANCE NOTE:
+    each CPU exposes one sysfs file for its current frequency plus two files for each idle state: on a server
+    with hundreds of CPUs this means thousands of tiny files to read at each sample.
+    All files are opened just once, at startup, and then re-read with a single pread() each.
+*/
+
+static bool read_sysfs_string(const std::string& filename, std::string& value)
+{
+    FastFileReader reader(filename);
+    if (!reader.open_or_rewind())
+        return false;
+    const char* line = reader.get_next_line();
+    if (!line)
+        return false;
+    value = line;
+    return true;
+}
+
+void CMonitorSystem::init_cpupower()
+{
+    std::set<uint64_t> all_cpus;
+    get_all_cpus(all_cpus);
+
+    // find out the NUMA node of each CPU:
+    int cpu2node[MAX_LOGICAL_CPU];
+    std::fill(cpu2node, cpu2node + MAX_LOGICAL_CPU, -1);
+    unsigned int num_nodes = 0;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            unsigned int node;
+            if (sscanf(entry->d_name, "node%u", &node) != 1)
+                continue;
+            std::set<uint64_t> node_cpus;
+            if (!read_integers_with_range_validation(
+                    fmt::format("/sys/devices/system/node/{}/cpulist", entry->d_name), 0, MAX_LOGICAL_CPU - 1,
+                    node_cpus))
+                continue;
+            for (auto cpu : node_cpus)
+                cpu2node[cpu] = node;
+            num_nodes = std::max(num_nodes, node + 1);
+        }
+        closedir(dir);
+    }
+
+    size_t num_files = 0;
+    for (auto cpu : all_cpus) {
+        if (cpu >= MAX_LOGICAL_CPU || !is_monitored_cpu(cpu))
+            continue;
+
+        m_cpupower_cpus.emplace_back();
+        cpupower_cpu_t& c = m_cpupower_cpus.back();
+        c.cpu = cpu;
+        c.numa_node = cpu2node[cpu];
+        c.cur_freq_reader.set_file(fmt::format("/sys/devices/system/cpu/cpu{}/cpufreq/scaling_cur_freq", cpu));
+        c.has_freq = c.cur_freq_reader.open_or_rewind(); // there is no cpufreq driver e.g. inside most VMs
+        if (c.has_freq)
+            num_files++;
+
+        for (unsigned int i = 0; i < MAX_CPUIDLE_STATES; i++) {
+            std::string state_dir = fmt::format("/sys/devices/system/cpu/cpu{}/cpuidle/state{}", cpu, i);
+            std::string name;
+            if (!read_sysfs_string(state_dir + "/name", name))
+                break; // no more idle states (or no cpuidle driver at all)
+
+            // e.g. "C1-SKX" becomes "c1_skx":
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            std::replace(name.begin(), name.end(), '-', '_');
+
+            c.states.emplace_back();
+            cpuidle_state_t& state = c.states.back();
+            state.name = name;
+            state.residency_kpi_name = name + "_pct";
+            state.usage_kpi_name = name + "_usage";
+            state.time_reader.set_file(state_dir + "/time");
+            state.usage_reader.set_file(state_dir + "/usage");
+            num_files += 2;
+        }
+
+        if (!c.has_freq && c.states.empty())
+            m_cpupower_cpus.pop_back();
+    }
+    m_cpupower_nodes.resize(num_nodes);
+
+    if (m_cpupower_cpus.empty()) {
+        m_pCfg->m_nCollectFlags &= ~PK_BAREMETAL_CPUPOWER;
+        CMonitorLogger::instance()->LogError(
+            "Could not find any cpufreq or cpuidle statistics file. Disabling monitoring of CPU frequency and idle "
+            "states.\n");
+        return;
+    }
+
+    // all files are kept open: make sure we do not hit the limit on the number of open file descriptors
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < num_files + 1024) {
+        lim.rlim_cur = std::min((rlim_t)(num_files + 1024), lim.rlim_max);
+        if (setrlimit(RLIMIT_NOFILE, &lim) != 0)
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "failed to raise the limit on open files to %lu", (unsigned long)lim.rlim_cur);
+    }
+
+    CMonitorLogger::instance()->LogDebug(
+        "Monitoring frequency and idle states of %zu CPUs over %u NUMA nodes (%zu files)\n", m_cpupower_cpus.size(),
+        num_nodes, num_files);
+
+#ifdef PROMETHEUS_SUPPORT
+    if (m_pOutput->is_prometheus_enabled() && !m_cpupower_cpus.empty()) {
+        // the idle state names are known only at runtime:
+        std::vector<prometheus_kpi_descriptor> kpis;
+        for (const auto& state : m_cpupower_cpus.front().states) {
+            kpis.push_back({ "cpupower_" + state.residency_kpi_name, prometheus::MetricType::Gauge,
+                "percentage of time spent in the " + state.name + " idle state" });
+            kpis.push_back({ "cpupower_" + state.usage_kpi_name, prometheus::MetricType::Gauge,
+                "number of times the " + state.name + " idle state was entered per second" });
+        }
+        m_pOutput->init_prometheus_kpis(kpis.data(), kpis.size());
+    }
+#endif
+}
+
+static void output_cpupower_aggregate(
+    CMonitorOutputFrontend* pOutput, const char* name, const cpupower_aggregate_t& aggr, const cpupower_cpu_t& ref)
+{
+    if (aggr.num_cpus == 0)
+        return;
+
+    pOutput->psubsection_start(name);
+    if (aggr.num_cpus_with_freq > 0) {
+        pOutput->pdouble("freq_mhz", aggr.freq_mhz / aggr.num_cpus_with_freq);
+        pOutput->pdouble("min_freq_mhz", aggr.min_freq_mhz);
+        pOutput->pdouble("max_freq_mhz", aggr.max_freq_mhz);
+    }
+    for (size_t i = 0; i < ref.states.size(); i++)
+        pOutput->pdouble(ref.states[i].residency_kpi_name.c_str(), aggr.residency_pct[i] / aggr.num_cpus);
+    pOutput->psubsection_end();
+}
+
+static void add_cpu_freq_to_aggregate(cpupower_aggregate_t& aggr, double freq_mhz)
+{
+    if (aggr.num_cpus_with_freq == 0 || freq_mhz < aggr.min_freq_mhz)
+        aggr.min_freq_mhz = freq_mhz;
+    if (aggr.num_cpus_with_freq == 0 || freq_mhz > aggr.max_freq_mhz)
+        aggr.max_freq_mhz = freq_mhz;
+    aggr.freq_mhz += freq_mhz;
+    aggr.num_cpus_with_freq++;
+}
+
+/*
+ read /sys/devices/system/cpu/cpu*\/cpufreq/scaling_cur_freq and /sys/devices/system/cpu/cpu*\/cpuidle/state*
+ */
+void CMonitorSystem::sample_cpupower(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPUPOWER) == 0 || m_cpupower_cpus.empty())
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // per-CPU values are emitted only when all fields are requested: on servers with many CPUs the per-NUMA-node
+    // and the host-level aggregates are usually enough to spot CPUs clocked down or parked in deep idle states
+    cpupower_aggregate_t summary = {};
+    for (auto& node : m_cpupower_nodes)
+        node = {};
+    const cpupower_cpu_t& ref = m_cpupower_cpus.front(); // the idle states are typically the same for all CPUs
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_start("cpupower");
+    for (auto& c : m_cpupower_cpus) {
+        uint64_t freq_khz = 0;
+        bool has_freq = c.has_freq && c.cur_freq_reader.read_integer(freq_khz);
+        double freq_mhz = (double)freq_khz / 1000;
+
+        if (output_opts == PF_ALL) {
+            m_pOutput->psubsection_start(fmt::format("cpu{:d}", c.cpu).c_str());
+            if (has_freq)
+                m_pOutput->pdouble("freq_mhz", freq_mhz);
+        }
+
+        cpupower_aggregate_t* node
+            = (c.numa_node >= 0 && (size_t)c.numa_node < m_cpupower_nodes.size()) ? &m_cpupower_nodes[c.numa_node]
+                                                                                   : nullptr;
+        for (size_t i = 0; i < c.states.size(); i++) {
+            cpuidle_state_t& state = c.states[i];
+            uint64_t time_us = 0, usage = 0;
+            if (!state.time_reader.read_integer(time_us) || !state.usage_reader.read_integer(usage)) {
+                state.valid = false;
+                continue;
+            }
+
+            if (state.valid && output_opts != PF_NONE) {
+                // usecs / (elapsed_sec * 1e6) * 100 gives a percentage:
+                double residency_pct = (double)(time_us - state.prev_time_us) / elapsed_sec / 1e4;
+                if (output_opts == PF_ALL) {
+                    m_pOutput->pdouble(state.residency_kpi_name.c_str(), residency_pct);
+                    m_pOutput->pdouble(state.usage_kpi_name.c_str(), (double)(usage - state.prev_usage) / elapsed_sec);
+                }
+                if (i < ref.states.size() && state.name == ref.states[i].name) {
+                    summary.residency_pct[i] += residency_pct;
+                    if (node)
+                        node->residency_pct[i] += residency_pct;
+                }
+            }
+
+            state.prev_time_us = time_us;
+            state.prev_usage = usage;
+            state.valid = true;
+        }
+
+        if (output_opts == PF_ALL)
+            m_pOutput->psubsection_end();
+
+        if (has_freq) {
+            add_cpu_freq_to_aggregate(summary, freq_mhz);
+            if (node)
+                add_cpu_freq_to_aggregate(*node, freq_mhz);
+        }
+        summary.num_cpus++;
+        if (node)
+            node->num_cpus++;
+    }
+
+    if (output_opts != PF_NONE) {
+        // skip per-node aggregates on single-node systems: they would just duplicate the summary
+        for (size_t n = 0; m_cpupower_nodes.size() > 1 && n < m_cpupower_nodes.size(); n++)
+            output_cpupower_aggregate(m_pOutput, fmt::format("node{:d}", n).c_str(), m_cpupower_nodes[n], ref);
+
+        output_cpupower_aggregate(m_pOutput, "summary", summary, ref);
+        m_pOutput->psection_end();
+    }
+}
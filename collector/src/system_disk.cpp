@@ -20,60 +20,35 @@
 #include "logger.h"
 #include "output_frontend.h"
 #include "system.h"
+#include "utils_string.h"
 #include <assert.h>
 
+// /proc/diskstats lines contain: major, minor, device name and then 4, 11, 15 or 17 statistics depending on the
+// kernel version; see https://www.kernel.org/doc/Documentation/ABI/testing/procfs-diskstats
+#define DISKSTATS_FIELDS_PARTITIONS_PRE_2_6_25 (7)
+#define DISKSTATS_FIELDS_BASE (14)
+#define DISKSTATS_FIELDS_WITH_DISCARDS (18) // kernel 4.18+
+#define DISKSTATS_FIELDS_WITH_FLUSHES (20) // kernel 5.5+
+
+bool CMonitorSystem::is_monitored_disk(const string_field_t& disk_name) const
+{
+    if (!m_pCfg->m_vecDiskInclude.empty() && !string_field_matches_any_prefix(disk_name, m_pCfg->m_vecDiskInclude))
+        return false;
+    if (!m_pCfg->m_vecDiskExclude.empty() && string_field_matches_any_prefix(disk_name, m_pCfg->m_vecDiskExclude))
+        return false;
+    return true;
+}
+
 /*
 read /proc/diskstats
 */
 void CMonitorSystem::sample_diskstats(double elapsed_sec, OutputFields output_opts)
 {
-    static bool first_time = true;
-    int dk_stats;
-
     if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_DISK) == 0)
         return;
 
     DEBUGLOG_FUNCTION_START();
 
-    if (first_time) {
-        /* popen variables */
-        FILE* pop;
-        char tmpstr[1024 + 1];
-        long i;
-        long j;
-        long len;
-
-        pop = popen("lsblk --nodeps --output NAME,TYPE --raw 2>/dev/null", "r");
-        if (pop != NULL) {
-            /* throw away the headerline */
-            if (fgets(tmpstr, 70, pop)) {
-                for (i = 0;; i++) {
-                    tmpstr[0] = 0;
-                    if (fgets(tmpstr, 70, pop) == NULL)
-                        break;
-                    tmpstr[strlen(tmpstr)] = 0; /* remove NL char */
-                    len = strlen(tmpstr);
-                    for (j = 0; j < len; j++)
-                        if (tmpstr[j] == ' ')
-                            tmpstr[j] = 0;
-
-                    if (strncmp(tmpstr, "loop", 4) != 0) {
-                        // CMonitorLogger::instance()->LogDebug("DEBUG saved %ld %s disk name\n", i,
-                        // previous[i].dk_name);
-                        m_disks.insert(tmpstr);
-                    } else {
-                        CMonitorLogger::instance()->LogDebug("Discarding disk %s\n", tmpstr);
-                        /* loop**** disks are not real */
-                    }
-                }
-            }
-            pclose(pop);
-        }
-
-        CMonitorLogger::instance()->LogDebug("Found %zu disks to monitor\n", m_disks.size());
-        first_time = false;
-    }
-
     if (!m_disk_stat.open_or_rewind()) {
         CMonitorLogger::instance()->LogError("failed to re-open %s", m_disk_stat.get_file().c_str());
         return;
@@ -86,36 +61,84 @@ void CMonitorSystem::sample_diskstats(double elapsed_sec, OutputFields output_op
         m_pOutput->psection_start("disks");
 
     diskinfo_t current;
+    string_field_t fields[DISKSTATS_FIELDS_WITH_FLUSHES];
+    uint64_t values[DISKSTATS_FIELDS_WITH_FLUSHES];
+    std::string disk_name; // device names are short enough to never require a heap allocation (SSO)
     const char* buf = m_disk_stat.get_next_line();
     while (buf) {
-        // char* pbuf = const_cast<char*>(buf);
-        // pbuf[strlen(buf) - 1] = 0; /* remove newline */ // unnecessary???
+        size_t nfields = split_fields_on_whitespace(buf, fields, DISKSTATS_FIELDS_WITH_FLUSHES);
+        if (nfields < 3) {
+            buf = m_disk_stat.get_next_line();
+            continue; // skip malformed lines
+        }
 
-        // CMonitorLogger::instance()->LogDebug("DISKSTATS: \"%s\"", buf);
+        // apply the device filter before converting any number: we pay only for the devices we care about
+        const string_field_t& name = fields[2];
+        if (!is_monitored_disk(name)) {
+            buf = m_disk_stat.get_next_line();
+            continue;
+        }
+
+        if (nfields != DISKSTATS_FIELDS_PARTITIONS_PRE_2_6_25 && nfields != DISKSTATS_FIELDS_BASE
+            && nfields != DISKSTATS_FIELDS_WITH_DISCARDS && nfields != DISKSTATS_FIELDS_WITH_FLUSHES) {
+            CMonitorLogger::instance()->LogError(
+                "disk stats: unexpected number of fields %zu in line=%s\n", nfields, buf);
+            buf = m_disk_stat.get_next_line();
+            continue;
+        }
+
+        bool valid = true;
+        for (size_t i = 0; i < nfields && valid; i++)
+            valid = (i == 2) || string_field2int(fields[i], values[i]);
+        if (!valid) {
+            CMonitorLogger::instance()->LogError("disk stats: invalid numeric field in line=%s\n", buf);
+            buf = m_disk_stat.get_next_line();
+            continue;
+        }
 
         /* zero the data ready for reading */
         bzero(&current, sizeof(diskinfo_t));
 
-        // try to read all the 14 fields
-        dk_stats = sscanf(buf, "%ld %ld %s %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld", &current.dk_major,
-            &current.dk_minor, // force newline
-            &current.dk_name[0], // force newline
-            &current.dk_reads, &current.dk_rmerge, &current.dk_rkb, &current.dk_rmsec, // force newline
-            &current.dk_writes, &current.dk_wmerge, &current.dk_wkb, &current.dk_wmsec, // force newline
-            &current.dk_inflight, &current.dk_time, &current.dk_backlog);
-
-        if (dk_stats == 7) {
-            /* shuffle the data around due to missing columns for partitions */
-            current.dk_wkb = current.dk_rmsec;
-            current.dk_writes = current.dk_rkb;
-            current.dk_rkb = current.dk_rmerge;
-            current.dk_rmsec = 0;
-            current.dk_rmerge = 0;
-        } else if (dk_stats != 14)
-            CMonitorLogger::instance()->LogError("disk sscanf wanted 14 but returned=%d line=%s\n", dk_stats, buf);
+        size_t name_len = std::min(name.len, sizeof(current.dk_name) - 1);
+        memcpy(current.dk_name, name.ptr, name_len);
+        current.dk_name[name_len] = '\0';
+
+        current.dk_num_fields = nfields;
+        current.dk_major = values[0];
+        current.dk_minor = values[1];
+        if (nfields == DISKSTATS_FIELDS_PARTITIONS_PRE_2_6_25) {
+            /* partitions on old kernels provide only reads, read sectors, writes, write sectors */
+            current.dk_reads = values[3];
+            current.dk_rkb = values[4];
+            current.dk_writes = values[5];
+            current.dk_wkb = values[6];
+        } else {
+            current.dk_reads = values[3];
+            current.dk_rmerge = values[4];
+            current.dk_rkb = values[5];
+            current.dk_rmsec = values[6];
+            current.dk_writes = values[7];
+            current.dk_wmerge = values[8];
+            current.dk_wkb = values[9];
+            current.dk_wmsec = values[10];
+            current.dk_inflight = values[11];
+            current.dk_time = values[12];
+            current.dk_backlog = values[13];
+            if (nfields >= DISKSTATS_FIELDS_WITH_DISCARDS) {
+                current.dk_discards = values[14];
+                current.dk_dmerge = values[15];
+                current.dk_dkb = values[16];
+                current.dk_dmsec = values[17];
+            }
+            if (nfields >= DISKSTATS_FIELDS_WITH_FLUSHES) {
+                current.dk_flushes = values[18];
+                current.dk_fmsec = values[19];
+            }
+        }
 
         current.dk_rkb /= 2; /* convert from sectors to Kbyte, keeping in mind that 1 sector = 512 bytes = 1/2 Kbyte */
         current.dk_wkb /= 2;
+        current.dk_dkb /= 2;
         current.dk_xfers = current.dk_reads + current.dk_writes;
         if (current.dk_xfers == 0)
             current.dk_bsize = 0;
@@ -125,51 +148,65 @@ void CMonitorSystem::sample_diskstats(double elapsed_sec, OutputFields output_op
         // f18m: not really sure this is correct... assumes that this field is updated 10 times per second
         current.dk_time /= 10.0; /* in milli-seconds to make it up to 100%, 1000/100 = 10 */
 
-        const auto it_prev = m_previous_diskinfo.find(current.dk_name);
-        if (it_prev != m_previous_diskinfo.end()) {
-            const diskinfo_t& previous = it_prev->second;
-
-            if (output_opts != PF_NONE) {
-                m_pOutput->psubsection_start(current.dk_name);
+        disk_name.assign(name.ptr, name.len);
+        diskinfo_t& previous = m_previous_diskinfo[disk_name];
+        if (previous.dk_num_fields != 0 /* was this device sampled already? */ && output_opts != PF_NONE) {
+            m_pOutput->psubsection_start(current.dk_name);
 
 #define DELTA_DISK_STAT(member) ((double)(current.member - previous.member) / elapsed_sec)
-
-                switch (output_opts) {
-                case PF_NONE:
-                    assert(0);
-                    break;
-
-                case PF_ALL:
-                    m_pOutput->pdouble("reads", DELTA_DISK_STAT(dk_reads));
-                    m_pOutput->pdouble("rmerge", DELTA_DISK_STAT(dk_rmerge));
-                    m_pOutput->pdouble("rkb", DELTA_DISK_STAT(dk_rkb));
-                    m_pOutput->pdouble("rmsec", DELTA_DISK_STAT(dk_rmsec));
-
-                    m_pOutput->pdouble("writes", DELTA_DISK_STAT(dk_writes));
-                    m_pOutput->pdouble("wmerge", DELTA_DISK_STAT(dk_wmerge));
-                    m_pOutput->pdouble("wkb", DELTA_DISK_STAT(dk_wkb));
-                    m_pOutput->pdouble("wmsec", DELTA_DISK_STAT(dk_wmsec));
-
-                    m_pOutput->plong("inflight", current.dk_inflight);
-                    m_pOutput->pdouble("time", DELTA_DISK_STAT(dk_time));
-                    m_pOutput->pdouble("backlog", DELTA_DISK_STAT(dk_backlog));
-                    m_pOutput->pdouble("xfers", DELTA_DISK_STAT(dk_xfers));
-                    m_pOutput->plong("bsize", current.dk_bsize);
-                    break;
-
-                case PF_USED_BY_CHART_SCRIPT_ONLY:
-                    m_pOutput->pdouble("rkb", DELTA_DISK_STAT(dk_rkb));
-                    m_pOutput->pdouble("wkb", DELTA_DISK_STAT(dk_wkb));
-                    break;
+#define AVG_DISK_LATENCY(msec_member, ops_member)                                                                      \
+    ((current.ops_member > previous.ops_member)                                                                        \
+            ? (double)(current.msec_member - previous.msec_member) / (current.ops_member - previous.ops_member)        \
+            : 0.0)
+
+            switch (output_opts) {
+            case PF_NONE:
+                assert(0);
+                break;
+
+            case PF_ALL:
+                m_pOutput->pdouble("reads", DELTA_DISK_STAT(dk_reads));
+                m_pOutput->pdouble("rmerge", DELTA_DISK_STAT(dk_rmerge));
+                m_pOutput->pdouble("rkb", DELTA_DISK_STAT(dk_rkb));
+                m_pOutput->pdouble("rmsec", DELTA_DISK_STAT(dk_rmsec));
+                m_pOutput->pdouble("ravg_msec", AVG_DISK_LATENCY(dk_rmsec, dk_reads));
+
+                m_pOutput->pdouble("writes", DELTA_DISK_STAT(dk_writes));
+                m_pOutput->pdouble("wmerge", DELTA_DISK_STAT(dk_wmerge));
+                m_pOutput->pdouble("wkb", DELTA_DISK_STAT(dk_wkb));
+                m_pOutput->pdouble("wmsec", DELTA_DISK_STAT(dk_wmsec));
+                m_pOutput->pdouble("wavg_msec", AVG_DISK_LATENCY(dk_wmsec, dk_writes));
+
+                if (current.dk_num_fields >= DISKSTATS_FIELDS_WITH_DISCARDS) {
+                    m_pOutput->pdouble("discards", DELTA_DISK_STAT(dk_discards));
+                    m_pOutput->pdouble("dmerge", DELTA_DISK_STAT(dk_dmerge));
+                    m_pOutput->pdouble("dkb", DELTA_DISK_STAT(dk_dkb));
+                    m_pOutput->pdouble("dmsec", DELTA_DISK_STAT(dk_dmsec));
+                }
+                if (current.dk_num_fields >= DISKSTATS_FIELDS_WITH_FLUSHES) {
+                    m_pOutput->pdouble("flushes", DELTA_DISK_STAT(dk_flushes));
+                    m_pOutput->pdouble("fmsec", DELTA_DISK_STAT(dk_fmsec));
                 }
 
-                m_pOutput->psubsection_end();
+                m_pOutput->plong("inflight", current.dk_inflight);
+                m_pOutput->pdouble("time", DELTA_DISK_STAT(dk_time));
+                m_pOutput->pdouble("backlog", DELTA_DISK_STAT(dk_backlog));
+                m_pOutput->pdouble("xfers", DELTA_DISK_STAT(dk_xfers));
+                m_pOutput->plong("bsize", current.dk_bsize);
+                break;
+
+            case PF_USED_BY_CHART_SCRIPT_ONLY:
+                m_pOutput->pdouble("rkb", DELTA_DISK_STAT(dk_rkb));
+                m_pOutput->pdouble("wkb", DELTA_DISK_STAT(dk_wkb));
+                break;
             }
+
+            m_pOutput->psubsection_end();
         }
 
-        m_previous_diskinfo[current.dk_name] = current;
+        previous = current;
         buf = m_disk_stat.get_next_line();
     }
     if (output_opts != PF_NONE)
         m_pOutput->psection_end();
-}
\ No newline at end of file
+}
@@ -0,0 +1,222 @@
+/*
+ * system_fragmentation.cpp - code for collecting SYSTEM-level memory fragmentation statistics (i.e. not cgroup-aware)
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logger.h"
+#include "output_frontend.h"
+#include "system.h"
+#include "utils_string.h"
+
+// allocations above this order are considered "costly" by the kernel (PAGE_ALLOC_COSTLY_ORDER):
+#define COSTLY_ORDER (3)
+// order of a transparent huge page on x86_64 (2MB):
+#define THP_ORDER (9)
+
+/*
+    Parses a zone identifier like "Node 0, zone   Normal", which is the format used by both /proc/buddyinfo
+    and /proc/zoneinfo; returns the number of fields consumed
+*/
+static size_t parse_zone_id(const string_field_t* fields, size_t nfields, unsigned int& node, string_field_t& zone)
+{
+    if (nfields < 4 || fields[0].len != 4 || strncmp(fields[0].ptr, "Node", 4) != 0)
+        return 0;
+    node = (unsigned int)strtoul(fields[1].ptr, NULL, 10);
+    zone = fields[3];
+    return 4;
+}
+
+static bool zone_matches(const zone_frag_info_t& z, unsigned int node, const string_field_t& zone)
+{
+    return z.node == node && strncmp(z.zone, zone.ptr, zone.len) == 0 && z.zone[zone.len] == '\0';
+}
+
+bool CMonitorSystem::read_buddyinfo()
+{
+    // clang-format off
+    /*
+        /proc/buddyinfo has a format like:
+
+            Node 0, zone      DMA      0      0      0      0      0      0      0      0      1      1      3
+            Node 0, zone    DMA32      2      2      2      2      2      2      5      2      2      2    754
+            Node 0, zone   Normal  11089   6144   1936    502    234     78     21     59    106     40     52
+
+        each column is the number of free blocks of 2^order pages, starting from order 0
+    */
+    // clang-format on
+
+    if (!m_buddyinfo.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_buddyinfo.get_file().c_str());
+        return false;
+    }
+
+    string_field_t fields[4 + MAX_BUDDY_ORDERS];
+    size_t nzones = 0;
+    for (const char* line = m_buddyinfo.get_next_line(); line; line = m_buddyinfo.get_next_line()) {
+        size_t nfields = split_fields_on_whitespace(line, fields, 4 + MAX_BUDDY_ORDERS);
+        unsigned int node;
+        string_field_t zone;
+        size_t first = parse_zone_id(fields, nfields, node, zone);
+        if (first == 0)
+            continue;
+
+        if (nzones >= m_zones.size())
+            m_zones.emplace_back(); // this happens only at the first sample (or on memory hotplug)
+        zone_frag_info_t& z = m_zones[nzones++];
+        z = {};
+        z.node = node;
+        size_t zone_len = std::min(zone.len, (size_t)ZONE_NAME_MAXLEN - 1);
+        memcpy(z.zone, zone.ptr, zone_len);
+        z.zone[zone_len] = '\0';
+        for (size_t i = first; i < nfields && string_field2int(fields[i], z.free_blocks[z.num_orders]); i++)
+            z.num_orders++;
+    }
+    m_zones.resize(nzones);
+
+    return nzones > 0;
+}
+
+bool CMonitorSystem::read_zoneinfo()
+{
+    // clang-format off
+    /*
+        /proc/zoneinfo has a format like:
+
+            Node 0, zone   Normal
+              per-node stats
+                  nr_inactive_anon 69558
+                  ...
+              pages free     3840
+                    boost    0
+                    min      49
+                    low      61
+                    high     73
+                    ...
+    */
+    // clang-format on
+
+    if (!m_zoneinfo.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_zoneinfo.get_file().c_str());
+        return false;
+    }
+
+    string_field_t fields[4];
+    zone_frag_info_t* current = nullptr;
+    size_t current_zone_idx = 0;
+    for (const char* line = m_zoneinfo.get_next_line(); line; line = m_zoneinfo.get_next_line()) {
+        size_t nfields = split_fields_on_whitespace(line, fields, 4);
+        unsigned int node;
+        string_field_t zone;
+        if (parse_zone_id(fields, nfields, node, zone) > 0) {
+            // zones are listed in the same order of /proc/buddyinfo, which however skips the empty zones:
+            current = nullptr;
+            for (size_t i = current_zone_idx; i < m_zones.size(); i++) {
+                if (zone_matches(m_zones[i], node, zone)) {
+                    current = &m_zones[i];
+                    current_zone_idx = i + 1;
+                    break;
+                }
+            }
+            continue;
+        }
+        if (!current)
+            continue;
+
+        if (nfields == 3 && fields[0].len == 5 && strncmp(fields[0].ptr, "pages", 5) == 0
+            && fields[1].len == 4 && strncmp(fields[1].ptr, "free", 4) == 0) {
+            string_field2int(fields[2], current->free_pages);
+        } else if (nfields == 2 && fields[0].len == 3 && strncmp(fields[0].ptr, "min", 3) == 0) {
+            string_field2int(fields[1], current->min_wmark_pages);
+        } else if (nfields == 2 && fields[0].len == 3 && strncmp(fields[0].ptr, "low", 3) == 0) {
+            string_field2int(fields[1], current->low_wmark_pages);
+        } else if (nfields == 2 && fields[0].len == 4 && strncmp(fields[0].ptr, "high", 4) == 0) {
+            string_field2int(fields[1], current->high_wmark_pages);
+            current->has_watermarks = true;
+            current = nullptr; // nothing else to read for this zone
+        }
+    }
+
+    return true;
+}
+
+/*
+    Computes the "unusable free space index" for the given order, as defined by Mel Gorman in
+    "Measuring the Impact of the Linux Memory Manager": the fraction of the free memory that is made of blocks
+    smaller than 2^order pages and thus cannot be used for an allocation of that order.
+    0 means no fragmentation, 1 means that allocations of that order cannot be satisfied without compaction.
+*/
+static double unusable_free_space_index(const zone_frag_info_t& z, unsigned int order)
+{
+    uint64_t total_free = 0, usable_free = 0;
+    for (unsigned int i = 0; i < z.num_orders; i++) {
+        uint64_t pages = z.free_blocks[i] << i;
+        total_free += pages;
+        if (i >= order)
+            usable_free += pages;
+    }
+    if (total_free == 0)
+        return 0;
+    return (double)(total_free - usable_free) / (double)total_free;
+}
+
+/*
+ read /proc/buddyinfo and /proc/zoneinfo
+ */
+void CMonitorSystem::sample_fragmentation(OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_FRAGMENTATION) == 0)
+        return;
+
+    // fragmentation changes slowly and /proc/zoneinfo is large (several KBs for each NUMA node): sample it
+    // only once every m_nFragmentationInterval samples
+    if ((m_fragmentation_sample_counter++ % m_pCfg->m_nFragmentationInterval) != 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    if (!read_buddyinfo())
+        return;
+    read_zoneinfo(); // the watermarks are optional
+
+    m_pOutput->psection_start("fragmentation");
+    for (const auto& z : m_zones) {
+        int largest_free_order = -1;
+        uint64_t free_pages = 0;
+        for (unsigned int i = 0; i < z.num_orders; i++) {
+            free_pages += z.free_blocks[i] << i;
+            if (z.free_blocks[i] > 0)
+                largest_free_order = i;
+        }
+
+        m_pOutput->psubsection_start(fmt::format("node{}_{}", z.node, to_lower(z.zone)).c_str());
+        m_pOutput->plong("free_pages", free_pages);
+        m_pOutput->plong("largest_free_order", largest_free_order);
+        m_pOutput->pdouble("unusable_index_order3", unusable_free_space_index(z, COSTLY_ORDER));
+        m_pOutput->pdouble("unusable_index_order9", unusable_free_space_index(z, THP_ORDER));
+        if (z.has_watermarks) {
+            if (output_opts == PF_ALL) {
+                m_pOutput->plong("min_wmark_pages", z.min_wmark_pages);
+                m_pOutput->plong("low_wmark_pages", z.low_wmark_pages);
+                m_pOutput->plong("high_wmark_pages", z.high_wmark_pages);
+            }
+            // the kernel compares the watermarks with the "pages free" counter of /proc/zoneinfo:
+            m_pOutput->plong("low_wmark_distance_pages", (long long)z.free_pages - (long long)z.low_wmark_pages);
+        }
+        m_pOutput->psubsection_end();
+    }
+    m_pOutput->psection_end();
+}
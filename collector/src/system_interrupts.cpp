@@ -0,0 +1,182 @@
+/*
+ * system_interrupts.cpp - code for collecting SYSTEM-level per-CPU interrupt statistics (i.e. not cgroup-aware)
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logger.h"
+#include "output_frontend.h"
+#include "system.h"
+#include "utils_misc.h"
+#include "utils_string.h"
+#include <assert.h>
+
+/*
+    PERFORMANCE NOTE:
+    /proc/interrupts is a matrix of (number of IRQs) x (number of online CPUs) counters: on large servers it can
+    be several hundreds of KB. It is read in streaming mode, one chunk at a time, and the deltas are computed in
+    the same pass that parses the counters, against the previous counters stored in a flat array.
+    After the first sample no memory gets allocated, unless new IRQ lines appear.
+*/
+
+/*
+ read /proc/interrupts
+ */
+void CMonitorSystem::sample_interrupts(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_INTERRUPTS) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    // clang-format off
+    /*
+        the file has a format like:
+
+                       CPU0       CPU1
+              0:         33          0   IO-APIC   2-edge      timer
+              8:          0          0   IO-APIC   8-edge      rtc0
+            125:     182350      73211   PCI-MSI 1572864-edge      eth0-TxRx-0
+            NMI:        105         98   Non-maskable interrupts
+            LOC:   12875519   11436520   Local timer interrupts
+            ERR:          0
+    */
+    // clang-format on
+
+    if (!m_interrupts.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_interrupts.get_file().c_str());
+        return;
+    }
+
+    // the header line provides the CPU index of each column; only online CPUs are listed:
+    string_field_t fields[MAX_LOGICAL_CPU + 1];
+    const char* line = m_interrupts.get_next_line();
+    if (!line)
+        return;
+    size_t ncolumns = split_fields_on_whitespace(line, fields, MAX_LOGICAL_CPU);
+    bool columns_changed = (ncolumns != m_irq_num_columns);
+    for (size_t i = 0; i < ncolumns; i++) {
+        unsigned int cpu = MAX_LOGICAL_CPU;
+        if (fields[i].len > 3 && strncmp(fields[i].ptr, "CPU", 3) == 0)
+            cpu = (unsigned int)strtoul(fields[i].ptr + 3, NULL, 10);
+        if (cpu != m_irq_column2cpu[i])
+            columns_changed = true;
+        m_irq_column2cpu[i] = cpu;
+    }
+    if (columns_changed) {
+        // e.g. a CPU went offline/online: previous counters cannot be used anymore
+        m_irq_num_columns = ncolumns;
+        m_irq_rows.clear();
+    }
+    if (ncolumns == 0)
+        return;
+
+    uint32_t deltas[MAX_LOGICAL_CPU];
+    double threshold = (double)m_pCfg->m_nInterruptsThreshold;
+    double total_rate = 0;
+    unsigned int num_irqs_above_threshold = 0;
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_start("interrupts");
+
+    size_t row = 0;
+    for (line = m_interrupts.get_next_line(); line; line = m_interrupts.get_next_line()) {
+        size_t nfields = split_fields_on_whitespace(line, fields, ncolumns + 1);
+        if (nfields < 2 || fields[0].len < 2 || fields[0].ptr[fields[0].len - 1] != ':')
+            continue;
+
+        // IRQ label without the trailing colon, e.g. "125" or "LOC":
+        size_t label_len = std::min(fields[0].len - 1, (size_t)IRQ_LABEL_MAXLEN - 1);
+
+        // rows like "ERR:" and "MIS:" have a single system-wide counter, not related to any CPU column:
+        bool is_system_wide = label_len == 3
+            && (strncmp(fields[0].ptr, "ERR", 3) == 0 || strncmp(fields[0].ptr, "MIS", 3) == 0);
+        size_t max_counters = is_system_wide ? 1 : nfields - 1;
+
+        if (row >= m_irq_rows.size()) {
+            // new IRQ line: this is the only case where memory gets allocated
+            m_irq_rows.emplace_back();
+            m_irq_prev_counters.resize(m_irq_rows.size() * ncolumns);
+        }
+        irq_row_t& irq = m_irq_rows[row];
+        uint64_t* prev = &m_irq_prev_counters[row * ncolumns];
+        bool has_prev = irq.valid && strncmp(irq.label, fields[0].ptr, label_len) == 0 && irq.label[label_len] == '\0';
+        if (!has_prev) {
+            // IRQ lines changed (e.g. a device driver has been loaded): deltas can be computed from next sample
+            memcpy(irq.label, fields[0].ptr, label_len);
+            irq.label[label_len] = '\0';
+            irq.valid = true;
+        }
+
+        // parse counters and compute deltas in a single pass:
+        uint64_t total = 0;
+        size_t ncounters = 0;
+        for (size_t c = 0; c < max_counters; c++) {
+            uint64_t value;
+            if (!string_field2int(fields[c + 1], value))
+                break;
+            if (has_prev) {
+                // counters are 32-bit wide in the kernel and wrap around quickly on busy IRQ lines:
+                deltas[c] = counter32_delta(value, prev[c]);
+                if (is_system_wide || is_monitored_cpu(m_irq_column2cpu[c]))
+                    total += deltas[c];
+            }
+            prev[c] = value;
+            ncounters++;
+        }
+        row++;
+
+        if (!has_prev || output_opts == PF_NONE)
+            continue;
+
+        double rate = (double)total / elapsed_sec;
+        total_rate += rate;
+        if (rate < threshold || rate == 0)
+            continue;
+
+        // sparse output: only IRQs above threshold and only CPUs that actually served them
+        num_irqs_above_threshold++;
+        m_pOutput->psubsection_start(irq.label);
+        m_pOutput->pdouble("total", rate);
+        for (size_t c = 0; c < ncounters && !is_system_wide; c++) {
+            if (deltas[c] == 0 || !is_monitored_cpu(m_irq_column2cpu[c]))
+                continue;
+            char cpu_name[16];
+            snprintf(cpu_name, sizeof(cpu_name), "cpu%u", m_irq_column2cpu[c]);
+            m_pOutput->pdouble(cpu_name, (double)deltas[c] / elapsed_sec);
+        }
+
+        // the description (interrupt controller, hw IRQ and device names) helps identifying the IRQ:
+        const char* desc = fields[ncounters].ptr + fields[ncounters].len;
+        while (*desc == ' ' || *desc == '\t')
+            desc++;
+        if (*desc != '\0')
+            m_pOutput->pstring("desc", desc);
+        m_pOutput->psubsection_end();
+    }
+
+    // forget about IRQ lines that disappeared:
+    if (row < m_irq_rows.size())
+        m_irq_rows.resize(row);
+
+    if (output_opts != PF_NONE) {
+        m_pOutput->psubsection_start("summary");
+        m_pOutput->pdouble("total", total_rate);
+        m_pOutput->plong("num_irqs_above_threshold", num_irqs_above_threshold);
+        m_pOutput->psubsection_end();
+        m_pOutput->psection_end();
+    }
+}
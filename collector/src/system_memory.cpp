@@ -21,6 +21,54 @@
 #include "output_frontend.h"
 #include "system.h"
 #include "utils_string.h"
+#include <assert.h>
+
+// The /proc/vmstat counters that matter when latency spikes come from memory reclaim.
+// Some counters are split differently depending on the kernel version: all the matching values get summed, which
+// takes care of the per-zone counters of kernels older than 4.8 (e.g. "pgscan_kswapd_normal") and of the anon/file
+// split of kernels 5.9+ (e.g. "workingset_refault_anon" and "workingset_refault_file").
+typedef struct {
+    VmstatCounter id;
+    const char* name;
+    size_t len;
+} vmstat_counter_desc_t;
+
+#define VMSTAT_COUNTER(id, name)                                                                                       \
+    {                                                                                                                  \
+        id, name, sizeof(name) - 1                                                                                     \
+    }
+#define VMSTAT_ZONE_COUNTERS(id, name)                                                                                 \
+    VMSTAT_COUNTER(id, name), VMSTAT_COUNTER(id, name "_dma"), VMSTAT_COUNTER(id, name "_dma32"),                      \
+        VMSTAT_COUNTER(id, name "_normal"), VMSTAT_COUNTER(id, name "_movable")
+
+static const vmstat_counter_desc_t g_vmstat_counters[] = {
+    VMSTAT_ZONE_COUNTERS(VMSTAT_PGSCAN_KSWAPD, "pgscan_kswapd"),
+    VMSTAT_ZONE_COUNTERS(VMSTAT_PGSCAN_DIRECT, "pgscan_direct"),
+    VMSTAT_ZONE_COUNTERS(VMSTAT_PGSTEAL_KSWAPD, "pgsteal_kswapd"),
+    VMSTAT_ZONE_COUNTERS(VMSTAT_PGSTEAL_DIRECT, "pgsteal_direct"),
+    VMSTAT_COUNTER(VMSTAT_COMPACT_STALL, "compact_stall"),
+    VMSTAT_COUNTER(VMSTAT_THP_FAULT_FALLBACK, "thp_fault_fallback"),
+    VMSTAT_COUNTER(VMSTAT_PSWPIN, "pswpin"),
+    VMSTAT_COUNTER(VMSTAT_PSWPOUT, "pswpout"),
+    VMSTAT_COUNTER(VMSTAT_WORKINGSET_REFAULT, "workingset_refault"),
+    VMSTAT_COUNTER(VMSTAT_WORKINGSET_REFAULT, "workingset_refault_anon"),
+    VMSTAT_COUNTER(VMSTAT_WORKINGSET_REFAULT, "workingset_refault_file"),
+    VMSTAT_COUNTER(VMSTAT_OOM_KILL, "oom_kill"),
+};
+
+// names used in the output, indexed by VmstatCounter:
+static const char* g_vmstat_output_names[VMSTAT_MAX] = {
+    "pgscan_kswapd",
+    "pgscan_direct",
+    "pgsteal_kswapd",
+    "pgsteal_direct",
+    "compact_stall",
+    "thp_fault_fallback",
+    "pswpin",
+    "pswpout",
+    "workingset_refault",
+    "oom_kill",
+};
 
 /*
 read /proc/meminfo
@@ -112,4 +160,78 @@ void CMonitorSystem::sample_memory(const std::set<std::string>& charted_stats_fr
             m_pOutput->plong(entry.first.c_str(), entry.second);
         m_pOutput->psection_end();
     }
+}
+
+/*
+read /proc/vmstat
+which has format
+    STATNAME <value>
+*/
+void CMonitorSystem::sample_vmstat(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_MEMORY) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    if (!m_vmstat.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_vmstat.get_file().c_str());
+        return;
+    }
+
+    // /proc/vmstat has more than 100 lines: match just the whitelisted counters, without any memory allocation
+    uint64_t new_values[VMSTAT_MAX] = {};
+    string_field_t fields[2];
+    for (const char* line = m_vmstat.get_next_line(); line; line = m_vmstat.get_next_line()) {
+        if (split_fields_on_whitespace(line, fields, 2) != 2)
+            continue;
+
+        for (const auto& counter : g_vmstat_counters) {
+            if (fields[0].len != counter.len || strncmp(fields[0].ptr, counter.name, counter.len) != 0)
+                continue;
+
+            uint64_t value;
+            if (string_field2int(fields[1], value))
+                new_values[counter.id] += value;
+            break;
+        }
+    }
+
+    if (output_opts != PF_NONE && m_vmstat_prev_valid) {
+        double rates[VMSTAT_MAX];
+        for (unsigned int i = 0; i < VMSTAT_MAX; i++)
+            rates[i] = (new_values[i] >= m_vmstat_prev_values[i])
+                ? (double)(new_values[i] - m_vmstat_prev_values[i]) / elapsed_sec
+                : 0;
+
+        m_pOutput->psection_start("proc_vmstat_rates");
+        switch (output_opts) {
+        case PF_NONE:
+            assert(0);
+            break;
+        case PF_ALL:
+            for (unsigned int i = 0; i < VMSTAT_MAX; i++)
+                m_pOutput->pdouble(g_vmstat_output_names[i], rates[i]);
+            break;
+        case PF_USED_BY_CHART_SCRIPT_ONLY:
+            m_pOutput->pdouble("pgscan_direct", rates[VMSTAT_PGSCAN_DIRECT]);
+            m_pOutput->pdouble("compact_stall", rates[VMSTAT_COMPACT_STALL]);
+            m_pOutput->pdouble("pswpin", rates[VMSTAT_PSWPIN]);
+            m_pOutput->pdouble("pswpout", rates[VMSTAT_PSWPOUT]);
+            m_pOutput->pdouble("oom_kill", rates[VMSTAT_OOM_KILL]);
+            break;
+        }
+
+        // derived KPIs: how much of the reclaim work happens synchronously in the allocating tasks, and how
+        // effective the scanning is (low efficiency means the kernel is struggling to find reclaimable pages)
+        double scanned = rates[VMSTAT_PGSCAN_KSWAPD] + rates[VMSTAT_PGSCAN_DIRECT];
+        double reclaimed = rates[VMSTAT_PGSTEAL_KSWAPD] + rates[VMSTAT_PGSTEAL_DIRECT];
+        m_pOutput->pdouble("direct_scan_pct", scanned > 0 ? 100 * rates[VMSTAT_PGSCAN_DIRECT] / scanned : 0);
+        m_pOutput->pdouble("reclaim_efficiency_pct", scanned > 0 ? 100 * reclaimed / scanned : 0);
+        m_pOutput->psection_end();
+    }
+
+    // finally remember the last sampled stats:
+    memcpy(m_vmstat_prev_values, new_values, sizeof(m_vmstat_prev_values));
+    m_vmstat_prev_valid = true;
 }
\ No newline at end of file
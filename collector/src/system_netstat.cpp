@@ -0,0 +1,277 @@
+/*
+ * system_netstat.cpp - code for collecting SYSTEM-level protocol statistics from /proc/net/snmp and /proc/net/netstat
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "logger.h"
+#include "output_frontend.h"
+#include "system.h"
+#include "utils_string.h"
+#include <algorithm>
+#include <assert.h>
+
+// the TcpExt line of /proc/net/netstat has more than 100 columns on recent kernels: columns beyond this limit
+// are never sampled
+#define NETSTAT_MAX_COLUMNS (256)
+
+// The /proc/net/snmp and /proc/net/netstat counters that matter when investigating connection failures,
+// packet drops and retransmissions. The position of each column changes across kernel versions, so each
+// counter is identified by the name found in the header line; see snmp4_tcp_list[] and snmp4_net_list[]
+// in net/ipv4/proc.c
+typedef struct {
+    NetstatCounter id;
+    NetstatFile file;
+    const char* prefix;
+    const char* name;
+} netstat_counter_desc_t;
+
+static const netstat_counter_desc_t g_netstat_counters[] = {
+    { NETSTAT_TCP_ACTIVE_OPENS, NETSTAT_FILE_SNMP, "Tcp:", "ActiveOpens" },
+    { NETSTAT_TCP_PASSIVE_OPENS, NETSTAT_FILE_SNMP, "Tcp:", "PassiveOpens" },
+    { NETSTAT_TCP_ATTEMPT_FAILS, NETSTAT_FILE_SNMP, "Tcp:", "AttemptFails" },
+    { NETSTAT_TCP_ESTAB_RESETS, NETSTAT_FILE_SNMP, "Tcp:", "EstabResets" },
+    { NETSTAT_TCP_IN_SEGS, NETSTAT_FILE_SNMP, "Tcp:", "InSegs" },
+    { NETSTAT_TCP_OUT_SEGS, NETSTAT_FILE_SNMP, "Tcp:", "OutSegs" },
+    { NETSTAT_TCP_RETRANS_SEGS, NETSTAT_FILE_SNMP, "Tcp:", "RetransSegs" },
+    { NETSTAT_TCP_IN_ERRS, NETSTAT_FILE_SNMP, "Tcp:", "InErrs" },
+    { NETSTAT_TCP_OUT_RSTS, NETSTAT_FILE_SNMP, "Tcp:", "OutRsts" },
+    { NETSTAT_UDP_IN_DATAGRAMS, NETSTAT_FILE_SNMP, "Udp:", "InDatagrams" },
+    { NETSTAT_UDP_OUT_DATAGRAMS, NETSTAT_FILE_SNMP, "Udp:", "OutDatagrams" },
+    { NETSTAT_UDP_NO_PORTS, NETSTAT_FILE_SNMP, "Udp:", "NoPorts" },
+    { NETSTAT_UDP_IN_ERRORS, NETSTAT_FILE_SNMP, "Udp:", "InErrors" },
+    { NETSTAT_UDP_RCVBUF_ERRORS, NETSTAT_FILE_SNMP, "Udp:", "RcvbufErrors" },
+    { NETSTAT_UDP_SNDBUF_ERRORS, NETSTAT_FILE_SNMP, "Udp:", "SndbufErrors" },
+    { NETSTAT_TCP_LISTEN_OVERFLOWS, NETSTAT_FILE_NETSTAT, "TcpExt:", "ListenOverflows" },
+    { NETSTAT_TCP_LISTEN_DROPS, NETSTAT_FILE_NETSTAT, "TcpExt:", "ListenDrops" },
+    { NETSTAT_TCP_TIMEOUTS, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPTimeouts" },
+    { NETSTAT_TCP_SYN_RETRANS, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPSynRetrans" },
+    { NETSTAT_TCP_FAST_RETRANS, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPFastRetrans" },
+    { NETSTAT_TCP_LOST_RETRANSMIT, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPLostRetransmit" },
+    { NETSTAT_TCP_BACKLOG_DROP, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPBacklogDrop" },
+    { NETSTAT_TCP_ABORT_ON_DATA, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPAbortOnData" },
+    { NETSTAT_TCP_ABORT_ON_CLOSE, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPAbortOnClose" },
+    { NETSTAT_TCP_ABORT_ON_MEMORY, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPAbortOnMemory" },
+    { NETSTAT_TCP_ABORT_ON_TIMEOUT, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPAbortOnTimeout" },
+    { NETSTAT_TCP_ABORT_ON_LINGER, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPAbortOnLinger" },
+    { NETSTAT_TCP_ABORT_FAILED, NETSTAT_FILE_NETSTAT, "TcpExt:", "TCPAbortFailed" },
+};
+
+// names used in the output, indexed by NetstatCounter:
+static const char* g_netstat_output_names[NETSTAT_MAX] = {
+    "tcp_active_opens",
+    "tcp_passive_opens",
+    "tcp_attempt_fails",
+    "tcp_estab_resets",
+    "tcp_in_segs",
+    "tcp_out_segs",
+    "tcp_retrans_segs",
+    "tcp_in_errs",
+    "tcp_out_rsts",
+    "udp_in_datagrams",
+    "udp_out_datagrams",
+    "udp_no_ports",
+    "udp_in_errors",
+    "udp_rcvbuf_errors",
+    "udp_sndbuf_errors",
+    "tcp_listen_overflows",
+    "tcp_listen_drops",
+    "tcp_timeouts",
+    "tcp_syn_retrans",
+    "tcp_fast_retrans",
+    "tcp_lost_retransmit",
+    "tcp_backlog_drop",
+    "tcp_abort_on_data",
+    "tcp_abort_on_close",
+    "tcp_abort_on_memory",
+    "tcp_abort_on_timeout",
+    "tcp_abort_on_linger",
+    "tcp_abort_failed",
+};
+
+static bool string_field_equals(const string_field_t& field, const char* str)
+{
+    size_t len = strlen(str);
+    return field.len == len && strncmp(field.ptr, str, len) == 0;
+}
+
+void CMonitorSystem::init_netstat_readers(
+    netstat_readers_t& readers, const std::string& proc_net_path, bool reopen_each_time)
+{
+    readers.files[NETSTAT_FILE_SNMP].set_file(proc_net_path + "/snmp", reopen_each_time);
+    readers.files[NETSTAT_FILE_NETSTAT].set_file(proc_net_path + "/netstat", reopen_each_time);
+    readers.resolved = false;
+    readers.prev_valid = false;
+}
+
+/*
+ Scans the header lines of /proc/net/snmp or /proc/net/netstat and stores the column index of each sampled counter,
+ so that the value lines can be parsed later without any string comparison on the counter names.
+ */
+bool CMonitorSystem::resolve_netstat_columns(
+    FastFileReader& reader, NetstatFile file, std::vector<netstat_group_t>& groups)
+{
+    groups.clear();
+    if (!reader.open_or_rewind()) {
+        CMonitorLogger::instance()->LogDebug("Cannot open file [%s]", reader.get_file().c_str());
+        return false;
+    }
+
+    std::vector<string_field_t> fields(NETSTAT_MAX_COLUMNS);
+    size_t nresolved = 0, nwanted = 0;
+    for (const auto& counter : g_netstat_counters)
+        if (counter.file == file)
+            nwanted++;
+
+    for (const char* line = reader.get_next_line(); line; line = reader.get_next_line()) {
+        size_t nfields = split_fields_on_whitespace(line, fields.data(), NETSTAT_MAX_COLUMNS);
+        if (nfields < 2 || !isalpha(fields[1].ptr[0]))
+            continue; // this is a value line
+
+        netstat_group_t group;
+        for (const auto& counter : g_netstat_counters) {
+            if (counter.file != file || !string_field_equals(fields[0], counter.prefix))
+                continue;
+            for (unsigned int col = 1; col < nfields; col++) {
+                if (string_field_equals(fields[col], counter.name)) {
+                    group.columns.push_back(std::make_pair(col, counter.id));
+                    nresolved++;
+                    break;
+                }
+            }
+        }
+
+        if (!group.columns.empty()) {
+            group.prefix = std::string(fields[0].ptr, fields[0].len);
+            std::sort(group.columns.begin(), group.columns.end());
+            groups.push_back(group);
+        }
+    }
+
+    // on older kernels some counters may be missing: they will be reported as zero
+    CMonitorLogger::instance()->LogDebug(
+        "From %s resolved %zu/%zu counters", reader.get_file().c_str(), nresolved, nwanted);
+    return true;
+}
+
+/*
+ read /proc/net/snmp and /proc/net/netstat
+ which have format
+    Prefix: Name1 Name2 Name3 ...
+    Prefix: <value1> <value2> <value3> ...
+ */
+bool CMonitorSystem::read_netstat_stats(netstat_readers_t& readers, uint64_t* out_values)
+{
+    if (!readers.resolved) {
+        for (unsigned int i = 0; i < NETSTAT_FILE_MAX; i++)
+            if (!resolve_netstat_columns(readers.files[i], (NetstatFile)i, readers.groups[i]))
+                return false;
+        readers.resolved = true;
+    }
+
+    memset(out_values, 0, NETSTAT_MAX * sizeof(uint64_t));
+    string_field_t fields[NETSTAT_MAX_COLUMNS];
+    for (unsigned int i = 0; i < NETSTAT_FILE_MAX; i++) {
+        FastFileReader& reader = readers.files[i];
+        const std::vector<netstat_group_t>& groups = readers.groups[i];
+        if (!reader.open_or_rewind())
+            return false;
+
+        for (const char* line = reader.get_next_line(); line; line = reader.get_next_line()) {
+            // the groups are matched by prefix and not by line number since e.g. the IcmpMsg lines of
+            // /proc/net/snmp appear only after the first ICMP message has been exchanged
+            const char* space = strchr(line, ' ');
+            if (!space || !(isdigit(space[1]) || space[1] == '-'))
+                continue; // this is a header line
+
+            string_field_t prefix = { line, (size_t)(space - line) };
+            for (const auto& group : groups) {
+                if (!string_field_equals(prefix, group.prefix.c_str()))
+                    continue;
+
+                // parse only up to the last needed column:
+                size_t nfields = split_fields_on_whitespace(line, fields, group.columns.back().first + 1);
+                for (const auto& column : group.columns) {
+                    uint64_t value;
+                    if (column.first < nfields && string_field2int(fields[column.first], value))
+                        out_values[column.second] = value;
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+void CMonitorSystem::output_netstat_stats(CMonitorOutputFrontend* pOutput, double elapsed_sec,
+    const uint64_t* new_values, const uint64_t* prev_values, OutputFields output_opts)
+{
+    double rates[NETSTAT_MAX];
+    for (unsigned int i = 0; i < NETSTAT_MAX; i++)
+        rates[i] = (new_values[i] >= prev_values[i]) ? (double)(new_values[i] - prev_values[i]) / elapsed_sec : 0;
+
+    switch (output_opts) {
+    case PF_NONE:
+        assert(0);
+        break;
+    case PF_ALL:
+        for (unsigned int i = 0; i < NETSTAT_MAX; i++)
+            pOutput->pdouble(g_netstat_output_names[i], rates[i]);
+        break;
+    case PF_USED_BY_CHART_SCRIPT_ONLY:
+        for (NetstatCounter i : { NETSTAT_TCP_ACTIVE_OPENS, NETSTAT_TCP_PASSIVE_OPENS, NETSTAT_TCP_ESTAB_RESETS,
+                 NETSTAT_TCP_RETRANS_SEGS, NETSTAT_TCP_LISTEN_OVERFLOWS, NETSTAT_TCP_LISTEN_DROPS,
+                 NETSTAT_UDP_IN_ERRORS, NETSTAT_UDP_RCVBUF_ERRORS })
+            pOutput->pdouble(g_netstat_output_names[i], rates[i]);
+        break;
+    }
+
+    // derived KPIs: the total rate of aborted connections and how much of the TCP traffic is made of retransmissions
+    double aborts = 0;
+    for (unsigned int i = NETSTAT_TCP_ABORT_ON_DATA; i <= NETSTAT_TCP_ABORT_ON_LINGER; i++)
+        aborts += rates[i];
+    pOutput->pdouble("tcp_aborts", aborts);
+    pOutput->pdouble("tcp_retrans_pct",
+        rates[NETSTAT_TCP_OUT_SEGS] > 0 ? 100 * rates[NETSTAT_TCP_RETRANS_SEGS] / rates[NETSTAT_TCP_OUT_SEGS] : 0);
+}
+
+void CMonitorSystem::sample_netstat(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETSTAT) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    uint64_t new_values[NETSTAT_MAX];
+    if (!read_netstat_stats(m_netstat, new_values)) {
+        CMonitorLogger::instance()->LogError("failed to read %s and %s",
+            m_netstat.files[NETSTAT_FILE_SNMP].get_file().c_str(),
+            m_netstat.files[NETSTAT_FILE_NETSTAT].get_file().c_str());
+        return;
+    }
+
+    if (output_opts != PF_NONE && m_netstat.prev_valid) {
+        m_pOutput->psection_start("proc_net_snmp");
+        output_netstat_stats(m_pOutput, elapsed_sec, new_values, m_netstat.prev_values, output_opts);
+        m_pOutput->psection_end();
+    }
+
+    // finally remember the last sampled stats:
+    memcpy(m_netstat.prev_values, new_values, sizeof(m_netstat.prev_values));
+    m_netstat.prev_valid = true;
+}
@@ -31,26 +31,12 @@
  */
 void CMonitorSystem::sample_net_dev(double elapsed_sec, OutputFields output_opts)
 {
-    static bool first_time = true;
-
     if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETWORK) == 0)
         return;
 
     DEBUGLOG_FUNCTION_START();
 
-    if (first_time) {
-        // here all network interfaces are considered even if DOWN: the reason is that later on they may become UP
-        // and in such case they will become interesting; to maintain all output samples identical over time,
-        // thus all network interfaces are considered
-        netdevices_map_t devices_and_addresses;
-        CMonitorSystem::get_net_dev_list(devices_and_addresses, false /* include_only_interfaces_up */);
-        for (auto entry : devices_and_addresses)
-            m_network_interfaces_up.insert(entry.first);
-
-        CMonitorLogger::instance()->LogDebug(
-            "Found %zu network interfaces to monitor\n", m_network_interfaces_up.size());
-        first_time = false;
-    }
+    update_monitored_net_devs();
 
     if (m_network_interfaces_up.empty())
         return; // this happens in e.g. Docker containers having no network
@@ -69,11 +55,14 @@ void CMonitorSystem::sample_net_dev(double elapsed_sec, OutputFields output_opts
     // clang-format on
 
     netinfo_map_t new_stats;
-    read_net_dev_stats("/proc/net/dev", m_network_interfaces_up, new_stats);
+    read_net_dev_stats(m_netlink_stats, m_net_dev, m_network_interfaces_up, new_stats);
+    if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETWORK_ETHTOOL)
+        read_ethtool_stats();
 
     if (output_opts != PF_NONE) {
         m_pOutput->psection_start("network_interfaces");
-        output_net_dev_stats(m_pOutput, elapsed_sec, new_stats, m_previous_netinfo, output_opts);
+        output_net_dev_stats(
+            m_pOutput, elapsed_sec, new_stats, m_previous_netinfo, output_opts, &m_ethtool_readers);
         m_pOutput->psection_end();
     }
 
@@ -81,6 +70,94 @@ void CMonitorSystem::sample_net_dev(double elapsed_sec, OutputFields output_opts
     m_previous_netinfo = new_stats;
 }
 
+static bool is_virtual_eth(const char* ifname)
+{
+    /* veth**** interfaces are not real/interesting interfaces... skip them */
+    return strncmp(ifname, "veth", 4) == 0;
+}
+
+void CMonitorSystem::update_monitored_net_devs()
+{
+    if (!m_network_interfaces_scanned) {
+        // here all network interfaces are considered even if DOWN: the reason is that later on they may become UP
+        // and in such case they will become interesting; to maintain all output samples identical over time,
+        // thus all network interfaces are considered
+        if (m_netlink_links.is_open()) {
+            for (const auto& link : m_netlink_links.get_links())
+                if (!is_virtual_eth(link.second.c_str()))
+                    m_network_interfaces_up.insert(link.second);
+        } else {
+            netdevices_map_t devices_and_addresses;
+            CMonitorSystem::get_net_dev_list(devices_and_addresses, false /* include_only_interfaces_up */);
+            for (auto entry : devices_and_addresses)
+                m_network_interfaces_up.insert(entry.first);
+        }
+
+        CMonitorLogger::instance()->LogDebug(
+            "Found %zu network interfaces to monitor\n", m_network_interfaces_up.size());
+        m_network_interfaces_scanned = true;
+        return;
+    }
+
+    if (!m_netlink_links.is_open())
+        return; // no way to track network interfaces created after startup
+
+    // PERFORMANCE NOTE: in the common case where no link has been created/removed/renamed, this is a single
+    // non-blocking recv() returning EAGAIN
+    std::vector<netlink_link_event_t> events;
+    if (!m_netlink_links.poll_link_events(events)) {
+        // some notifications were lost: resync with the complete list of links
+        m_network_interfaces_up.clear();
+        for (const auto& link : m_netlink_links.get_links())
+            if (!is_virtual_eth(link.second.c_str()))
+                m_network_interfaces_up.insert(link.second);
+
+        CMonitorLogger::instance()->LogDebug(
+            "Lost rtnetlink link notifications; now monitoring %zu network interfaces\n",
+            m_network_interfaces_up.size());
+        return;
+    }
+
+    for (const auto& ev : events) {
+        // the counters of a removed/renamed interface must not be used to compute the deltas of
+        // another interface that later gets the same name:
+        const char* gone_ifname = ev.removed ? ev.ifname : ev.prev_ifname;
+        if (gone_ifname[0] != '\0') {
+            m_network_interfaces_up.erase(gone_ifname);
+            m_previous_netinfo.erase(gone_ifname);
+            m_ethtool_readers.erase(gone_ifname);
+            CMonitorLogger::instance()->LogDebug("Stopped monitoring network interface '%s'\n", gone_ifname);
+        }
+
+        if (!ev.removed && !is_virtual_eth(ev.ifname)) {
+            m_network_interfaces_up.insert(ev.ifname);
+            CMonitorLogger::instance()->LogDebug("Started monitoring network interface '%s'\n", ev.ifname);
+        }
+    }
+}
+
+void CMonitorSystem::read_ethtool_stats()
+{
+    for (const auto& ifname : m_network_interfaces_up) {
+        auto it = m_ethtool_readers.find(ifname);
+        if (it == m_ethtool_readers.end()) {
+            // first time this interface is seen: resolve its ethtool string table just once; interfaces not
+            // supporting ethtool stats are remembered as invalid readers to avoid retrying at every sample
+            string_field_t name = { ifname.c_str(), ifname.size() };
+            it = m_ethtool_readers
+                     .emplace(std::piecewise_construct, std::forward_as_tuple(ifname), std::forward_as_tuple())
+                     .first;
+            if (m_pCfg->m_vecEthtoolInterfaces.empty()
+                || string_field_matches_any_prefix(name, m_pCfg->m_vecEthtoolInterfaces))
+                it->second.init(ifname, m_pCfg->m_vecEthtoolStats);
+        }
+
+        if (it->second.is_valid() && !it->second.read_stats())
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "failed to read ethtool stats of network interface '%s'", ifname.c_str());
+    }
+}
+
 /* static */
 bool CMonitorSystem::get_net_dev_list(netdevices_map_t& out_map, bool include_only_interfaces_up)
 {
@@ -101,8 +178,7 @@ bool CMonitorSystem::get_net_dev_list(netdevices_map_t& out_map, bool include_on
 
     for (ifaddrs_ptr = interfaces; ifaddrs_ptr != NULL; ifaddrs_ptr = ifaddrs_ptr->ifa_next) {
 
-        if (strncmp(ifaddrs_ptr->ifa_name, "veth", 4) == 0) {
-            /* veth**** interfaces are not real/interesting interfaces... skip them */
+        if (is_virtual_eth(ifaddrs_ptr->ifa_name)) {
             CMonitorLogger::instance()->LogDebug(
                 "skipping network device '%s' since it's a virtual ETH dev\n", ifaddrs_ptr->ifa_name);
             continue;
@@ -146,7 +222,7 @@ bool CMonitorSystem::get_net_dev_list(netdevices_map_t& out_map, bool include_on
 
 /* static */
 bool CMonitorSystem::read_net_dev_stats(
-    const std::string& filename, const std::set<std::string>& net_iface_whitelist, netinfo_map_t& out_stats)
+    FastFileReader& reader, const std::set<std::string>& net_iface_whitelist, netinfo_map_t& out_stats)
 {
     // clang-format off
     /*
@@ -161,57 +237,115 @@ bool CMonitorSystem::read_net_dev_stats(
     */
     // clang-format on
 
-    // FIXME: instead of doing a fopen() here we could take as arg both a FastFileReader and the filename ;
-    //        then we invoke the given FastFileReader set_file() and read from it: in best case if filename didn't
-    //        change we will save the operation of opening a new FD!
-    FILE* fp = 0;
-    if ((fp = fopen(filename.c_str(), "r")) == NULL) {
-        CMonitorLogger::instance()->LogErrorWithErrno("failed to open %s", filename.c_str());
+    if (!reader.open_or_rewind()) {
+        CMonitorLogger::instance()->LogErrorWithErrno("failed to open %s", reader.get_file().c_str());
         return false;
     }
 
-    char buf[1024];
-    if (fgets(buf, 1024, fp) == NULL) /* throw away the header line */
-        return false;
-    if (fgets(buf, 1024, fp) == NULL) /* throw away the header line */
+    // throw away the 2 header lines:
+    if (reader.get_next_line() == NULL || reader.get_next_line() == NULL)
         return false;
 
-    uint64_t junk;
-    while (fgets(buf, 1024, fp) != NULL) {
-        strip_spaces(buf);
-
-        char name[128];
-        netinfo_t current;
-        bzero(&current, sizeof(netinfo_t));
-        int ret = sscanf(&buf[0], "%s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-            name, // force newline
-            // input
-            &current.if_ibytes, &current.if_ipackets, &current.if_ierrs, &current.if_idrop, &current.if_ififo,
-            &current.if_iframe, &junk, &junk, // force newline
-            // output
-            &current.if_obytes, &current.if_opackets, &current.if_oerrs, &current.if_odrop, &current.if_ofifo,
-            &current.if_ocolls, &current.if_ocarrier);
-
-        if (ret != 16) {
-            CMonitorLogger::instance()->LogError("net sscanf wanted 16 returned = %d line=%s\n", ret, (char*)buf);
+    string_field_t fields[NET_DEV_NUM_COUNTERS];
+    for (const char* line = reader.get_next_line(); line; line = reader.get_next_line()) {
+        // the interface name is right-aligned and there might be no space between the colon and the first counter:
+        const char* colon = strchr(line, ':');
+        if (colon == NULL)
             continue;
-        }
+        while (*line == ' ')
+            line++;
+        std::string name(line, colon - line);
 
         // as fixed rule always discard the loopback device:
-        if (strncmp(name, "lo", 2) == 0)
+        if (strncmp(name.c_str(), "lo", 2) == 0)
+            continue;
+        if (!net_iface_whitelist.empty() && net_iface_whitelist.find(name) == net_iface_whitelist.end())
+            continue;
+
+        uint64_t values[NET_DEV_NUM_COUNTERS];
+        size_t nfields = split_fields_on_whitespace(colon + 1, fields, NET_DEV_NUM_COUNTERS);
+        size_t nvalues = 0;
+        while (nvalues < nfields && string_field2int(fields[nvalues], values[nvalues]))
+            nvalues++;
+        if (nvalues != NET_DEV_NUM_COUNTERS) {
+            CMonitorLogger::instance()->LogError("net dev wanted %d counters, found %zu for interface %s\n",
+                NET_DEV_NUM_COUNTERS, nvalues, name.c_str());
             continue;
+        }
 
-        if (net_iface_whitelist.empty() || net_iface_whitelist.find(name) != net_iface_whitelist.end())
-            // this interface is in the whitelist, store it:
-            out_stats[name] = current;
+        // this interface is in the whitelist, store it:
+        netinfo_t& current = out_stats[name];
+        // input
+        current.if_ibytes = values[0];
+        current.if_ipackets = values[1];
+        current.if_ierrs = values[2];
+        current.if_idrop = values[3];
+        current.if_ififo = values[4];
+        current.if_iframe = values[5];
+        // values[6] and values[7] are the compressed and multicast counters
+        // output
+        current.if_obytes = values[8];
+        current.if_opackets = values[9];
+        current.if_oerrs = values[10];
+        current.if_odrop = values[11];
+        current.if_ofifo = values[12];
+        current.if_ocolls = values[13];
+        current.if_ocarrier = values[14];
     }
 
     return !out_stats.empty();
 }
 
+/* static */
+bool CMonitorSystem::read_net_dev_stats(NetlinkStatsReader& netlink_reader, FastFileReader& fallback_reader,
+    const std::set<std::string>& net_iface_whitelist, netinfo_map_t& out_stats)
+{
+    if (netlink_reader.is_open()) {
+        if (netlink_reader.dump_link_stats()) {
+            for (const auto& link : netlink_reader.get_link_stats()) {
+                // as fixed rule always discard the loopback device:
+                if (link.ifname[0] == '\0' || strncmp(link.ifname, "lo", 2) == 0)
+                    continue;
+                if (!net_iface_whitelist.empty() && net_iface_whitelist.find(link.ifname) == net_iface_whitelist.end())
+                    continue;
+
+                // fill the stats with the same aggregations done by the kernel when producing /proc/net/dev
+                // (see dev_seq_printf_stats() in net/core/net-procfs.c) so that the two sources are interchangeable:
+                const struct rtnl_link_stats64& s = link.stats;
+                netinfo_t& current = out_stats[link.ifname];
+                current.if_ibytes = s.rx_bytes;
+                current.if_ipackets = s.rx_packets;
+                current.if_ierrs = s.rx_errors;
+                current.if_idrop = s.rx_dropped + s.rx_missed_errors;
+                current.if_ififo = s.rx_fifo_errors;
+                current.if_iframe = s.rx_length_errors + s.rx_over_errors + s.rx_crc_errors + s.rx_frame_errors;
+                current.if_obytes = s.tx_bytes;
+                current.if_opackets = s.tx_packets;
+                current.if_oerrs = s.tx_errors;
+                current.if_odrop = s.tx_dropped;
+                current.if_ofifo = s.tx_fifo_errors;
+                current.if_ocolls = s.collisions;
+                current.if_ocarrier
+                    = s.tx_carrier_errors + s.tx_aborted_errors + s.tx_window_errors + s.tx_heartbeat_errors;
+            }
+            return !out_stats.empty();
+        }
+
+        // e.g. kernel older than 4.7 without RTM_GETSTATS support: do not retry on next samples
+        CMonitorLogger::instance()->LogDebug(
+            "Failed to dump link stats via rtnetlink (%s); falling back to %s\n", strerror(errno),
+            fallback_reader.get_file().c_str());
+        netlink_reader.close();
+        out_stats.clear();
+    }
+
+    return read_net_dev_stats(fallback_reader, net_iface_whitelist, out_stats);
+}
+
 /* static */
 bool CMonitorSystem::output_net_dev_stats(CMonitorOutputFrontend* m_pOutput, double elapsed_sec,
-    const netinfo_map_t& new_stats, const netinfo_map_t& prev_stats, OutputFields output_opts)
+    const netinfo_map_t& new_stats, const netinfo_map_t& prev_stats, OutputFields output_opts,
+    const ethtool_readers_map_t* ethtool_stats)
 {
 #define DELTA_NET_STAT(member) ((double)(current.member - previous.member) / elapsed_sec)
 
@@ -257,6 +391,17 @@ bool CMonitorSystem::output_net_dev_stats(CMonitorOutputFrontend* m_pOutput, dou
             m_pOutput->plong("opackets", DELTA_NET_STAT(if_opackets));
             break;
         }
+
+        // NIC driver stats are opt-in and thus always emitted when available:
+        if (ethtool_stats) {
+            const auto it_ethtool = ethtool_stats->find(name);
+            if (it_ethtool != ethtool_stats->end() && it_ethtool->second.is_valid()
+                && it_ethtool->second.has_previous_stats()) {
+                const EthtoolStatsReader& reader = it_ethtool->second;
+                for (size_t i = 0; i < reader.get_num_selected_stats(); i++)
+                    m_pOutput->plong(reader.get_stat_name(i), (double)reader.get_stat_delta(i) / elapsed_sec);
+            }
+        }
         m_pOutput->psubsection_end();
     }
 
@@ -0,0 +1,218 @@
+/*
+ * system_pressure.cpp - code for collecting SYSTEM-level Pressure Stall Information (i.e. not cgroup-aware)
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logger.h"
+#include "output_frontend.h"
+#include "system.h"
+#include "utils_string.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+
+static const char* g_pressure_resource_names[PSI_MAX] = { "cpu", "memory", "io" };
+static const char* g_pressure_avg_names[2][3] = {
+    { "some_avg10", "some_avg60", "some_avg300" },
+    { "full_avg10", "full_avg60", "full_avg300" },
+};
+
+CMonitorSystem::~CMonitorSystem()
+{
+    for (unsigned int i = 0; i < PSI_MAX; i++) {
+        if (m_pressure[i].trigger_fd != -1)
+            close(m_pressure[i].trigger_fd);
+    }
+}
+
+void CMonitorSystem::init_pressure_triggers()
+{
+    /*
+        See https://www.kernel.org/doc/html/latest/accounting/psi.html#monitoring-for-pressure-thresholds
+        A trigger is registered by writing "<some|full> <stall amount in us> <time window in us>" into the
+        pressure file; then poll() returns POLLPRI when the stall amount is exceeded within the time window.
+        Each trigger needs its own file descriptor, distinct from the one used to read the pressure averages.
+    */
+    const std::string& trigger = m_pCfg->m_strPressureTrigger;
+    for (unsigned int i = 0; i < PSI_MAX; i++) {
+        pressure_resource_t& res = m_pressure[i];
+        const std::string& filename = res.reader.get_file();
+
+        int fd = open(filename.c_str(), O_RDWR | O_NONBLOCK);
+        if (fd == -1) {
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "failed to open %s for registering a PSI trigger", filename.c_str());
+            continue;
+        }
+        if (write(fd, trigger.c_str(), trigger.size() + 1) < 0) {
+            // e.g. EINVAL for a malformed trigger or for "full" on the cpu resource of kernels older than 5.13
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "failed to register PSI trigger '%s' on %s", trigger.c_str(), filename.c_str());
+            close(fd);
+            continue;
+        }
+
+        res.trigger_fd = fd;
+        m_pressure_triggers_active = true;
+        CMonitorLogger::instance()->LogDebug("Registered PSI trigger '%s' on %s\n", trigger.c_str(), filename.c_str());
+    }
+}
+
+unsigned int CMonitorSystem::get_pressure_trigger_pollfds(struct pollfd* fds)
+{
+    unsigned int nfds = 0;
+    for (unsigned int i = 0; i < PSI_MAX; i++) {
+        if (m_pressure[i].trigger_fd == -1)
+            continue;
+        fds[nfds].fd = m_pressure[i].trigger_fd;
+        fds[nfds].events = POLLPRI;
+        fds[nfds].revents = 0;
+        nfds++;
+    }
+    return nfds;
+}
+
+bool CMonitorSystem::check_pressure_trigger_pollfds(const struct pollfd* fds, unsigned int nfds)
+{
+    bool fired = false;
+    for (unsigned int n = 0; n < nfds; n++) {
+        for (unsigned int i = 0; i < PSI_MAX; i++) {
+            pressure_resource_t& res = m_pressure[i];
+            if (res.trigger_fd == -1 || res.trigger_fd != fds[n].fd)
+                continue;
+            if (fds[n].revents & POLLPRI) {
+                res.triggered = true;
+                fired = true;
+            }
+            if (fds[n].revents & POLLERR) {
+                // the pressure file is gone: stop watching it to avoid a busy loop
+                CMonitorLogger::instance()->LogError(
+                    "PSI trigger on %s failed; disabling it", res.reader.get_file().c_str());
+                close(res.trigger_fd);
+                res.trigger_fd = -1;
+            }
+        }
+    }
+    return fired;
+}
+
+bool CMonitorSystem::read_pressure_stats(FastFileReader& reader, pressure_stats_t* out_stats)
+{
+    // clang-format off
+    /*
+        both /proc/pressure/<resource> and the cgroup v2 <resource>.pressure files have a format like:
+
+            some avg10=6.42 avg60=3.93 avg300=2.36 total=48948148
+            full avg10=1.49 avg60=0.92 avg300=0.45 total=8736467
+
+        where the "avg" fields are percentages and "total" is the cumulative stall time in usecs
+    */
+    // clang-format on
+
+    if (!reader.open_or_rewind())
+        return false;
+
+    string_field_t fields[5];
+    for (const char* line = reader.get_next_line(); line; line = reader.get_next_line()) {
+        if (split_fields_on_whitespace(line, fields, 5) != 5 || fields[0].len != 4)
+            continue;
+
+        pressure_stats_t* stats;
+        if (strncmp(fields[0].ptr, "some", 4) == 0)
+            stats = &out_stats[PSI_SOME];
+        else if (strncmp(fields[0].ptr, "full", 4) == 0)
+            stats = &out_stats[PSI_FULL];
+        else
+            continue;
+
+        // fields 1-3 are always avg10=<pct> avg60=<pct> avg300=<pct>:
+        for (unsigned int f = 1; f <= 3; f++) {
+            const char* eq = (const char*)memchr(fields[f].ptr, '=', fields[f].len);
+            stats->avg[f - 1] = eq ? strtod(eq + 1, NULL) : 0;
+        }
+
+        // field 4 is total=<usecs>:
+        if (fields[4].len <= 6 || strncmp(fields[4].ptr, "total=", 6) != 0)
+            continue;
+        string_field_t total = { fields[4].ptr + 6, fields[4].len - 6 };
+        stats->valid = string_field2int(total, stats->total_us);
+    }
+    return true;
+}
+
+void CMonitorSystem::output_pressure_stats(CMonitorOutputFrontend* pOutput, double elapsed_sec,
+    const pressure_stats_t* new_stats, const pressure_stats_t* prev_stats, OutputFields output_opts)
+{
+    static const char* stall_pct_names[PSI_LINE_MAX] = { "some_stall_pct", "full_stall_pct" };
+
+    for (unsigned int l = 0; l < PSI_LINE_MAX; l++) {
+        const pressure_stats_t& current = new_stats[l];
+        const pressure_stats_t& previous = prev_stats[l];
+        if (!current.valid)
+            continue; // e.g. "full" line is missing for the cpu resource on kernels older than 5.13
+
+        if (output_opts == PF_ALL) {
+            for (unsigned int a = 0; a < 3; a++)
+                pOutput->pdouble(g_pressure_avg_names[l][a], current.avg[a]);
+        }
+
+        // the stall percentage computed from "total" covers exactly the sampling interval and has better
+        // resolution than the kernel averages, which use fixed 10/60/300sec windows:
+        if (previous.valid && current.total_us >= previous.total_us)
+            pOutput->pdouble(
+                stall_pct_names[l], (double)(current.total_us - previous.total_us) / elapsed_sec / 1e4);
+    }
+}
+
+/*
+ read /proc/pressure/cpu, /proc/pressure/memory and /proc/pressure/io
+ */
+void CMonitorSystem::sample_pressure(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_PRESSURE) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_start("pressure");
+
+    for (unsigned int i = 0; i < PSI_MAX; i++) {
+        pressure_resource_t& res = m_pressure[i];
+        pressure_stats_t new_values[PSI_LINE_MAX];
+        if (!read_pressure_stats(res.reader, new_values)) {
+            // PSI is available only on kernels 4.20+ built with CONFIG_PSI and not booted with psi=0
+            CMonitorLogger::instance()->LogDebug("failed to re-open %s", res.reader.get_file().c_str());
+            continue;
+        }
+
+        if (output_opts != PF_NONE) {
+            m_pOutput->psubsection_start(g_pressure_resource_names[i]);
+            output_pressure_stats(m_pOutput, elapsed_sec, new_values, res.prev_values, output_opts);
+            if (res.trigger_fd != -1)
+                m_pOutput->plong("triggered", res.triggered ? 1 : 0);
+            m_pOutput->psubsection_end();
+        }
+        res.triggered = false;
+
+        // finally remember the last sampled stats:
+        memcpy(res.prev_values, new_values, sizeof(res.prev_values));
+    }
+
+    if (output_opts != PF_NONE)
+        m_pOutput->psection_end();
+}
@@ -0,0 +1,224 @@
+/*
+ * system_softnet.cpp - code for collecting SYSTEM-level per-CPU packet processing statistics (i.e. not cgroup-aware)
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logger.h"
+#include "output_frontend.h"
+#include "system.h"
+#include "utils_misc.h"
+#include "utils_string.h"
+#include <assert.h>
+
+// /proc/net/softnet_stat contains one line per online CPU with hexadecimal counters; the number of columns
+// depends on the kernel version: see softnet_seq_show() in net/core/net-procfs.c
+#define SOFTNET_FIELD_PROCESSED (0)
+#define SOFTNET_FIELD_DROPPED (1)
+#define SOFTNET_FIELD_TIME_SQUEEZE (2)
+#define SOFTNET_FIELD_RECEIVED_RPS (9) // kernel 2.6.35+
+#define SOFTNET_FIELD_CPU_INDEX (12) // kernel 5.10+; older kernels simply skip offline CPUs
+#define SOFTNET_MAX_FIELDS (16)
+
+static uint64_t string_field2hex(const string_field_t& field)
+{
+    // fields are always followed by a whitespace or by the end of the line, so strtoull() stops there:
+    return strtoull(field.ptr, NULL, 16);
+}
+
+bool CMonitorSystem::read_softnet_stats(softnet_cpu_stats_t* new_values)
+{
+    // clang-format off
+    /*
+        /proc/net/softnet_stat has a format like:
+
+            00ac37b6 00000000 00000012 00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000 00000000
+            0091d1a3 00000000 00000007 00000000 00000000 00000000 00000000 00000000 00000000 000001b2 00000000 00000000 00000001
+
+        /proc/softirqs has a format like:
+
+                                CPU0       CPU1
+                      HI:          0          0
+                   TIMER:    1325862    1167286
+                  NET_TX:        150        197
+                  NET_RX:     431022     389103
+    */
+    // clang-format on
+
+    string_field_t fields[MAX_LOGICAL_CPU + 1];
+
+    if (!m_softnet_stat.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_softnet_stat.get_file().c_str());
+        return false;
+    }
+
+    unsigned int line_idx = 0;
+    const char* line = m_softnet_stat.get_next_line();
+    for (; line; line = m_softnet_stat.get_next_line(), line_idx++) {
+        size_t nfields = split_fields_on_whitespace(line, fields, SOFTNET_MAX_FIELDS);
+        if (nfields <= SOFTNET_FIELD_TIME_SQUEEZE)
+            continue;
+
+        uint64_t cpu = (nfields > SOFTNET_FIELD_CPU_INDEX) ? string_field2hex(fields[SOFTNET_FIELD_CPU_INDEX])
+                                                            : line_idx;
+        if (cpu >= MAX_LOGICAL_CPU)
+            continue;
+
+        softnet_cpu_stats_t& current = new_values[cpu];
+        current.valid = true;
+        current.processed = string_field2hex(fields[SOFTNET_FIELD_PROCESSED]);
+        current.dropped = string_field2hex(fields[SOFTNET_FIELD_DROPPED]);
+        current.time_squeeze = string_field2hex(fields[SOFTNET_FIELD_TIME_SQUEEZE]);
+        if (nfields > SOFTNET_FIELD_RECEIVED_RPS)
+            current.received_rps = string_field2hex(fields[SOFTNET_FIELD_RECEIVED_RPS]);
+    }
+
+    if (!m_softirqs.open_or_rewind()) {
+        CMonitorLogger::instance()->LogError("failed to re-open %s", m_softirqs.get_file().c_str());
+        return false;
+    }
+
+    // the header line provides the CPU index of each column:
+    unsigned int column2cpu[MAX_LOGICAL_CPU];
+    line = m_softirqs.get_next_line();
+    if (!line)
+        return false;
+    size_t ncolumns = split_fields_on_whitespace(line, fields, MAX_LOGICAL_CPU);
+    for (size_t i = 0; i < ncolumns; i++) {
+        uint64_t cpu = MAX_LOGICAL_CPU;
+        if (fields[i].len > 3 && strncmp(fields[i].ptr, "CPU", 3) == 0)
+            cpu = strtoull(fields[i].ptr + 3, NULL, 10);
+        column2cpu[i] = (unsigned int)cpu;
+    }
+
+    unsigned int rows_found = 0;
+    for (line = m_softirqs.get_next_line(); line && rows_found < 2; line = m_softirqs.get_next_line()) {
+        size_t nfields = split_fields_on_whitespace(line, fields, MAX_LOGICAL_CPU + 1);
+        if (nfields < 2)
+            continue;
+
+        bool is_net_rx = (fields[0].len == 7 && strncmp(fields[0].ptr, "NET_RX:", 7) == 0);
+        bool is_net_tx = (fields[0].len == 7 && strncmp(fields[0].ptr, "NET_TX:", 7) == 0);
+        if (!is_net_rx && !is_net_tx)
+            continue;
+
+        for (size_t i = 1; i < nfields && i - 1 < ncolumns; i++) {
+            unsigned int cpu = column2cpu[i - 1];
+            if (cpu >= MAX_LOGICAL_CPU)
+                continue;
+
+            uint64_t value = 0;
+            string_field2int(fields[i], value);
+            if (is_net_rx)
+                new_values[cpu].net_rx_softirqs = value;
+            else
+                new_values[cpu].net_tx_softirqs = value;
+        }
+        rows_found++;
+    }
+
+    return true;
+}
+
+/*
+ read /proc/net/softnet_stat and /proc/softirqs
+ */
+void CMonitorSystem::sample_softnet_stats(double elapsed_sec, OutputFields output_opts)
+{
+    if ((m_pCfg->m_nCollectFlags & PK_BAREMETAL_SOFTNET) == 0)
+        return;
+
+    DEBUGLOG_FUNCTION_START();
+
+    softnet_cpu_stats_t new_values[MAX_LOGICAL_CPU] = {};
+    if (!read_softnet_stats(new_values))
+        return;
+
+    if (output_opts != PF_NONE) {
+        // host-level summary, computed only over the monitored CPUs:
+        double total_processed = 0, total_dropped = 0, total_time_squeeze = 0, total_net_rx = 0;
+        double max_processed = 0, max_net_rx = 0;
+        int max_processed_cpu = -1;
+        unsigned int num_cpus = 0;
+
+        m_pOutput->psection_start("softnet");
+        for (int i = 0; i < MAX_LOGICAL_CPU; i++) {
+            const softnet_cpu_stats_t& current = new_values[i];
+            const softnet_cpu_stats_t& previous = m_softnet_prev_values[i];
+            if (!current.valid || !previous.valid || !is_monitored_cpu(i))
+                continue;
+
+            // all these counters are 32-bit wide in the kernel, so they may wrap around on busy hosts:
+#define DELTA_SOFTNET_STAT(member) ((double)counter32_delta(current.member, previous.member) / elapsed_sec)
+
+            double processed = DELTA_SOFTNET_STAT(processed);
+            double net_rx = DELTA_SOFTNET_STAT(net_rx_softirqs);
+
+            m_pOutput->psubsection_start(fmt::format("cpu{:d}", i).c_str());
+            switch (output_opts) {
+            case PF_NONE:
+                assert(0);
+                break;
+            case PF_ALL:
+                m_pOutput->pdouble("processed", processed);
+                m_pOutput->pdouble("dropped", DELTA_SOFTNET_STAT(dropped));
+                m_pOutput->pdouble("time_squeeze", DELTA_SOFTNET_STAT(time_squeeze));
+                m_pOutput->pdouble("received_rps", DELTA_SOFTNET_STAT(received_rps));
+                m_pOutput->pdouble("net_rx_softirqs", net_rx);
+                m_pOutput->pdouble("net_tx_softirqs", DELTA_SOFTNET_STAT(net_tx_softirqs));
+                break;
+            case PF_USED_BY_CHART_SCRIPT_ONLY:
+                m_pOutput->pdouble("processed", processed);
+                m_pOutput->pdouble("dropped", DELTA_SOFTNET_STAT(dropped));
+                m_pOutput->pdouble("time_squeeze", DELTA_SOFTNET_STAT(time_squeeze));
+                break;
+            }
+            m_pOutput->psubsection_end();
+
+            total_processed += processed;
+            total_dropped += DELTA_SOFTNET_STAT(dropped);
+            total_time_squeeze += DELTA_SOFTNET_STAT(time_squeeze);
+            total_net_rx += net_rx;
+            if (max_processed_cpu == -1 || processed > max_processed) {
+                max_processed = processed;
+                max_processed_cpu = i;
+            }
+            if (net_rx > max_net_rx)
+                max_net_rx = net_rx;
+            num_cpus++;
+        }
+
+        if (num_cpus > 0) {
+            // the imbalance is the ratio between the busiest CPU and the average: 1 means perfectly balanced,
+            // N (the number of CPUs) means that a single CPU is doing all the work; 0 means no traffic at all
+            double avg_processed = total_processed / num_cpus;
+            double avg_net_rx = total_net_rx / num_cpus;
+
+            m_pOutput->psubsection_start("summary");
+            m_pOutput->pdouble("processed", total_processed);
+            m_pOutput->pdouble("dropped", total_dropped);
+            m_pOutput->pdouble("time_squeeze", total_time_squeeze);
+            m_pOutput->plong("processed_max_cpu", max_processed_cpu);
+            m_pOutput->pdouble("processed_imbalance", avg_processed > 0 ? max_processed / avg_processed : 0);
+            m_pOutput->pdouble("net_rx_softirqs_imbalance", avg_net_rx > 0 ? max_net_rx / avg_net_rx : 0);
+            m_pOutput->psubsection_end();
+        }
+        m_pOutput->psection_end();
+    }
+
+    // finally remember the last sampled stats:
+    memcpy(m_softnet_prev_values, new_values, sizeof(m_softnet_prev_values));
+}
@@ -88,7 +88,9 @@ void run_cmonitor_on_tarball_samples( // fn
     const std::string& test_name, const std::string& kernel_under_test, const std::string& cgroup_name,
     bool include_threads, unsigned int nsamples, uint64_t simulated_cmonitor_collector_pid,
     /* expected */
-    CGroupDetected expected_cgroup_ver = CG_VERSION1, uint64_t num_logged_errors = 0)
+    CGroupDetected expected_cgroup_ver = CG_VERSION1, uint64_t num_logged_errors = 0,
+    /* optional stats */
+    unsigned int extra_collect_flags = 0)
 {
     // reset number of logged errors to keep each gtest isolated
     CMonitorLogger::instance()->reset_num_errors();
@@ -102,6 +104,7 @@ void run_cmonitor_on_tarball_samples( // fn
     CMonitorCollectorAppConfig cfg;
     cfg.m_strCGroupName = cgroup_name;
     cfg.m_nProcessScoreThreshold = 0;
+    cfg.m_nCollectFlags |= extra_collect_flags;
 
     CMonitorLogger::instance()->enable_debug();
     CMonitorLogger::instance()->init_error_output_file("stdout");
@@ -143,10 +146,16 @@ void run_cmonitor_on_tarball_samples( // fn
         actual_output.psample_start();
         t.sample_cpuacct(elapsed_sec);
         t.sample_memory(allowedStats, allowedStats);
+        t.sample_pids(cfg.m_nOutputFields);
+        t.sample_hugetlb(cfg.m_nOutputFields);
+        t.sample_blkio(elapsed_sec, cfg.m_nOutputFields);
+        t.sample_pressure(elapsed_sec, cfg.m_nOutputFields);
 
         t.sample_process_list();
         t.sample_processes(elapsed_sec, cfg.m_nOutputFields);
         t.sample_network_interfaces(elapsed_sec, cfg.m_nOutputFields);
+        t.sample_tcp(cfg.m_nOutputFields);
+        t.sample_netstat(elapsed_sec, cfg.m_nOutputFields);
 
         actual_output.push_current_sample();
         prev_ts = curr_ts;
@@ -198,7 +207,7 @@ TEST(CGroups, centos7_Linux_3_10_0_docker_withthreads)
         4 /* nsamples */, 1232906 /* simulated_cmonitor_collector_pid: in reality it's the PID of a REDIS but fits just
                                      fine our testing purposes */
         ,
-        CG_VERSION1);
+        CG_VERSION1, 0 /* num_logged_errors */, PK_CGROUP_MEMORY_EXT);
 }
 
 // systemd
@@ -248,7 +257,7 @@ TEST(CGroups, ubuntu2004_Linux_5_4_0_docker_withthreads)
         4 /* nsamples */, 2063 /* simulated_cmonitor_collector_pid: in reality it's the PID of a REDIS but fits just
                                   fine our testing purposes */
         ,
-        CG_VERSION1);
+        CG_VERSION1, 0 /* num_logged_errors */, PK_CGROUP_HUGETLB);
 }
 
 // systemd
@@ -293,7 +302,8 @@ TEST(CGroups, fedora35_Linux_5_14_17_docker_withthreads)
         "fedora35-Linux-5.14.17-x86_64-docker", // force newline
         "system.slice/docker-3cfe7ca058f43dbb15a6cc68c472978a14c93fd7e263384dd0a1fa1517f6d7f0.scope/",
         true /* with threads */, 4 /* nsamples */,
-        3834 /* pid of a process inside the docker to correctly autodetect the cgroups v2 */, CG_VERSION2);
+        3834 /* pid of a process inside the docker to correctly autodetect the cgroups v2 */, CG_VERSION2,
+        0 /* num_logged_errors */, PK_CGROUP_MEMORY_EXT | PK_CGROUP_PIDS | PK_CGROUP_HUGETLB | PK_CGROUP_PRESSURE);
 }
 
 TEST(CGroups, fedora35_Linux_5_14_17_systemd_nothreads)
@@ -316,3 +326,248 @@ TEST(CGroups, fedora35_Linux_5_14_17_systemd_withthreads)
                 purposes */
         CG_VERSION2, 2 /* num_logged_errors: absence of cpu.max and cpuset.cpus */);
 }
+
+//------------------------------------------------------------------------------
+// unit tests on the walk of a tree of cgroups
+//------------------------------------------------------------------------------
+
+void write_fake_cgroup(const std::string& dir, uint64_t usage_usec, uint64_t memory_current)
+{
+    mkdir(dir.c_str(), 0755);
+    write_file_string(dir + "/cpu.stat",
+        fmt::format("usage_usec {}\nuser_usec {}\nsystem_usec 0\nnr_periods 0\n", usage_usec, usage_usec));
+    write_file_string(dir + "/memory.current", fmt::format("{}\n", memory_current));
+    write_file_string(dir + "/io.stat", "8:0 rbytes=1000 wbytes=0 rios=1 wios=0 dbytes=0 dios=0\n");
+}
+
+TEST(CGroupTree, walk_with_new_and_removed_cgroups)
+{
+    char tmpl[] = "/tmp/cmonitor-cgroup-tree-XXXXXX";
+    ASSERT_TRUE(mkdtemp(tmpl) != NULL);
+    std::string root = tmpl;
+    std::string result_json_file = root + "/result.json";
+
+    // fake cgroup v2 tree: root -> a -> a/b
+    write_fake_cgroup(root + "/a", 1000000, 4096);
+    write_fake_cgroup(root + "/a/b", 200000, 1024);
+
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_nCollectFlags = PK_CGROUP_TREE;
+    cfg.m_nOutputFields = PF_ALL;
+    CMonitorOutputFrontend actual_output(result_json_file);
+
+    CMonitorCgroupTree t(&cfg, &actual_output);
+    t.init(root);
+    t.sample(0, PF_NONE);
+    ASSERT_EQ(t.get_num_nodes(), 3U);
+
+    // one second later: "a" used 0.5sec of CPU, half of which in "a/b"; "a/b/c" was created
+    write_fake_cgroup(root + "/a", 1500000, 4096);
+    write_fake_cgroup(root + "/a/b", 450000, 1024);
+    write_fake_cgroup(root + "/a/b/c", 0, 0);
+
+    actual_output.pheader_start();
+    actual_output.push_header();
+    actual_output.psample_array_start();
+    actual_output.psample_start();
+    t.sample(1.0, PF_ALL);
+    actual_output.push_current_sample();
+    actual_output.psample_array_end();
+    actual_output.close();
+    ASSERT_EQ(t.get_num_nodes(), 4U);
+
+    std::string result_json_str = get_file_string(result_json_file);
+    ASSERT_NE(result_json_str.find("\"a\": {\"depth\": 1,\"cpu_usage_pct\": 50.000"), std::string::npos);
+    ASSERT_NE(result_json_str.find("\"cpu_self_pct\": 25.000"), std::string::npos);
+    ASSERT_NE(result_json_str.find("\"a/b\": {\"depth\": 2,\"cpu_usage_pct\": 25.000"), std::string::npos);
+    ASSERT_EQ(result_json_str.find("\"a/b/c\""), std::string::npos); // new cgroups have no deltas yet
+
+    // removal of a whole subtree
+    std::string cmd = "rm -rf " + root + "/a/b";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+    t.sample(0, PF_NONE);
+    ASSERT_EQ(t.get_num_nodes(), 2U);
+
+    cmd = "rm -rf " + root;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+}
+
+//------------------------------------------------------------------------------
+// unit tests on event samples
+//------------------------------------------------------------------------------
+
+std::string copy_sample_to_tmp_dir(const std::string& kernel_under_test)
+{
+    // copy the unit test data into a temporary folder, which can be freely modified by the test
+    uint64_t unused_ts;
+    prepare_sample_dir(kernel_under_test, 1, unused_ts);
+    char tmpl[] = "/tmp/cmonitor-cgroup-events-XXXXXX";
+    if (mkdtemp(tmpl) == NULL)
+        return "";
+    std::string root = tmpl;
+    std::string cmd = "cp -a " + get_unit_test_abs_dir() + kernel_under_test + "/current-sample/. " + root;
+    if (system(cmd.c_str()) != 0)
+        return "";
+    return root;
+}
+
+void touch_memory_events(const std::string& file, uint64_t num_high_events)
+{
+    write_file_string(file, fmt::format("low 0\nhigh {}\nmax 0\noom 0\noom_kill 0\n", num_high_events));
+}
+
+TEST(CGroupsSet, event_samples_spacing)
+{
+    const std::string kernel_under_test = "fedora35-Linux-5.14.17-x86_64-docker";
+    const std::string cgroup_name
+        = "system.slice/docker-3cfe7ca058f43dbb15a6cc68c472978a14c93fd7e263384dd0a1fa1517f6d7f0.scope";
+
+    std::string root = copy_sample_to_tmp_dir(kernel_under_test);
+    ASSERT_FALSE(root.empty());
+    std::string memory_events_file = root + "/sys/fs/cgroup/" + cgroup_name + "/memory.events";
+
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_strCGroupName = cgroup_name;
+    cfg.m_nSamplingIntervalMsec = 500;
+    CMonitorOutputFrontend actual_output(root + "/result.json");
+
+    CMonitorCgroupsSet t(&cfg, &actual_output);
+    t.init(false /* no threads */, root, root, 3834 /* pid of a process inside the docker */);
+    ASSERT_TRUE(t.init_event_watches());
+    ASSERT_FALSE(t.read_events());
+
+    std::set<std::string> allowedStats;
+    actual_output.pheader_start();
+    actual_output.push_header();
+    actual_output.psample_array_start();
+
+    // the first memory.high breach triggers an event sample
+    touch_memory_events(memory_events_file, 1);
+    ASSERT_TRUE(t.read_events());
+    actual_output.psample_start();
+    t.sample_memory_events(allowedStats, allowedStats, PF_ALL);
+    actual_output.push_current_sample();
+
+    // further breaches within the same sampling interval do not
+    touch_memory_events(memory_events_file, 2);
+    ASSERT_FALSE(t.read_events());
+    touch_memory_events(memory_events_file, 3);
+    ASSERT_FALSE(t.read_events());
+
+    // once a whole sampling interval has elapsed since the last event sample, a new one can be taken
+    usleep((cfg.m_nSamplingIntervalMsec + 100) * 1000);
+    touch_memory_events(memory_events_file, 4);
+    ASSERT_TRUE(t.read_events());
+    actual_output.psample_start();
+    t.sample_memory_events(allowedStats, allowedStats, PF_ALL);
+    actual_output.push_current_sample();
+
+    actual_output.psample_array_end();
+    actual_output.close();
+
+    // both event samples report the cgroup memory stats
+    std::string result_json_str = get_file_string(root + "/result.json");
+    size_t first = result_json_str.find("\"cgroup_memory_stats\"");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_NE(result_json_str.find("\"cgroup_memory_stats\"", first + 1), std::string::npos);
+
+    std::string cmd = "rm -rf " + root;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+}
+
+TEST(CGroupsSet, liveness_of_initially_empty_cgroup)
+{
+    const std::string kernel_under_test = "fedora35-Linux-5.14.17-x86_64-docker";
+    const std::string cgroup_name
+        = "system.slice/docker-3cfe7ca058f43dbb15a6cc68c472978a14c93fd7e263384dd0a1fa1517f6d7f0.scope";
+
+    std::string root = copy_sample_to_tmp_dir(kernel_under_test);
+    ASSERT_FALSE(root.empty());
+    std::string cgroup_events_file = root + "/sys/fs/cgroup/" + cgroup_name + "/cgroup.events";
+
+    // the cgroup has no process yet when monitoring starts
+    write_file_string(cgroup_events_file, "populated 0\nfrozen 0\n");
+
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_strCGroupName = cgroup_name;
+    CMonitorOutputFrontend actual_output(root + "/result.json");
+
+    CMonitorCgroupsSet t(&cfg, &actual_output);
+    t.init(false /* no threads */, root, root, 3834 /* pid of a process inside the docker */);
+    ASSERT_TRUE(t.init_liveness_watches());
+    ASSERT_TRUE(t.cgroup_still_exists());
+
+    // an empty cgroup is alive until it gets populated and then empty again
+    write_file_string(cgroup_events_file, "populated 0\nfrozen 1\n");
+    t.read_events();
+    ASSERT_TRUE(t.cgroup_still_exists());
+    write_file_string(cgroup_events_file, "populated 1\nfrozen 0\n");
+    t.read_events();
+    ASSERT_TRUE(t.cgroup_still_exists());
+    write_file_string(cgroup_events_file, "populated 0\nfrozen 0\n");
+    t.read_events();
+    ASSERT_FALSE(t.cgroup_still_exists());
+
+    std::string cmd = "rm -rf " + root;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+}
+
+TEST(CGroupsSet, discovery_of_new_cgroup)
+{
+    const std::string kernel_under_test = "fedora35-Linux-5.14.17-x86_64-docker";
+    const std::string existing_cgroup
+        = "system.slice/docker-3cfe7ca058f43dbb15a6cc68c472978a14c93fd7e263384dd0a1fa1517f6d7f0.scope";
+    const std::string new_cgroup = "system.slice/new.scope";
+
+    std::string root = copy_sample_to_tmp_dir(kernel_under_test);
+    ASSERT_FALSE(root.empty());
+
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_strCGroupDiscoveryRoot = "system.slice";
+    cfg.m_nCollectFlags = PK_CGROUP_CPU_ACCT;
+    CMonitorOutputFrontend actual_output(root + "/result.json");
+
+    CMonitorCgroupsSet t(&cfg, &actual_output);
+    t.init(false /* no threads */, root, root, 3834 /* pid of a process inside the docker */);
+    t.sample_bootstrap();
+
+    actual_output.pheader_start();
+    actual_output.push_header();
+    actual_output.psample_array_start();
+
+    // a new cgroup appears in the middle of a sample: it gets discovered only after the end of the sample
+    actual_output.psample_start();
+    t.sample_cpuacct(1.0);
+    std::string cmd
+        = "cp -a " + root + "/sys/fs/cgroup/" + existing_cgroup + " " + root + "/sys/fs/cgroup/" + new_cgroup;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+    actual_output.push_current_sample();
+    t.discover_cgroups();
+
+    // during the next sampling interval the new cgroup uses 25% of a CPU in user mode
+    write_file_string(root + "/sys/fs/cgroup/" + new_cgroup + "/cpu.stat",
+        "usage_usec 301477\nuser_usec 270543\nsystem_usec 30934\nnr_periods 8\nnr_throttled 0\nthrottled_usec 0\n");
+    actual_output.psample_start();
+    t.sample_cpuacct(1.0);
+    actual_output.push_current_sample();
+
+    actual_output.psample_array_end();
+    actual_output.close();
+
+    // the new cgroup appears only in the second sample, whose rates cover the whole interval since its discovery
+    std::string result_json_str = get_file_string(root + "/result.json");
+    size_t first_sample = result_json_str.find("\"cgroup_cpuacct_stats:" + existing_cgroup + "\"");
+    ASSERT_NE(first_sample, std::string::npos);
+    size_t second_sample = result_json_str.find("\"cgroup_cpuacct_stats:" + existing_cgroup + "\"", first_sample + 1);
+    ASSERT_NE(second_sample, std::string::npos);
+    size_t new_cgroup_stats = result_json_str.find("\"cgroup_cpuacct_stats:" + new_cgroup + "\"");
+    ASSERT_NE(new_cgroup_stats, std::string::npos);
+    ASSERT_GT(new_cgroup_stats, second_sample);
+    const std::string expected_cpu = "\"cpu_tot\": {\"user\": 25.000,\"sys\": 0.000}";
+    size_t new_cgroup_cpu = result_json_str.find("\"cpu_tot\"", new_cgroup_stats);
+    ASSERT_NE(new_cgroup_cpu, std::string::npos);
+    ASSERT_EQ(new_cgroup_cpu, result_json_str.find(expected_cpu, new_cgroup_stats));
+
+    cmd = "rm -rf " + root;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+}
@@ -53,3 +53,35 @@ TEST(FastFileReader, read_multiple_times)
         usleep(50000);
     }
 }
+
+TEST(FastFileReader, streaming_large_file)
+{
+    // generate a file much larger than FAST_FILE_READER_MAX_FILE_SIZE with lines of different lengths:
+    const char* filename = "/tmp/cmonitor_fast_file_reader_test.txt";
+    FILE* fp = fopen(filename, "w");
+    ASSERT_TRUE(fp != NULL);
+    const unsigned int num_lines = 5000;
+    for (unsigned int i = 0; i < num_lines; i++)
+        fprintf(fp, "%u %s\n", i, std::string(i % 97, 'x').c_str());
+    fclose(fp);
+
+    FastFileReader r(filename);
+    ASSERT_FALSE(r.open_or_rewind()); // too large to be cached entirely
+
+    r.set_streaming_mode(true);
+    for (unsigned int j = 0; j < 2; j++) {
+        ASSERT_TRUE(r.open_or_rewind());
+
+        unsigned int nlines = 0;
+        const char* p = r.get_next_line();
+        while (p) {
+            // each line must be complete even if it was split across two chunks:
+            ASSERT_EQ(std::string(p), std::to_string(nlines) + " " + std::string(nlines % 97, 'x'));
+            p = r.get_next_line();
+            nlines++;
+        }
+        ASSERT_EQ(nlines, num_lines);
+    }
+
+    unlink(filename);
+}
@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+// GTest for NetlinkStatsReader and NetlinkLinkMonitor
+//------------------------------------------------------------------------------
+
+#include "../netlink_reader.h"
+#include "../system.h"
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// NetlinkStatsReader
+//------------------------------------------------------------------------------
+TEST(NetlinkStatsReader, same_interfaces_as_proc_net_dev)
+{
+    NetlinkStatsReader r;
+    ASSERT_TRUE(r.open());
+
+    std::set<std::string> empty_whitelist;
+    netinfo_map_t proc_stats;
+    FastFileReader net_dev("/proc/net/dev");
+    net_dev.set_streaming_mode(true);
+    CMonitorSystem::read_net_dev_stats(net_dev, empty_whitelist, proc_stats);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        ASSERT_TRUE(r.dump_link_stats());
+
+        // each interface listed in /proc/net/dev must be found also via rtnetlink, with a name:
+        std::set<std::string> netlink_ifaces;
+        for (const auto& link : r.get_link_stats()) {
+            ASSERT_NE(link.ifname[0], '\0');
+            netlink_ifaces.insert(link.ifname);
+        }
+        for (const auto& it : proc_stats)
+            ASSERT_TRUE(netlink_ifaces.find(it.first) != netlink_ifaces.end());
+        ASSERT_FALSE(netlink_ifaces.empty());
+    }
+}
+
+//------------------------------------------------------------------------------
+// NetlinkLinkMonitor
+//------------------------------------------------------------------------------
+TEST(NetlinkLinkMonitor, initial_links_and_no_spurious_events)
+{
+    NetlinkLinkMonitor m;
+    ASSERT_TRUE(m.open());
+
+    std::set<std::string> empty_whitelist;
+    netinfo_map_t proc_stats;
+    FastFileReader net_dev("/proc/net/dev");
+    net_dev.set_streaming_mode(true);
+    CMonitorSystem::read_net_dev_stats(net_dev, empty_whitelist, proc_stats);
+
+    std::set<std::string> links;
+    for (const auto& it : m.get_links())
+        links.insert(it.second);
+    for (const auto& it : proc_stats)
+        ASSERT_TRUE(links.find(it.first) != links.end());
+
+    // nothing has changed since the initial dump: draining must not block and must return no event
+    std::vector<netlink_link_event_t> events;
+    ASSERT_TRUE(m.poll_link_events(events));
+    ASSERT_TRUE(events.empty());
+}
+
+//------------------------------------------------------------------------------
+// SockDiagReader
+//------------------------------------------------------------------------------
+TEST(SockDiagReader, filter_by_port)
+{
+    // create a TCP connection over the loopback interface on an ephemeral port:
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(listen_fd, -1);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(listen_fd, 1), 0);
+    ASSERT_EQ(getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len), 0);
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(client_fd, -1);
+    ASSERT_EQ(connect(client_fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    int server_fd = accept(listen_fd, NULL, NULL);
+    ASSERT_NE(server_fd, -1);
+
+    SockDiagReader r;
+    ASSERT_TRUE(r.set_port_filter({ 1 /* nobody listens here */, ntohs(addr.sin_port) }));
+    ASSERT_TRUE(r.open());
+    ASSERT_TRUE(r.dump_tcp_summary());
+
+    // the listening socket has the port as local port; both ends of the connection have it either
+    // as local or remote port:
+    const sock_diag_tcp_summary_t& summary = r.get_tcp_summary();
+    ASSERT_EQ(summary.num_sockets, 3U);
+    ASSERT_EQ(summary.num_by_state[TCP_LISTEN], 1U);
+    ASSERT_EQ(summary.num_by_state[TCP_ESTABLISHED], 2U);
+    ASSERT_EQ(summary.num_rtt_samples, 2U);
+
+    // a filter not matching any socket:
+    ASSERT_TRUE(r.set_port_filter({ 1 }));
+    ASSERT_TRUE(r.dump_tcp_summary());
+    ASSERT_EQ(r.get_tcp_summary().num_sockets, 0U);
+
+    close(server_fd);
+    close(client_fd);
+    close(listen_fd);
+}
@@ -0,0 +1,75 @@
+//------------------------------------------------------------------------------
+// GTest for the readers of /proc/net/snmp and /proc/net/netstat
+//------------------------------------------------------------------------------
+
+#include "../system.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// NetstatReader
+//------------------------------------------------------------------------------
+static void write_netstat_files(const std::string& dir, bool with_icmpmsg, unsigned int retrans)
+{
+    FILE* fp = fopen((dir + "/snmp").c_str(), "w");
+    ASSERT_TRUE(fp != NULL);
+    fprintf(fp, "Ip: Forwarding DefaultTTL InReceives\nIp: 2 64 13957\n");
+    if (with_icmpmsg) // appears only after the first ICMP message has been exchanged
+        fprintf(fp, "IcmpMsg: InType3 OutType3\nIcmpMsg: 5 4\n");
+    fprintf(fp,
+        "Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens PassiveOpens AttemptFails EstabResets CurrEstab "
+        "InSegs OutSegs RetransSegs InErrs OutRsts InCsumErrors\n"
+        "Tcp: 1 200 120000 -1 37 38 0 56 8 13948 13947 %u 0 28 0\n"
+        "Udp: InDatagrams NoPorts InErrors OutDatagrams RcvbufErrors SndbufErrors InCsumErrors IgnoredMulti\n"
+        "Udp: 10 4 0 11 3 0 0 0\n",
+        retrans);
+    fclose(fp);
+
+    // a kernel not exposing some of the sampled counters, e.g. TCPSynRetrans:
+    fp = fopen((dir + "/netstat").c_str(), "w");
+    ASSERT_TRUE(fp != NULL);
+    fprintf(fp, "TcpExt: SyncookiesSent ListenOverflows ListenDrops TCPTimeouts\nTcpExt: 0 7 9 2\n");
+    fclose(fp);
+}
+
+TEST(NetstatReader, columns_resolved_by_name)
+{
+    char dir_template[] = "/tmp/cmonitor_netstat_test_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir_template) != NULL);
+    std::string dir(dir_template);
+
+    netstat_readers_t readers;
+    CMonitorSystem::init_netstat_readers(readers, dir, false);
+    uint64_t values[NETSTAT_MAX];
+
+    write_netstat_files(dir, false, 5);
+    ASSERT_TRUE(CMonitorSystem::read_netstat_stats(readers, values));
+    ASSERT_EQ(values[NETSTAT_TCP_ACTIVE_OPENS], 37U);
+    ASSERT_EQ(values[NETSTAT_TCP_RETRANS_SEGS], 5U);
+    ASSERT_EQ(values[NETSTAT_TCP_OUT_RSTS], 28U);
+    ASSERT_EQ(values[NETSTAT_UDP_OUT_DATAGRAMS], 11U);
+    ASSERT_EQ(values[NETSTAT_UDP_RCVBUF_ERRORS], 3U);
+    ASSERT_EQ(values[NETSTAT_TCP_LISTEN_OVERFLOWS], 7U);
+    ASSERT_EQ(values[NETSTAT_TCP_LISTEN_DROPS], 9U);
+    ASSERT_EQ(values[NETSTAT_TCP_SYN_RETRANS], 0U);
+
+    // the lines shift when new groups appear, while the columns resolved at first read remain valid:
+    write_netstat_files(dir, true, 6);
+    ASSERT_TRUE(CMonitorSystem::read_netstat_stats(readers, values));
+    ASSERT_EQ(values[NETSTAT_TCP_ACTIVE_OPENS], 37U);
+    ASSERT_EQ(values[NETSTAT_TCP_RETRANS_SEGS], 6U);
+    ASSERT_EQ(values[NETSTAT_UDP_RCVBUF_ERRORS], 3U);
+
+    unlink((dir + "/snmp").c_str());
+    unlink((dir + "/netstat").c_str());
+    rmdir(dir.c_str());
+}
+
+TEST(NetstatReader, real_proc_files)
+{
+    netstat_readers_t readers;
+    CMonitorSystem::init_netstat_readers(readers, "/proc/net", false);
+    uint64_t values[NETSTAT_MAX];
+    ASSERT_TRUE(CMonitorSystem::read_netstat_stats(readers, values));
+    ASSERT_TRUE(CMonitorSystem::read_netstat_stats(readers, values));
+}
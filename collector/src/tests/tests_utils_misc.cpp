@@ -3,6 +3,7 @@
 //------------------------------------------------------------------------------
 
 #include "../utils_misc.h"
+#include "../utils_string.h"
 #include <gtest/gtest.h>
 #include <iostream>
 #include <sstream> //std::stringstream
@@ -32,3 +33,45 @@ TEST(Utils, format_timestamp)
         ASSERT_EQ(testArray[i].expected_output, utcTime);
     }
 }
+
+TEST(Utils, split_fields_on_whitespace)
+{
+    const char* line = "   8       0 sda 1220 14 91158 512 353 142 25354 317 0 704 960 0 0 0 0 55 130";
+    string_field_t fields[20];
+
+    size_t nfields = split_fields_on_whitespace(line, fields, 20);
+    ASSERT_EQ(nfields, 20U);
+    ASSERT_EQ(std::string(fields[2].ptr, fields[2].len), "sda");
+
+    uint64_t value = 0;
+    ASSERT_TRUE(string_field2int(fields[0], value));
+    ASSERT_EQ(value, 8U);
+    ASSERT_TRUE(string_field2int(fields[5], value));
+    ASSERT_EQ(value, 91158U);
+    ASSERT_TRUE(string_field2int(fields[19], value));
+    ASSERT_EQ(value, 130U);
+    ASSERT_FALSE(string_field2int(fields[2], value));
+
+    // fields exceeding the maximum are not parsed
+    ASSERT_EQ(split_fields_on_whitespace(line, fields, 3), 3U);
+    ASSERT_EQ(split_fields_on_whitespace("", fields, 20), 0U);
+    ASSERT_EQ(split_fields_on_whitespace("  \t ", fields, 20), 0U);
+
+    std::vector<std::string> patterns = { "loop*", "sda" };
+    ASSERT_TRUE(string_field_matches_any_prefix(fields[2], patterns));
+    nfields = split_fields_on_whitespace("sdab loop12 loo", fields, 20);
+    ASSERT_EQ(nfields, 3U);
+    ASSERT_FALSE(string_field_matches_any_prefix(fields[0], patterns));
+    ASSERT_TRUE(string_field_matches_any_prefix(fields[1], patterns));
+    ASSERT_FALSE(string_field_matches_any_prefix(fields[2], patterns));
+}
+
+TEST(Utils, counter32_delta)
+{
+    ASSERT_EQ(counter32_delta(1500, 1000), 500U);
+    ASSERT_EQ(counter32_delta(1000, 1000), 0U);
+
+    // the counter wrapped around 2^32 between the two samples:
+    ASSERT_EQ(counter32_delta(0x00000010, 0xfffffff0), 0x20U);
+    ASSERT_EQ(counter32_delta(0, 0xffffffff), 1U);
+}
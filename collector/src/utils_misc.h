@@ -26,6 +26,7 @@
 #include <chrono>
 #include <map>
 #include <set>
+#include <stdint.h>
 #include <string.h>
 #include <string>
 #include <unistd.h>
@@ -41,3 +42,12 @@ bool get_timestamp(double* ts_for_delta_computation, std::string& utcTime);
 // Hostname utilities
 //------------------------------------------------------------------------------
 std::string get_hostname();
+
+//------------------------------------------------------------------------------
+// Counter utilities
+//------------------------------------------------------------------------------
+
+// returns the increment of a counter that the kernel stores in 32 bits (e.g. the %08x columns of
+// /proc/net/softnet_stat or the %10u columns of /proc/softirqs and /proc/interrupts), taking into account
+// that it may have wrapped around since the previous sample
+inline uint32_t counter32_delta(uint64_t current, uint64_t previous) { return (uint32_t)(current - previous); }
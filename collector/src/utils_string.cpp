@@ -257,3 +257,61 @@ bool parse_string_with_multiple_ranges(const std::string& data, std::set<uint64_
         result.insert(i);
     return true;
 }
+
+// ----------------------------------------------------------------------------------
+// Zero-copy utility functions
+// ----------------------------------------------------------------------------------
+
+size_t split_fields_on_whitespace(const char* line, string_field_t* fields, size_t max_fields)
+{
+    // this function never allocates memory and never modifies the input line:
+    // each returned field points inside the provided line
+    size_t nfields = 0;
+    const char* p = line;
+    while (*p != '\0' && nfields < max_fields) {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\0' || *p == '\n')
+            break;
+
+        fields[nfields].ptr = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n')
+            p++;
+        fields[nfields].len = p - fields[nfields].ptr;
+        nfields++;
+    }
+
+    return nfields;
+}
+
+bool string_field2int(const string_field_t& field, uint64_t& result)
+{
+    if (field.len == 0)
+        return false;
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < field.len; i++) {
+        char c = field.ptr[i];
+        if (c < '0' || c > '9')
+            return false;
+        value = value * 10 + (c - '0');
+    }
+
+    result = value;
+    return true;
+}
+
+bool string_field_matches_any_prefix(const string_field_t& field, const std::vector<std::string>& patterns)
+{
+    // each pattern is either an exact name (e.g. "sda") or a prefix terminated by '*' (e.g. "loop*")
+    for (const auto& pattern : patterns) {
+        if (!pattern.empty() && pattern.back() == '*') {
+            size_t prefix_len = pattern.size() - 1;
+            if (field.len >= prefix_len && strncmp(field.ptr, pattern.c_str(), prefix_len) == 0)
+                return true;
+        } else if (field.len == pattern.size() && strncmp(field.ptr, pattern.c_str(), field.len) == 0)
+            return true;
+    }
+
+    return false;
+}
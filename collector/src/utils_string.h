@@ -31,6 +31,16 @@
 #include <unistd.h>
 #include <vector>
 
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+// a field of a line of text, pointing directly inside the original line (i.e. not NUL-terminated)
+typedef struct string_field_s {
+    const char* ptr;
+    size_t len;
+} string_field_t;
+
 //------------------------------------------------------------------------------
 // String utilities
 //------------------------------------------------------------------------------
@@ -47,3 +57,11 @@ bool split_label_value(const std::string& str, char separator, std::string& labe
 bool parse_string_with_multiple_ranges(const std::string& data, std::vector<int>& result);
 bool parse_string_with_multiple_ranges(const std::string& data, std::set<int>& result);
 bool parse_string_with_multiple_ranges(const std::string& data, std::set<uint64_t>& result);
+
+//------------------------------------------------------------------------------
+// Zero-copy string utilities
+// (to be used in the hot path of parsers for /proc files)
+//------------------------------------------------------------------------------
+size_t split_fields_on_whitespace(const char* line, string_field_t* fields, size_t max_fields);
+bool string_field2int(const string_field_t& field, uint64_t& result);
+bool string_field_matches_any_prefix(const string_field_t& field, const std::vector<std::string>& patterns);